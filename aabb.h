@@ -99,13 +99,16 @@ public:
 
 };
 
-class TBox : public TAABB
+/*-----------------------------------------------------------------------------------
+The attributes of a box that are only needed to draw it.  Its bounds, velocity
+and acceleration are kept in the simulation store (CSimStore).
+-----------------------------------------------------------------------------------*/
+
+class TBox
 {
 	// ATTRIBUTES
 public:
 
-	TVector vel;						// Velocity of box
-	TVector accel;						// Acceleration of box
 	int color;							// ID specifying global colour to choose
 	int texture;						// ID specifying global texture to choose
 	
@@ -116,12 +119,8 @@ public:
 	TBox() {}
 
 	// Initialization constructor
-	TBox(const TVector& mn, const TVector& mx, const TVector& v, int c, int t)
+	TBox(int c, int t)
 	{
-		 minv = mn;
-		 maxv = mx;
-		 vel = v;
-		 accel = TVector(0.0f, -0.49f, 0.0f);	// Simulate gravity
 		 color = c;
 		 texture = t;
 	}
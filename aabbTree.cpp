@@ -0,0 +1,454 @@
+/*-----------------------------------------------------------------------------------
+File:			aabbTree.cpp
+Authors:		Steve Costa
+Description:	Dynamic AABB tree.  Leaves are inserted next to the sibling that
+				gives the smallest increase in surface area and the tree is kept
+				balanced with rotations, based on the dynamic tree in Erin
+				Catto's Box2D.
+-----------------------------------------------------------------------------------*/
+
+#include "aabbTree.h"
+
+#include "broadphase.h"
+
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+Bounding box helper functions
+-----------------------------------------------------------------------------------*/
+
+// Smallest box containing both boxes
+static TAABB Union(const TAABB& a, const TAABB& b)
+{
+	TAABB c = a;
+	c.Add(b.minv);
+	c.Add(b.maxv);
+	return c;
+}
+
+// Surface area of a box, the cost of a node is proportional to it
+static float SurfaceArea(const TAABB& a)
+{
+	TVector d = a.maxv - a.minv;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// True if box a completely contains box b
+static bool Contains(const TAABB& a, const TAABB& b)
+{
+	return	(a.minv.x <= b.minv.x) && (a.minv.y <= b.minv.y) && (a.minv.z <= b.minv.z) &&
+			(b.maxv.x <= a.maxv.x) && (b.maxv.y <= a.maxv.y) && (b.maxv.z <= a.maxv.z);
+}
+
+// Grow the bounds by the margin and stretch them in the direction of motion so
+// the object can keep moving for a few frames before leaving them
+static TAABB Fatten(const TAABB& bounds, const TVector& disp)
+{
+	TVector margin(AABB_TREE_MARGIN, AABB_TREE_MARGIN, AABB_TREE_MARGIN);
+	TAABB fat(bounds.minv - margin, bounds.maxv + margin);
+
+	TVector d = disp * AABB_TREE_PREDICT;
+
+	if (d.x < 0.0f) fat.minv.x += d.x; else fat.maxv.x += d.x;
+	if (d.y < 0.0f) fat.minv.y += d.y; else fat.maxv.y += d.y;
+	if (d.z < 0.0f) fat.minv.z += d.z; else fat.maxv.z += d.z;
+
+	return fat;
+}
+
+/*-----------------------------------------------------------------------------------
+Initialise an empty tree
+-----------------------------------------------------------------------------------*/
+
+CAABBTree::CAABBTree()
+{
+	root = AABB_TREE_NULL;
+	free_list = AABB_TREE_NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+Take a node from the free list, growing the pool if there are none left
+-----------------------------------------------------------------------------------*/
+
+int CAABBTree::AllocateNode()
+{
+	if (free_list == AABB_TREE_NULL)
+	{
+		TNode n;
+		n.parent = AABB_TREE_NULL;
+		nodes.push_back(n);
+		free_list = (int)nodes.size() - 1;
+	}
+
+	int node = free_list;
+	free_list = nodes[node].parent;
+
+	nodes[node].parent = AABB_TREE_NULL;
+	nodes[node].child1 = AABB_TREE_NULL;
+	nodes[node].child2 = AABB_TREE_NULL;
+	nodes[node].height = 0;
+	nodes[node].user_id = -1;
+
+	return node;
+}
+
+/*-----------------------------------------------------------------------------------
+Return a node to the free list
+-----------------------------------------------------------------------------------*/
+
+void CAABBTree::FreeNode(int node)
+{
+	nodes[node].parent = free_list;
+	nodes[node].height = -1;
+	free_list = node;
+}
+
+/*-----------------------------------------------------------------------------------
+Add an object to the tree.  The bounds should enclose everything the object
+covers this frame (its swept bounds), disp is its displacement this frame.
+-----------------------------------------------------------------------------------*/
+
+int CAABBTree::CreateProxy(const TAABB& bounds, const TVector& disp, int user_id)
+{
+	int proxy = AllocateNode();
+
+	nodes[proxy].bounds = Fatten(bounds, disp);
+	nodes[proxy].user_id = user_id;
+
+	InsertLeaf(proxy);
+
+	return proxy;
+}
+
+/*-----------------------------------------------------------------------------------
+Remove an object from the tree
+-----------------------------------------------------------------------------------*/
+
+void CAABBTree::DestroyProxy(int proxy)
+{
+	assert(nodes[proxy].IsLeaf());
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+}
+
+/*-----------------------------------------------------------------------------------
+Update the bounds of an object.  Nothing is done as long as the new bounds are
+still inside the fat bounds stored in the leaf, unless the fat bounds have become
+much larger than needed (i.e. the object slowed down).  Otherwise the leaf is
+refattened and reinserted.
+-----------------------------------------------------------------------------------*/
+
+bool CAABBTree::MoveProxy(int proxy, const TAABB& bounds, const TVector& disp)
+{
+	assert(nodes[proxy].IsLeaf());
+
+	TAABB fat = Fatten(bounds, disp);
+	TAABB old_fat = nodes[proxy].bounds;
+
+	if (Contains(old_fat, bounds))
+	{
+		TVector slack(	4.0f * AABB_TREE_MARGIN, 4.0f * AABB_TREE_MARGIN,
+						4.0f * AABB_TREE_MARGIN);
+		TAABB huge(fat.minv - slack, fat.maxv + slack);
+
+		if (Contains(huge, old_fat))
+			return false;
+	}
+
+	RemoveLeaf(proxy);
+	nodes[proxy].bounds = fat;
+	InsertLeaf(proxy);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Insert a leaf.  Walk down from the root choosing the child whose bounds grow
+the least, and pair the leaf with the node where descending any further would
+cost more than creating a new parent there.
+-----------------------------------------------------------------------------------*/
+
+void CAABBTree::InsertLeaf(int leaf)
+{
+	if (root == AABB_TREE_NULL)
+	{
+		root = leaf;
+		nodes[root].parent = AABB_TREE_NULL;
+		return;
+	}
+
+	// Find the best sibling
+	TAABB leaf_bounds = nodes[leaf].bounds;
+	int index = root;
+
+	while (!nodes[index].IsLeaf())
+	{
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float area = SurfaceArea(nodes[index].bounds);
+		float combined_area = SurfaceArea(Union(nodes[index].bounds, leaf_bounds));
+
+		// Cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combined_area;
+
+		// Minimum cost of pushing the leaf further down the tree
+		float inheritance_cost = 2.0f * (combined_area - area);
+
+		float cost1 = SurfaceArea(Union(leaf_bounds, nodes[child1].bounds)) + inheritance_cost;
+		if (!nodes[child1].IsLeaf())
+			cost1 -= SurfaceArea(nodes[child1].bounds);
+
+		float cost2 = SurfaceArea(Union(leaf_bounds, nodes[child2].bounds)) + inheritance_cost;
+		if (!nodes[child2].IsLeaf())
+			cost2 -= SurfaceArea(nodes[child2].bounds);
+
+		// Descend according to the minimum cost
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+
+	int sibling = index;
+
+	// Create a new parent
+	int old_parent = nodes[sibling].parent;
+	int new_parent = AllocateNode();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].bounds = Union(leaf_bounds, nodes[sibling].bounds);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].child1 = sibling;
+	nodes[new_parent].child2 = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	if (old_parent != AABB_TREE_NULL)
+	{
+		if (nodes[old_parent].child1 == sibling)
+			nodes[old_parent].child1 = new_parent;
+		else
+			nodes[old_parent].child2 = new_parent;
+	}
+	else
+		root = new_parent;
+
+	// Walk back up the tree fixing heights and bounds
+	index = nodes[leaf].parent;
+	while (index != AABB_TREE_NULL)
+	{
+		index = Balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		nodes[index].height = 1 + MAX(nodes[child1].height, nodes[child2].height);
+		nodes[index].bounds = Union(nodes[child1].bounds, nodes[child2].bounds);
+
+		index = nodes[index].parent;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Remove a leaf, its sibling takes the place of their parent.
+-----------------------------------------------------------------------------------*/
+
+void CAABBTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = AABB_TREE_NULL;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grand_parent = nodes[parent].parent;
+	int sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grand_parent != AABB_TREE_NULL)
+	{
+		// Connect the sibling to the grand parent
+		if (nodes[grand_parent].child1 == parent)
+			nodes[grand_parent].child1 = sibling;
+		else
+			nodes[grand_parent].child2 = sibling;
+		nodes[sibling].parent = grand_parent;
+		FreeNode(parent);
+
+		// Adjust ancestor bounds
+		int index = grand_parent;
+		while (index != AABB_TREE_NULL)
+		{
+			index = Balance(index);
+
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+
+			nodes[index].bounds = Union(nodes[child1].bounds, nodes[child2].bounds);
+			nodes[index].height = 1 + MAX(nodes[child1].height, nodes[child2].height);
+
+			index = nodes[index].parent;
+		}
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = AABB_TREE_NULL;
+		FreeNode(parent);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+If the subtrees of node A differ in height by more than one, rotate the taller
+child up to take A's place.  Returns the node now at A's position.
+
+		A
+	  /   \
+	 B     C
+		  / \
+		 F   G
+-----------------------------------------------------------------------------------*/
+
+int CAABBTree::Balance(int a)
+{
+	if (nodes[a].IsLeaf() || nodes[a].height < 2)
+		return a;
+
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+
+	int balance = nodes[c].height - nodes[b].height;
+
+	// Rotate C up
+	if (balance > 1)
+	{
+		int f = nodes[c].child1;
+		int g = nodes[c].child2;
+
+		// Swap A and C
+		nodes[c].child1 = a;
+		nodes[c].parent = nodes[a].parent;
+		nodes[a].parent = c;
+
+		// A's old parent should point to C
+		if (nodes[c].parent != AABB_TREE_NULL)
+		{
+			if (nodes[nodes[c].parent].child1 == a)
+				nodes[nodes[c].parent].child1 = c;
+			else
+				nodes[nodes[c].parent].child2 = c;
+		}
+		else
+			root = c;
+
+		// Keep the taller of F and G under C
+		if (nodes[f].height > nodes[g].height)
+		{
+			nodes[c].child2 = f;
+			nodes[a].child2 = g;
+			nodes[g].parent = a;
+			nodes[a].bounds = Union(nodes[b].bounds, nodes[g].bounds);
+			nodes[c].bounds = Union(nodes[a].bounds, nodes[f].bounds);
+
+			nodes[a].height = 1 + MAX(nodes[b].height, nodes[g].height);
+			nodes[c].height = 1 + MAX(nodes[a].height, nodes[f].height);
+		}
+		else
+		{
+			nodes[c].child2 = g;
+			nodes[a].child2 = f;
+			nodes[f].parent = a;
+			nodes[a].bounds = Union(nodes[b].bounds, nodes[f].bounds);
+			nodes[c].bounds = Union(nodes[a].bounds, nodes[g].bounds);
+
+			nodes[a].height = 1 + MAX(nodes[b].height, nodes[f].height);
+			nodes[c].height = 1 + MAX(nodes[a].height, nodes[g].height);
+		}
+
+		return c;
+	}
+
+	// Rotate B up
+	if (balance < -1)
+	{
+		int d = nodes[b].child1;
+		int e = nodes[b].child2;
+
+		// Swap A and B
+		nodes[b].child1 = a;
+		nodes[b].parent = nodes[a].parent;
+		nodes[a].parent = b;
+
+		// A's old parent should point to B
+		if (nodes[b].parent != AABB_TREE_NULL)
+		{
+			if (nodes[nodes[b].parent].child1 == a)
+				nodes[nodes[b].parent].child1 = b;
+			else
+				nodes[nodes[b].parent].child2 = b;
+		}
+		else
+			root = b;
+
+		// Keep the taller of D and E under B
+		if (nodes[d].height > nodes[e].height)
+		{
+			nodes[b].child2 = d;
+			nodes[a].child1 = e;
+			nodes[e].parent = a;
+			nodes[a].bounds = Union(nodes[c].bounds, nodes[e].bounds);
+			nodes[b].bounds = Union(nodes[a].bounds, nodes[d].bounds);
+
+			nodes[a].height = 1 + MAX(nodes[c].height, nodes[e].height);
+			nodes[b].height = 1 + MAX(nodes[a].height, nodes[d].height);
+		}
+		else
+		{
+			nodes[b].child2 = e;
+			nodes[a].child1 = d;
+			nodes[d].parent = a;
+			nodes[a].bounds = Union(nodes[c].bounds, nodes[d].bounds);
+			nodes[b].bounds = Union(nodes[a].bounds, nodes[e].bounds);
+
+			nodes[a].height = 1 + MAX(nodes[c].height, nodes[d].height);
+			nodes[b].height = 1 + MAX(nodes[a].height, nodes[e].height);
+		}
+
+		return b;
+	}
+
+	return a;
+}
+
+/*-----------------------------------------------------------------------------------
+Append the user ids of all leaves whose fat bounds overlap the box.
+-----------------------------------------------------------------------------------*/
+
+void CAABBTree::Query(const TAABB& box, vector<int>& hits) const
+{
+	if (root == AABB_TREE_NULL)
+		return;
+
+	// The tree is kept balanced so its height stays close to log2(# of leaves)
+	int stack[256];
+	int top = 0;
+	stack[top++] = root;
+
+	while (top > 0)
+	{
+		const TNode& n = nodes[stack[--top]];
+
+		if (!Overlaps(n.bounds, box))
+			continue;
+
+		if (n.IsLeaf())
+			hits.push_back(n.user_id);
+		else
+		{
+			assert(top + 2 <= 256);
+			stack[top++] = n.child1;
+			stack[top++] = n.child2;
+		}
+	}
+}
@@ -0,0 +1,75 @@
+/*-----------------------------------------------------------------------------------
+File:			aabbTree.h
+Authors:		Steve Costa
+Description:	Header file defining a dynamic AABB tree.  Each leaf stores a
+				fattened bound of a moving object which is only reinserted in
+				the tree once the object moves outside of it.
+-----------------------------------------------------------------------------------*/
+
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <vector>
+using namespace std;
+
+#include "aabb.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define AABB_TREE_NULL		-1			// No node
+#define AABB_TREE_MARGIN	0.1f		// Padding added around a leaf
+#define AABB_TREE_PREDICT	2.0f		// # of displacements a leaf is extended by
+
+class CAABBTree
+{
+	// ATTRIBUTES
+private:
+
+	struct TNode
+	{
+		TAABB bounds;				// Fat bounds (leaf) or union of children
+		int parent;					// Parent node, next free node when unused
+		int child1;					// AABB_TREE_NULL for leaves
+		int child2;
+		int height;					// 0 for leaves, -1 for unused nodes
+		int user_id;				// Object stored in a leaf
+
+		bool IsLeaf() const { return child1 == AABB_TREE_NULL; }
+	};
+
+	vector<TNode> nodes;			// Node pool
+	int root;						// Root of the tree
+	int free_list;					// First unused node of the pool
+
+	// METHODS
+public:
+
+	CAABBTree();
+
+	// Add an object moving by disp this frame, returns the proxy to refer to it by
+	int CreateProxy(const TAABB& bounds, const TVector& disp, int user_id);
+	void DestroyProxy(int proxy);
+
+	// Update the bounds of an object.  Returns true if it left its fat bounds and
+	// had to be reinserted.
+	bool MoveProxy(int proxy, const TAABB& bounds, const TVector& disp);
+
+	// Append the objects whose fat bounds overlap the box
+	void Query(const TAABB& box, vector<int>& hits) const;
+
+	const TAABB& GetFatBounds(int proxy) const { return nodes[proxy].bounds; }
+	int GetHeight() const { return root == AABB_TREE_NULL ? 0 : nodes[root].height; }
+
+private:
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int node);
+};
+
+#endif
@@ -6,30 +6,24 @@ Description:	Define methods for a ball datatype.
 
 #include "sphere.h"
 
-#include "commonUtil.h"
+#include "coreUtil.h"
 
 /*-----------------------------------------------------------------------------------
 Initialize state variables
 -----------------------------------------------------------------------------------*/
 
-TBall::TBall(const TVector& c, float r, const TVector& v, int col, int tex)
+TBall::TBall(const TVector& v, int col, int tex)
 { 
-	vel = v;								// Store the velocity
-	accel = TVector(0.0f, -0.49f, 0.0f);	// Simulate gravity
-	center = c;								// Store the center coordinate
-	radius = r;								// Store the radius
 	color = col;
 	texture = tex;
 
-	circumference = PI2 * radius;			// Calculate the circumference
-
 	rot.LoadIdentity();						// Initialize rotation matrix
 
 	// The axis of rotation for the ball is perpindicular to
 	// the direction it is pointing in
-	axis.x = vel.z;
+	axis.x = v.z;
 	axis.y = 0.0f;
-	axis.z = -vel.x;
+	axis.z = -v.x;
 	if (Magnitude(axis) > 0.0f) {
 		axis.Normalize();
 	}
@@ -45,10 +39,11 @@ TBall::TBall(const TVector& c, float r, const TVector& v, int col, int tex)
 }
 
 /*-----------------------------------------------------------------------------------
-Once the player turns, the axis of rotation for the ball must turn also
+Once the player turns, the velocity of the ball and its axis of rotation must
+turn also
 -----------------------------------------------------------------------------------*/
 
-void TBall::Turn(float theta)
+void TBall::Turn(float theta, TVector& vel)
 {
 	float old_velx = vel.x;
 	float old_velz = vel.z;
@@ -78,8 +73,10 @@ Given the velocity of the ball, its radius and the axis of rotation
 this method will rotate the ball accordingly
 -----------------------------------------------------------------------------------*/
 
-void TBall::Rotate(float dt)
+void TBall::Rotate(const TVector& vel, float radius, float dt)
 {
+	float circumference = PI2 * radius;
+
 	// Calculate the arc given the displacement (speed * time) and circumference
 	// (ball should only roll if moving along x-z axis)
 	TVector xz_vel(vel.x, 0.0f, vel.z);
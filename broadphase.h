@@ -0,0 +1,78 @@
+/*-----------------------------------------------------------------------------------
+File:			broadphase.h
+Authors:		Steve Costa
+Description:	Types and helper functions shared by the broadphase structures
+				which cull the object pairs handed to the geometric tests.
+-----------------------------------------------------------------------------------*/
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "vector.h"
+using namespace vec;
+
+#include "aabb.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+// Padding added to swept bounds so rounding in the narrow phase tests can
+// never place a contact outside the bounds that produced the pair
+#define BROADPHASE_MARGIN	0.01f
+
+/*-----------------------------------------------------------------------------------
+Candidate pair of objects returned by a broadphase.  The ordering operator sorts
+pairs the same way the nested loops in CCollisions visit them, so that feeding
+candidates to the narrow phase in sorted order gives identical results.
+-----------------------------------------------------------------------------------*/
+
+struct TPair
+{
+	int object1;
+	int object2;
+
+	bool operator < (const TPair& rhs) const
+	{
+		if (object1 != rhs.object1) return object1 < rhs.object1;
+		return object2 < rhs.object2;
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Bounds enclosing a ball or a box over the whole of its displacement for the
+current time slice.
+-----------------------------------------------------------------------------------*/
+
+inline TAABB SweptBounds(const TVector& center, float radius, const TVector& disp)
+{
+	float r = radius + BROADPHASE_MARGIN;
+	TVector ext(r, r, r);
+
+	TAABB bounds(center - ext, center + ext);
+	bounds.Add(center + disp - ext);
+	bounds.Add(center + disp + ext);
+
+	return bounds;
+}
+
+inline TAABB SweptBounds(const TAABB& box, const TVector& disp)
+{
+	TVector ext(BROADPHASE_MARGIN, BROADPHASE_MARGIN, BROADPHASE_MARGIN);
+
+	TAABB bounds(box.minv - ext, box.maxv + ext);
+	bounds.Add(box.minv + disp - ext);
+	bounds.Add(box.maxv + disp + ext);
+
+	return bounds;
+}
+
+// Test two bounding boxes for overlap (touching boxes count as overlapping)
+inline bool Overlaps(const TAABB& a, const TAABB& b)
+{
+	return	(a.minv.x <= b.maxv.x) && (a.maxv.x >= b.minv.x) &&
+			(a.minv.y <= b.maxv.y) && (a.maxv.y >= b.minv.y) &&
+			(a.minv.z <= b.maxv.z) && (a.maxv.z >= b.minv.z);
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*-----------------------------------------------------------------------------------
+File:			bvh.cpp
+Authors:		Steve Costa
+Description:	Static bounding volume hierarchy.  The tree is built top down by
+				splitting the objects at the median of their centres along the
+				longest axis of the node.
+-----------------------------------------------------------------------------------*/
+
+#include "bvh.h"
+
+#include <algorithm>
+
+#include "broadphase.h"
+
+/*-----------------------------------------------------------------------------------
+Orders object ids by the position of their centre along an axis
+-----------------------------------------------------------------------------------*/
+
+struct TCentroidLess
+{
+	const vector<TVector> *p_centroids;
+	int axis;
+
+	bool operator () (int a, int b) const
+	{
+		TVector ca = (*p_centroids)[a];
+		TVector cb = (*p_centroids)[b];
+		return ca[axis] < cb[axis];
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Build the tree over num objects with the given bounds.
+-----------------------------------------------------------------------------------*/
+
+void CStaticBVH::Build(const TAABB *bounds, int num)
+{
+	nodes.clear();
+	objects.resize(num);
+	obj_bounds.assign(bounds, bounds + num);
+	centroids.resize(num);
+
+	for (int i = 0; i < num; i++)
+	{
+		objects[i] = i;
+		centroids[i] = (bounds[i].minv + bounds[i].maxv) * 0.5f;
+	}
+
+	if (num == 0)
+		return;
+
+	// A binary tree with at least one object per leaf has fewer than 2 * num nodes
+	nodes.reserve(2 * num);
+	nodes.push_back(TNode());
+	Subdivide(0, 0, num);
+}
+
+/*-----------------------------------------------------------------------------------
+Compute the bounds of a node and split it in two if it holds too many objects.
+-----------------------------------------------------------------------------------*/
+
+void CStaticBVH::Subdivide(int node, int first, int count)
+{
+	TAABB bounds = obj_bounds[objects[first]];
+	TAABB centre_bounds(centroids[objects[first]], centroids[objects[first]]);
+
+	for (int i = first + 1; i < first + count; i++)
+	{
+		bounds.Add(obj_bounds[objects[i]].minv);
+		bounds.Add(obj_bounds[objects[i]].maxv);
+		centre_bounds.Add(centroids[objects[i]]);
+	}
+
+	nodes[node].bounds = bounds;
+
+	if (count <= BVH_LEAF_SIZE)
+	{
+		nodes[node].first = first;
+		nodes[node].count = count;
+		return;
+	}
+
+	// Split along the axis the centres are spread out the most on
+	TVector extent = centre_bounds.maxv - centre_bounds.minv;
+	TCentroidLess less;
+	less.p_centroids = &centroids;
+	less.axis = 0;
+	if (extent.y > extent.x) less.axis = 1;
+	if (extent.z > extent[less.axis]) less.axis = 2;
+
+	int half = count / 2;
+	nth_element(objects.begin() + first, objects.begin() + first + half,
+				objects.begin() + first + count, less);
+
+	// Children are allocated together so only the first needs to be stored
+	int child = (int)nodes.size();
+	nodes.push_back(TNode());
+	nodes.push_back(TNode());
+
+	nodes[node].first = child;
+	nodes[node].count = 0;
+
+	Subdivide(child, first, half);
+	Subdivide(child + 1, first + half, count - half);
+}
+
+/*-----------------------------------------------------------------------------------
+Append the ids of all objects whose bounds overlap the box.
+-----------------------------------------------------------------------------------*/
+
+void CStaticBVH::Query(const TAABB& box, vector<int>& hits) const
+{
+	if (nodes.empty())
+		return;
+
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const TNode& n = nodes[stack[--top]];
+
+		if (!Overlaps(n.bounds, box))
+			continue;
+
+		if (n.count > 0)
+		{
+			for (int i = n.first; i < n.first + n.count; i++)
+			{
+				if (Overlaps(obj_bounds[objects[i]], box))
+					hits.push_back(objects[i]);
+			}
+		}
+		else
+		{
+			stack[top++] = n.first + 1;
+			stack[top++] = n.first;
+		}
+	}
+}
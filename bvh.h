@@ -0,0 +1,53 @@
+/*-----------------------------------------------------------------------------------
+File:			bvh.h
+Authors:		Steve Costa
+Description:	Header file defining a static bounding volume hierarchy.  It is
+				built once over objects which never move (the walls) and then
+				queried for the objects overlapping a given box.
+-----------------------------------------------------------------------------------*/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+using namespace std;
+
+#include "aabb.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define BVH_LEAF_SIZE		4			// Max # of objects stored in a leaf
+
+class CStaticBVH
+{
+	// ATTRIBUTES
+private:
+
+	// Node of the tree.  Children of an interior node are stored next to each
+	// other, a leaf refers to a run of the object index array.
+	struct TNode
+	{
+		TAABB bounds;				// Bounds of everything below the node
+		int first;					// First child (interior) or first object (leaf)
+		int count;					// # of objects in a leaf, 0 for interior nodes
+	};
+
+	vector<TNode> nodes;			// Nodes, root is nodes[0]
+	vector<int> objects;			// Object ids ordered by leaf
+	vector<TAABB> obj_bounds;		// Bounds of each object
+	vector<TVector> centroids;		// Centre of each object's bounds
+
+	// METHODS
+public:
+
+	void Build(const TAABB *bounds, int num);					// Build over num objects
+	void Query(const TAABB& box, vector<int>& hits) const;		// Append objects overlapping box
+
+private:
+
+	void Subdivide(int node, int first, int count);
+};
+
+#endif
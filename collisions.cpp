@@ -18,544 +18,2318 @@ using namespace physics;
 #include "vector.h"							// Vector data type
 using namespace vec;
 
-#include "commonUtil.h"
+#include <algorithm>
+
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+The world object reference that is passed to the constructor is used to create
+pointers to all the world object in the CScene class so that their state variables
+can be visible for performing geometric tests and applying physics responses.
+-----------------------------------------------------------------------------------*/
+
+CCollisions::CCollisions(CScene &world)
+{
+	num_walls = world.num_walls;
+	num_balls = world.num_balls;
+	num_boxes = world.num_boxes;
+	num_meshes = world.num_meshes;
+
+	p_walls = world.p_walls;
+	p_balls = world.p_balls;
+	p_meshes = world.p_meshes;
+	p_sim = &world.sim;
+
+	// Size array large enough for max # of simultaneous collisions
+	max_collisions = num_balls + num_boxes;
+	p_cdata = new colldata[max_collisions];
+
+	// The hash grid handles ball pairs and the AABB tree box pairs unless
+	// another broadphase is chosen
+	broadphase = BROADPHASE_TREE;
+	ball_sap.Init(num_balls);
+	p_bounds = new TAABB[num_balls + num_boxes];
+
+	// Collisions are found by rescanning every pair after each response unless
+	// the event driven scheduler is chosen
+	event_driven = false;
+	scheduling = false;
+	batch = 0;
+	p_versions = new int[num_balls + num_boxes];
+	p_marks = new int[num_balls + num_boxes];
+	p_local_times = new float[num_balls + num_boxes];
+	for (int i = 0; i < num_balls + num_boxes; i++)
+	{
+		p_versions[i] = 0;
+		p_marks[i] = 0;
+		p_local_times[i] = 0.0f;
+	}
+
+	// Pairs that stay apart can be skipped using the separation found the last
+	// time they were tested and how far the objects have moved since.  Looking
+	// the pairs up costs more than the tests it saves on the maps measured so far
+	// (see SetPairCache), so it is off unless turned on.
+	use_pair_cache = false;
+	p_travel = new double[num_balls + num_boxes];
+	p_reach = new float[num_balls + num_boxes];
+	for (int i = 0; i < num_balls + num_boxes; i++)
+	{
+		p_travel[i] = 0.0;
+		p_reach[i] = 0.0f;
+	}
+
+	// Objects that have come to rest are parked until something reaches them
+	use_sleeping = true;
+	num_asleep = 0;
+	p_asleep = new bool[num_balls + num_boxes];
+	p_still_frames = new int[num_balls + num_boxes];
+	for (int i = 0; i < num_balls + num_boxes; i++)
+	{
+		p_asleep[i] = false;
+		p_still_frames[i] = 0;
+	}
+
+	// The work done in a frame is limited so a pile of objects in contact can
+	// not stall the game
+	max_iterations = TOI_MAX_ITERATIONS;
+	budget_us = 0;
+	num_over_budget = 0;
+	stats.frame = 0;
+	stats.Clear();
+
+	// No hardware counters until the caller gives them
+	SetPerfCounters(NULL);
+
+	TVector no_motion(0.0f, 0.0f, 0.0f);
+
+	p_box_proxies = new int[num_boxes];
+	for (int i = 0; i < num_boxes; i++)
+	{
+		p_box_proxies[i] = box_tree.CreateProxy(SweptBounds(p_sim->GetBoxBounds(i), no_motion),
+												no_motion, i);
+	}
+
+	// Every ball and box for the event driven retests, numbered as in p_bounds
+	p_event_proxies = new int[num_balls + num_boxes];
+	for (int i = 0; i < num_balls; i++)
+	{
+		p_event_proxies[i] = event_tree.CreateProxy(SweptBounds(p_sim->GetBallCenter(i),
+																p_sim->GetBallRadius(i), no_motion),
+													no_motion, i);
+	}
+	for (int i = 0; i < num_boxes; i++)
+	{
+		p_event_proxies[num_balls + i] = event_tree.CreateProxy(SweptBounds(p_sim->GetBoxBounds(i),
+																			no_motion),
+																 no_motion, num_balls + i);
+	}
+
+	// Bound the world space quad of every wall
+	TAABB *p_wall_bounds = new TAABB[num_walls];
+	TVector margin(BROADPHASE_MARGIN, BROADPHASE_MARGIN, BROADPHASE_MARGIN);
+
+	for (int i = 0; i < num_walls; i++)
+	{
+		TVector v = p_walls[i].GetVertex(0) * p_walls[i].trans;
+		p_wall_bounds[i] = TAABB(v - margin, v + margin);
+
+		for (int j = 1; j < 4; j++)
+		{
+			v = p_walls[i].GetVertex(j) * p_walls[i].trans;
+			p_wall_bounds[i].Add(v - margin);
+			p_wall_bounds[i].Add(v + margin);
+		}
+	}
+
+	wall_bvh.Build(p_wall_bounds, num_walls);
+	delete [] p_wall_bounds;
+
+	for (int i = 0; i < num_walls; i++)
+		all_walls.Add(p_walls[i], i);
+
+	// The meshes never move either, so their bounds are only found once
+	p_mesh_bounds = new TAABB[num_meshes];
+	for (int i = 0; i < num_meshes; i++)
+		p_mesh_bounds[i] = TAABB(p_meshes[i].bounds.minv - margin, p_meshes[i].bounds.maxv + margin);
+}
+
+/*-----------------------------------------------------------------------------------
+The collision tests performed return the time at which a collision will occur.  Each
+frame is alotted a time value of 1.  All collision tests are performed and the
+collision which occurs the soones and is less than 1 is chosen.  The simulation
+advances forward in time until the first collision at which time the collision
+response effects are calculated for the objects that have collided.  The initial
+time value of 1 is decremented by that collision time (i.e. 1 - collision time where
+collision time was 0.75 = 0.25 left).  If there is still time left the collision
+tests are conducted again to see if there will be a collision within that time
+step (i.e. 0.25) if there is (the first one of course) the same process of
+advancing to that time and calculating the collision response is conducted.  Oncse
+the time value reaches 0 no more collisions within the time interval will occur
+and the simulation will advance to the next frame.  If no collisions occured
+within 1 from the beginning, all the objects are simply advanced by this time
+step.
+
+Note: The value ZERO can be considered an 'epsilon' value.  Any collisions that
+occur within 'epsilon' time of eachother are considered to be simultaneous
+collisions.  (This has to be done to avoid rounding errors)
+
+Objects resting against each other can collide many times within a tiny fraction
+of the frame, so the number of iterations (see SetBudget) and the microseconds
+they take (budget_us, 0 for no limit) are limited.  Once either runs out the
+rest of the frame is approximated (see SkipRest).  The frames that run out of
+budget are counted and the frame stats show how much of the frame was exact.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::Test(float dt, int budget_us)
+{
+	assert(budget_us >= 0);
+
+	stats.frame++;
+	stats.Clear();
+	TPhaseTimer frame_timer(stats.frame_us, "CCollisions::Test");
+	this->budget_us = budget_us;
+	frame_start = chrono::steady_clock::now();
+	contacts.clear();
+
+	WakeChangedObjects();
+
+	// Nothing can happen once every object is asleep
+	if (num_asleep < num_balls + num_boxes)
+	{
+		if (event_driven)
+			TestEvents(dt);
+		else
+			TestScan(dt);
+
+		UpdateSleep();
+	}
+
+	if (stats.over_budget)
+		num_over_budget++;
+
+	pair_cache.NextFrame();
+}
+
+/*-----------------------------------------------------------------------------------
+Zero the counters of the frame
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TFrameStats::Clear()
+{
+	iterations = 0;
+	resting_contacts = 0;
+	over_budget = false;
+	t_exact = 1.0f;
+	corrections = 0;
+	collisions = 0;
+	max_simultaneous = 0;
+	frame_us = 0.0f;
+
+	for (int k = 0; k < NUM_COLLISION_TYPES; k++)
+	{
+		pairs[k] = 0;
+		responses[k] = 0;
+	}
+
+	for (int k = 0; k < NUM_GEOMATH_KINDS; k++)
+		geomath[k] = 0;
+
+	for (int k = 0; k < NUM_PHASES; k++)
+		phase_us[k] = 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------
+Find the earliest collision by testing every pair, respond to it and repeat
+until the end of the frame.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestScan(float dt)
+{
+	t_left = 1.0f;						// All time values normalized between 0 and 1
+	
+	while (t_left > 0.0f)
+	{
+		if (IsOverBudget())
+		{
+			SkipRest(dt);
+			break;
+		}
+
+		min_time = 1000.0f;
+		num_sim_collisions = 0;
+
+		UpdateBroadphase(dt);			// Bound the moving objects for this time slice
+
+		TestBallBall(dt);				// Test for collisions between balls
+		TestBallWall(dt);				// Test for collisions between balls and walls
+		TestBoxWall(dt);				// Test for collisions between boxes and walls
+		TestBoxBox(dt);					// Test for collisions between boxes
+		TestBoxBall(dt);				// Test for collisions between boxes and balls
+		TestBallMesh(dt);				// Test for collisions between balls and meshes
+				
+		if (num_sim_collisions)				// There was a collision
+		{
+			stats.iterations++;
+
+			// Advance objects according to displacement vectors 
+			// until first collision time 
+			AdvanceObjects(min_time, dt);
+
+			// Calculate collision reponse for any objects that may have collided
+			// (there could be some "simultaneous" collisions so any that occur
+			// at the same time are taken into account
+			ApplyResponses();
+
+			t_left -= min_time;
+		} // End if (num_sim_collisions)
+		else											// No more collisions
+		{
+			AdvanceObjects(t_left, dt);
+			t_left = 0.0f;
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Check if the frame has used up its iterations or its time
+-----------------------------------------------------------------------------------*/
+
+bool CCollisions::IsOverBudget()
+{
+	if (stats.iterations >= max_iterations)
+		return true;
+
+	if (budget_us <= 0)
+		return false;
+
+	chrono::microseconds elapsed = chrono::duration_cast<chrono::microseconds>(
+										chrono::steady_clock::now() - frame_start);
+	return elapsed.count() > budget_us;
+}
+
+/*-----------------------------------------------------------------------------------
+Once the frame has run out of budget the rest of it is approximated.  Every
+object is advanced to the end of the frame without looking for collisions and
+the objects this leaves overlapping are then pushed apart.  Objects that would
+have passed right through each other in the time left are missed, but nothing
+is left stuck inside anything else.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SkipRest(float dt)
+{
+	stats.over_budget = true;
+	stats.t_exact = 1.0f - t_left;
+
+	if (event_driven)
+	{
+		t_left = 0.0f;
+
+		for (int obj = 0; obj < num_balls + num_boxes; obj++)
+		{
+			if (!p_asleep[obj])
+				SyncObject(obj, dt);
+		}
+	}
+	else
+	{
+		AdvanceObjects(t_left, dt);
+		t_left = 0.0f;
+	}
+
+	ResolveOverlaps();
+}
+
+/*-----------------------------------------------------------------------------------
+Test every pair of objects whose bounds overlap for a static overlap and push
+apart those that do.  The pairs of moving objects are found with the hash grid
+whichever broadphase is used for the exact tests, as their bounds are not swept
+here.  A single pass is made, so an object pushed into another by a later pair
+may be left overlapping it slightly until the next frame.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::ResolveOverlaps()
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_OVERLAPS], "CCollisions::ResolveOverlaps");
+	CPerfScope perf(p_perf, perf_phases[PHASE_OVERLAPS]);
+
+	TVector no_motion(0.0f, 0.0f, 0.0f);
+	TVector normal;
+	float depth;
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		p_bounds[i] = SweptBounds(p_sim->GetBallCenter(i), p_sim->GetBallRadius(i), no_motion);
+	}
+	for (int i = 0; i < num_boxes; i++)
+	{
+		p_bounds[num_balls + i] = SweptBounds(p_sim->GetBoxBounds(i), no_motion);
+	}
+
+	int num_objects = num_balls + num_boxes;
+	grid.Build(p_bounds, num_objects);
+
+	grid.FindPairs(0, num_balls, 0, num_balls, pairs);
+	for (unsigned int k = 0; k < pairs.size(); k++)
+	{
+		int i = pairs[k].object1, j = pairs[k].object2;
+
+		if (IsPairAsleep(i, j, false))
+			continue;
+
+		stats.geomath[GEOMATH_OVERLAP]++;
+		if (OverlapBallBall(p_sim->GetBallCenter(i), p_sim->GetBallRadius(i),
+							p_sim->GetBallCenter(j), p_sim->GetBallRadius(j), normal, depth))
+			Separate(i, j, normal, depth);
+	}
+
+	grid.FindPairs(num_balls, num_objects, num_balls, num_objects, pairs);
+	for (unsigned int k = 0; k < pairs.size(); k++)
+	{
+		int t = pairs[k].object1, i = pairs[k].object2;
+
+		if (IsPairAsleep(num_balls + t, num_balls + i, false))
+			continue;
+
+		stats.geomath[GEOMATH_OVERLAP]++;
+		if (OverlapBoxBox(p_sim->GetBoxBounds(t), p_sim->GetBoxBounds(i), normal, depth))
+			Separate(num_balls + t, num_balls + i, normal, depth);
+	}
+
+	// Box and ball pairs come back box first
+	grid.FindPairs(num_balls, num_objects, 0, num_balls, pairs);
+	for (unsigned int k = 0; k < pairs.size(); k++)
+	{
+		int t = pairs[k].object1, i = pairs[k].object2;
+
+		if (IsPairAsleep(i, num_balls + t, false))
+			continue;
+
+		stats.geomath[GEOMATH_OVERLAP]++;
+		if (OverlapBallBox(	p_sim->GetBallCenter(i), p_sim->GetBallRadius(i),
+							p_sim->GetBoxBounds(t), normal, depth))
+			Separate(i, num_balls + t, normal, depth);
+	}
+
+	// Walls and meshes
+	for (int i = 0; i < num_balls; i++)
+	{
+		if (p_asleep[i])
+			continue;
+
+		wall_hits.clear();
+		wall_bvh.Query(p_bounds[i], wall_hits);
+		stats.geomath[GEOMATH_OVERLAP] += (int)wall_hits.size();
+
+		for (unsigned int k = 0; k < wall_hits.size(); k++)
+		{
+			if (OverlapBallWall(p_sim->GetBallCenter(i), p_sim->GetBallRadius(i),
+								p_walls[wall_hits[k]], normal, depth))
+				Separate(i, -1, normal, depth);
+		}
+
+		for (int m = 0; m < num_meshes; m++)
+		{
+			if (!Overlaps(p_bounds[i], p_mesh_bounds[m]))
+				continue;
+
+			stats.geomath[GEOMATH_OVERLAP]++;
+			if (OverlapBallMesh(p_sim->GetBallCenter(i), p_sim->GetBallRadius(i),
+								p_meshes[m], normal, depth))
+				Separate(i, -1, normal, depth);
+		}
+	}
+
+	for (int i = 0; i < num_boxes; i++)
+	{
+		if (p_asleep[num_balls + i])
+			continue;
+
+		wall_hits.clear();
+		wall_bvh.Query(p_bounds[num_balls + i], wall_hits);
+		stats.geomath[GEOMATH_OVERLAP] += (int)wall_hits.size();
+
+		for (unsigned int k = 0; k < wall_hits.size(); k++)
+		{
+			if (OverlapBoxWall(p_sim->GetBoxBounds(i), p_walls[wall_hits[k]], normal, depth))
+				Separate(num_balls + i, -1, normal, depth);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Push apart two overlapping objects along the normal from obj2 to obj1, obj2 is
+-1 for a wall or mesh.  Two moving objects are each moved half of the depth,
+against a static one the whole of it is taken by obj1.  Whatever speed they are
+still closing at along the normal is taken away in the same shares, so they do
+not overlap again straight away.  A sleeping object that is pushed is woken.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::Separate(int obj1, int obj2, const TVector& normal, float depth)
+{
+	TVector vel2(0.0f, 0.0f, 0.0f);
+	float share = 1.0f;
+
+	if (obj2 >= 0)
+	{
+		vel2 = GetObjectVel(obj2);
+		share = 0.5f;
+	}
+
+	float closing = (GetObjectVel(obj1) - vel2) * normal;
+	TVector dvel = (closing < 0.0f) ? normal * (-closing * share) : TVector(0.0f, 0.0f, 0.0f);
+
+	Nudge(obj1, normal * (depth * share), dvel);
+	if (obj2 >= 0)
+		Nudge(obj2, normal * (-depth * share), -dvel);
+
+	stats.corrections++;
+}
+
+/*-----------------------------------------------------------------------------------
+Move an object and change its velocity outside of the exact tests
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::Nudge(int obj, const TVector& disp, const TVector& dvel)
+{
+	if (p_asleep[obj])
+		WakeObject(obj, false);
+
+	if (obj < num_balls)
+	{
+		p_sim->MoveBall(obj, disp);
+		p_sim->SetBallVel(obj, p_sim->GetBallVel(obj) + dvel);
+	}
+	else
+	{
+		p_sim->MoveBox(obj - num_balls, disp);
+		p_sim->SetBoxVel(obj - num_balls, p_sim->GetBoxVel(obj - num_balls) + dvel);
+	}
+
+	p_travel[obj] += Magnitude(disp);
+	p_versions[obj]++;
+}
+
+/*-----------------------------------------------------------------------------------
+Advance all the objects according to their displacement vectors by time.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::AdvanceObjects(float time, float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_ADVANCE], "CCollisions::AdvanceObjects");
+	CPerfScope perf(p_perf, perf_phases[PHASE_ADVANCE]);
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		if (p_asleep[i])
+			continue;
+
+		p_sim->MoveBall(i, p_sim->GetBallVel(i) * dt * time);
+		p_travel[i] += Magnitude(p_sim->GetBallVel(i)) * dt * time;
+	}
+	for (int i = 0; i < num_boxes; i++)
+	{
+		if (p_asleep[num_balls + i])
+			continue;
+
+		p_sim->MoveBox(i, p_sim->GetBoxVel(i) * dt * time);
+		p_travel[num_balls + i] += Magnitude(p_sim->GetBoxVel(i)) * dt * time;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Calculate the collision response for each of the num_sim_collisions collisions.
+A sleeping object that is hit is woken first.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::ApplyResponses()
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_RESPONSE], "CCollisions::ApplyResponses");
+	CPerfScope perf(p_perf, perf_phases[PHASE_RESPONSE]);
+
+	stats.collisions += num_sim_collisions;
+	stats.max_simultaneous = MAX(stats.max_simultaneous, num_sim_collisions);
+
+	for (int i = 0; i < num_sim_collisions; i++)
+	{
+		int obj1, obj2;
+		GetObjects(p_cdata[i], obj1, obj2);
+
+		if (obj2 >= 0)
+		{
+			if (p_asleep[obj1])
+				WakeObject(obj1, IsMoving(obj2));
+			if (p_asleep[obj2])
+				WakeObject(obj2, IsMoving(obj1));
+		}
+	}
+
+	for (int i = 0; i < num_sim_collisions; i++)
+	{
+		stats.responses[p_cdata[i].collID]++;
+
+		if (p_cdata[i].collID == BALL_BALL_COLLISION)
+			BallBallResponse(i);
+		else if (p_cdata[i].collID == BALL_WALL_COLLISION)
+			BallWallResponse(i);
+		else if (p_cdata[i].collID == BOX_WALL_COLLISION)
+			BoxWallResponse(i);
+		else if (p_cdata[i].collID == BOX_BOX_COLLISION)
+			BoxBoxResponse(i);
+		else if (p_cdata[i].collID == BALL_BOX_COLLISION)
+			BallBoxResponse(i);
+		else if (p_cdata[i].collID == BALL_MESH_COLLISION)
+			BallMeshResponse(i);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Event driven version of Test.  Rescanning every pair after each collision repeats
+the tests of all the objects the response did not touch.  Instead every collision
+within the frame is predicted once at the start of the frame and kept in a queue
+ordered by time.  The earliest event (and any within ZERO of it) is taken off the
+queue, the objects are advanced to it and the response applied.  Only the pairs
+involving the objects whose velocity changed are then tested again.
+
+The events of an object that changed can no longer happen, rather than search the
+queue for them each ball and box carries a version which is bumped when it
+changes.  An event remembers the versions it was predicted with and is thrown
+away when it reaches the top of the queue if either no longer matches.
+
+Moving every object up to each event would cost as much as the tests saved, so
+each object keeps the frame time its position is at and is only advanced
+(SyncObject) when it is tested again, takes part in a collision or the frame ends.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestEvents(float dt)
+{
+	t_left = 1.0f;
+
+	while (!events.empty())
+		events.pop();
+
+	for (int obj = 0; obj < num_balls + num_boxes; obj++)
+		p_local_times[obj] = 0.0f;
+
+	// Predict all the collisions from the start of the frame
+	scheduling = true;
+
+	UpdateBroadphase(dt);
+
+	if (broadphase != BROADPHASE_NONE)
+	{
+		for (int obj = 0; obj < num_balls + num_boxes; obj++)
+			MoveEventProxy(obj, dt);
+	}
+
+	TestBallBall(dt);
+	TestBallWall(dt);
+	TestBoxWall(dt);
+	TestBoxBox(dt);
+	TestBoxBall(dt);
+	TestBallMesh(dt);
+	ScheduleEvents();
+
+	while (t_left > 0.0f)
+	{
+		if (IsOverBudget())
+		{
+			SkipRest(dt);
+			break;
+		}
+
+		while (!events.empty() && IsStale(events.top()))
+			events.pop();
+
+		if (events.empty())					// No more collisions
+		{
+			t_left = 0.0f;
+
+			for (int obj = 0; obj < num_balls + num_boxes; obj++)
+			{
+				if (!p_asleep[obj])
+					SyncObject(obj, dt);
+			}
+			break;
+		}
+
+		// Take the earliest event and those simultaneous with it
+		float event_time = events.top().time;
+		num_sim_collisions = 0;
+
+		while (!events.empty() && events.top().time - event_time <= ZERO &&
+				num_sim_collisions < max_collisions)
+		{
+			if (!IsStale(events.top()))
+				p_cdata[num_sim_collisions++] = events.top().data;
+
+			events.pop();
+		}
+
+		min_time = MAX(event_time - (1.0f - t_left), 0.0f);
+		t_left -= min_time;
+		stats.iterations++;
+
+		// Only the objects taking part are brought up to the time of the event
+		for (int i = 0; i < num_sim_collisions; i++)
+		{
+			int obj1, obj2;
+			GetObjects(p_cdata[i], obj1, obj2);
+
+			SyncObject(obj1, dt);
+			if (obj2 >= 0)
+				SyncObject(obj2, dt);
+		}
+
+		ApplyResponses();
+		RetestObjects(dt);
+		ScheduleEvents();
+	}
+
+	scheduling = false;
+}
+
+/*-----------------------------------------------------------------------------------
+Advance a ball or box from its own local time to the current frame time.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SyncObject(int obj, float dt)
+{
+	float now = 1.0f - t_left;
+	float time = now - p_local_times[obj];
+
+	if (time <= 0.0f)
+		return;
+
+	if (obj < num_balls)
+	{
+		p_sim->MoveBall(obj, p_sim->GetBallVel(obj) * dt * time);
+		p_travel[obj] += Magnitude(p_sim->GetBallVel(obj)) * dt * time;
+	}
+	else
+	{
+		p_sim->MoveBox(obj - num_balls, p_sim->GetBoxVel(obj - num_balls) * dt * time);
+		p_travel[obj] += Magnitude(p_sim->GetBoxVel(obj - num_balls)) * dt * time;
+	}
+
+	p_local_times[obj] = now;
+}
+
+/*-----------------------------------------------------------------------------------
+Stamp the events predicted since the last call with the current versions of
+their objects and add them to the queue.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::ScheduleEvents()
+{
+	for (unsigned int k = 0; k < new_events.size(); k++)
+	{
+		TEvent& e = new_events[k];
+		int obj1, obj2;
+		GetObjects(e.data, obj1, obj2);
+
+		e.version1 = p_versions[obj1];
+		e.version2 = obj2 >= 0 ? p_versions[obj2] : 0;
+		events.push(e);
+	}
+
+	new_events.clear();
+}
+
+/*-----------------------------------------------------------------------------------
+Check if either object of an event has changed since it was predicted.
+-----------------------------------------------------------------------------------*/
+
+bool CCollisions::IsStale(const TEvent& e) const
+{
+	int obj1, obj2;
+	GetObjects(e.data, obj1, obj2);
+
+	if (p_versions[obj1] != e.version1)
+		return true;
+
+	return (obj2 >= 0 && p_versions[obj2] != e.version2);
+}
+
+/*-----------------------------------------------------------------------------------
+Find the moving objects involved in a collision.  Balls are numbered from 0 and
+boxes from num_balls as in the swept bounds array, obj2 is -1 for a wall or mesh.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::GetObjects(const colldata& data, int& obj1, int& obj2) const
+{
+	switch (data.collID)
+	{
+	case BALL_BALL_COLLISION:
+		obj1 = data.object1;
+		obj2 = data.object2;
+		break;
+
+	case BALL_WALL_COLLISION:
+	case BALL_MESH_COLLISION:
+		obj1 = data.object1;
+		obj2 = -1;
+		break;
+
+	case BOX_WALL_COLLISION:
+		obj1 = num_balls + data.object1;
+		obj2 = -1;
+		break;
+
+	case BOX_BOX_COLLISION:
+		obj1 = num_balls + data.object1;
+		obj2 = num_balls + data.object2;
+		break;
+
+	default:	// BALL_BOX_COLLISION
+		obj1 = data.object1;
+		obj2 = num_balls + data.object2;
+		break;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Bump the versions of the objects in the collisions just responded to, which
+invalidates their events, and predict their collisions for the time left.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::RetestObjects(float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_RETEST], "CCollisions::RetestObjects");
+	CPerfScope perf(p_perf, perf_phases[PHASE_RETEST]);
+
+	batch++;
+	changed.clear();
+
+	for (int i = 0; i < num_sim_collisions; i++)
+	{
+		int obj[2];
+		GetObjects(p_cdata[i], obj[0], obj[1]);
+
+		for (int j = 0; j < 2; j++)
+		{
+			if (obj[j] >= 0 && p_marks[obj[j]] != batch)
+			{
+				p_marks[obj[j]] = batch;
+				p_versions[obj[j]]++;
+				changed.push_back(obj[j]);
+			}
+		}
+	}
+
+	// The swept bounds of the objects that did not change still cover them
+	for (unsigned int k = 0; k < changed.size(); k++)
+	{
+		int obj = changed[k];
+
+		if (obj < num_balls)
+			p_bounds[obj] = SweptBounds(p_sim->GetBallCenter(obj), p_sim->GetBallRadius(obj),
+										p_sim->GetBallVel(obj) * dt * t_left);
+		else
+			p_bounds[obj] = SweptBounds(p_sim->GetBoxBounds(obj - num_balls),
+										p_sim->GetBoxVel(obj - num_balls) * dt * t_left);
+
+		UpdateReach(obj, dt);
+
+		if (broadphase != BROADPHASE_NONE)
+			MoveEventProxy(obj, dt);
+	}
+
+	// A pair of changed objects is tested by whichever is retested first
+	for (unsigned int k = 0; k < changed.size(); k++)
+	{
+		RetestObject(changed[k], dt);
+		p_marks[changed[k]] = -batch;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Predict the collisions of one ball or box against everything else.  The balls
+and boxes whose swept bounds overlap its own are found in the event tree unless
+no broadphase is used, and the objects that are tested are synced to the current
+time first.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::RetestObject(int obj, float dt)
+{
+	bool cull = (broadphase != BROADPHASE_NONE);
+
+	GatherRetestObjects(obj);
+
+	if (obj < num_balls)
+	{
+		for (unsigned int k = 0; k < retest_hits.size(); k++)
+		{
+			int other = retest_hits[k];
+
+			SyncObject(other, dt);
+			if (other < num_balls)
+				TestBallBallPair(MIN(obj, other), MAX(obj, other), dt);
+			else
+				TestBoxBallPair(other - num_balls, obj, dt);
+		}
+
+		found.clear();
+		if (cull)
+		{
+			GatherBallWalls(obj, dt);
+			TestBallWallBlock(obj, wall_block, t_left, dt);
+		}
+		else
+			TestBallWallBlock(obj, all_walls, t_left, dt);
+
+		for (unsigned int k = 0; k < found.size(); k++)
+			AddCollision(found[k].time, BALL_WALL_COLLISION, obj, found[k].pair.object1);
+
+		for (int m = 0; m < num_meshes; m++)
+		{
+			if (!cull || Overlaps(p_bounds[obj], p_mesh_bounds[m]))
+				TestBallMeshPair(obj, m, dt);
+		}
+	}
+	else
+	{
+		int box = obj - num_balls;
+
+		for (unsigned int k = 0; k < retest_hits.size(); k++)
+		{
+			int other = retest_hits[k];
+
+			SyncObject(other, dt);
+			if (other < num_balls)
+				TestBoxBallPair(box, other, dt);
+			else
+				TestBoxBoxPair(MIN(box, other - num_balls), MAX(box, other - num_balls), dt);
+		}
+
+		wall_hits.clear();
+		if (cull)
+		{
+			float reach = Magnitude(p_sim->GetBoxMax(box) - p_sim->GetBoxMin(box)) +
+							Magnitude(p_sim->GetBoxVel(box) * dt * t_left) + BROADPHASE_MARGIN;
+			TVector ext(reach, reach, reach);
+			wall_bvh.Query(TAABB(p_sim->GetBoxMin(box) - ext, p_sim->GetBoxMax(box) + ext), wall_hits);
+		}
+		else
+		{
+			for (int i = 0; i < num_walls; i++)
+				wall_hits.push_back(i);
+		}
+
+		for (unsigned int k = 0; k < wall_hits.size(); k++)
+			TestBoxWallPair(box, wall_hits[k], dt);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Fill retest_hits with the balls and boxes obj has to be tested against again, in
+the order they are numbered in p_bounds.  With a broadphase these are the objects
+in the event tree whose swept bounds overlap those of obj, otherwise all of them.
+The objects already retested in this batch are left out.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::GatherRetestObjects(int obj)
+{
+	retest_hits.clear();
+
+	if (broadphase == BROADPHASE_NONE)
+	{
+		for (int other = 0; other < num_balls + num_boxes; other++)
+		{
+			if (other != obj && p_marks[other] != -batch)
+				retest_hits.push_back(other);
+		}
+		return;
+	}
+
+	event_hits.clear();
+	event_tree.Query(p_bounds[obj], event_hits);
+	sort(event_hits.begin(), event_hits.end());
+
+	// The tree holds fat bounds, check the swept bounds as well
+	for (unsigned int k = 0; k < event_hits.size(); k++)
+	{
+		int other = event_hits[k];
+
+		if (other != obj && p_marks[other] != -batch && Overlaps(p_bounds[obj], p_bounds[other]))
+			retest_hits.push_back(other);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Update the leaf of a ball or box in the event tree with its swept bounds
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::MoveEventProxy(int obj, float dt)
+{
+	TVector disp = GetObjectVel(obj) * dt * t_left;
+	event_tree.MoveProxy(p_event_proxies[obj], p_bounds[obj], disp);
+}
+
+/*-----------------------------------------------------------------------------------
+Select the broadphase used to cull the pairs of moving objects before they are
+handed to the geometric tests (BROADPHASE_NONE tests every pair).
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetBroadphase(int mode)
+{
+	assert(mode >= BROADPHASE_NONE && mode <= BROADPHASE_TREE);
+
+	broadphase = mode;
+}
+
+/*-----------------------------------------------------------------------------------
+Set the edge length of the cells of the hash grid broadphase.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetGridCellSize(float size)
+{
+	grid.SetCellSize(size);
+}
+
+/*-----------------------------------------------------------------------------------
+Switch between rescanning every pair after each collision and the event driven
+scheduler (see TestEvents).
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetEventDriven(bool enable)
+{
+	event_driven = enable;
+}
+
+/*-----------------------------------------------------------------------------------
+Turn the pair cache on or off.  The cache relies on the distance each object can
+move which is found along with the swept bounds, so it is only used with a
+broadphase.  On the generated gas, pit, towers, tunnel and maze maps of 1000
+objects the collision tests took 0 to 15% longer with it on, the pairs that stay
+apart are mostly culled by the broadphase already and the tests of the rest are
+not much dearer than the hash table lookups.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetPairCache(bool enable)
+{
+	use_pair_cache = enable;
+	pair_cache.Clear();
+}
+
+/*-----------------------------------------------------------------------------------
+Turn sleeping on or off.  Every object is woken when it is turned off.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetSleeping(bool enable)
+{
+	use_sleeping = enable;
+
+	if (!enable)
+	{
+		for (int obj = 0; obj < num_balls + num_boxes; obj++)
+		{
+			if (p_asleep[obj])
+				WakeObject(obj, true);
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Limit the collision iterations of a frame, the time they may take is given to
+each call to Test.  Once either runs out the rest of the frame is approximated.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetBudget(int iterations)
+{
+	assert(iterations > 0);
+
+	max_iterations = iterations;
+}
+
+/*-----------------------------------------------------------------------------------
+Read the counters around each phase of the tests and each geomath call from now
+on, adding to counts which start from 0.  The counters must be opened on the
+thread that calls Test.  NULL stops the counting.  The static overlap tests are
+only counted as part of the overlaps phase.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::SetPerfCounters(CPerfCounters *p_perf)
+{
+	this->p_perf = (p_perf != NULL && p_perf->IsOpen()) ? p_perf : NULL;
+
+	for (int k = 0; k < NUM_PHASES; k++)
+		perf_phases[k].Clear();
+
+	for (int k = 0; k < NUM_GEOMATH_KINDS; k++)
+		perf_geomath[k].Clear();
+}
+
+/*-----------------------------------------------------------------------------------
+A ball or box whose speed stays under SLEEP_SPEED at the end of SLEEP_FRAMES
+frames in a row is put to sleep.  Its velocity is zeroed, the game stops applying
+gravity to it and it is left out of the advance loops and of every test against
+walls, meshes and other sleeping objects, so a settled scene costs next to
+nothing.  Moving objects are still tested against it.
+
+A sleeping object is woken when the game gives it a velocity, when
+an object moving faster than SLEEP_SPEED reaches its bounds, and when anything
+collides with it.  The objects resting against each other in a pile keep
+nudging one another, so when they are hit by an object that is still itself
+they wake up without losing the frames they have been still for, and go back
+to sleep at the end of the frame unless they were knocked loose.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::WakeChangedObjects()
+{
+	TVector no_motion(0.0f, 0.0f, 0.0f);
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		if (p_asleep[i] && !(p_sim->GetBallVel(i) == no_motion))
+			WakeObject(i, true);
+	}
+
+	for (int i = 0; i < num_boxes; i++)
+	{
+		if (p_asleep[num_balls + i] && !(p_sim->GetBoxVel(i) == no_motion))
+			WakeObject(num_balls + i, true);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Count the frames each object has stayed still for at the end of a frame and put
+those that have been still long enough to sleep
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::UpdateSleep()
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_SLEEP], "CCollisions::UpdateSleep");
+	CPerfScope perf(p_perf, perf_phases[PHASE_SLEEP]);
+
+	TVector no_motion(0.0f, 0.0f, 0.0f);
+
+	for (int obj = 0; obj < num_balls + num_boxes; obj++)
+	{
+		if (p_asleep[obj])
+			continue;
+
+		if (!use_sleeping || IsMoving(obj))
+		{
+			p_still_frames[obj] = 0;
+			continue;
+		}
+
+		if (++p_still_frames[obj] < SLEEP_FRAMES)
+			continue;
+
+		p_asleep[obj] = true;
+		num_asleep++;
+
+		if (obj < num_balls)
+			p_sim->SetBallVel(obj, no_motion);
+		else
+			p_sim->SetBoxVel(obj - num_balls, no_motion);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Wake a sleeping object, reset makes it wait SLEEP_FRAMES again before sleeping
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::WakeObject(int obj, bool reset)
+{
+	assert(p_asleep[obj]);
+
+	p_asleep[obj] = false;
+	num_asleep--;
+
+	if (reset)
+		p_still_frames[obj] = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Check if an object is moving too fast to be still
+-----------------------------------------------------------------------------------*/
+
+bool CCollisions::IsMoving(int obj) const
+{
+	return Magnitude(GetObjectVel(obj)) >= SLEEP_SPEED;
+}
+
+/*-----------------------------------------------------------------------------------
+Velocity of a ball or box numbered as in the swept bounds array
+-----------------------------------------------------------------------------------*/
+
+TVector CCollisions::GetObjectVel(int obj) const
+{
+	if (obj < num_balls)
+		return p_sim->GetBallVel(obj);
+
+	return p_sim->GetBoxVel(obj - num_balls);
+}
+
+/*-----------------------------------------------------------------------------------
+Check if a pair can be skipped because both objects are asleep, obj2 is -1 for
+a wall or mesh which never moves.  When wake is set a sleeping object is woken by
+a moving one whose swept bounds overlap its own, whichever broadphase found the
+pair (or none did).
+-----------------------------------------------------------------------------------*/
+
+bool CCollisions::IsPairAsleep(int obj1, int obj2, bool wake)
+{
+	bool asleep1 = p_asleep[obj1];
+	bool asleep2 = (obj2 < 0 || p_asleep[obj2]);
+
+	if (asleep1 && asleep2)
+		return true;
+
+	if (wake && obj2 >= 0 && asleep1 != asleep2)
+	{
+		int sleeper = asleep1 ? obj1 : obj2;
+		int mover = asleep1 ? obj2 : obj1;
+
+		if (IsMoving(mover) && Overlaps(p_bounds[obj1], p_bounds[obj2]))
+			WakeObject(sleeper, true);
+	}
+
+	return false;
+}
+
+/*-----------------------------------------------------------------------------------
+Lower bounds on the distance between objects, found without any of the geometric
+tests.  The walls are treated as their whole plane.
+-----------------------------------------------------------------------------------*/
+
+// Distance from a sphere to a box
+static float BallBoxGap(const TVector& center, float radius, const TAABB& box)
+{
+	TVector closest(MAX(box.minv.x, MIN(box.maxv.x, center.x)),
+					MAX(box.minv.y, MIN(box.maxv.y, center.y)),
+					MAX(box.minv.z, MIN(box.maxv.z, center.z)));
+
+	return Magnitude(center - closest) - radius;
+}
+
+// Largest gap between two boxes along an axis
+static float BoxBoxGap(const TAABB& a, const TAABB& b)
+{
+	float gap = MAX(b.minv.x - a.maxv.x, a.minv.x - b.maxv.x);
+	gap = MAX(gap, MAX(b.minv.y - a.maxv.y, a.minv.y - b.maxv.y));
+	gap = MAX(gap, MAX(b.minv.z - a.maxv.z, a.minv.z - b.maxv.z));
+
+	return gap;
+}
+
+// Distance from a box to the plane of a wall
+static float BoxWallGap(const TAABB& box, const TWall& wall)
+{
+	TVector center = (box.minv + box.maxv) * 0.5f;
+	TVector half = (box.maxv - box.minv) * 0.5f;
+	float extent =	ABS(wall.normal.x) * half.x + ABS(wall.normal.y) * half.y +
+					ABS(wall.normal.z) * half.z;
+
+	return ABS(center * wall.normal - wall.distance) - extent;
+}
+
+// Distance from a sphere to the planes of a convex mesh
+static float BallMeshGap(const TVector& center, float radius, const TConvexMesh& mesh)
+{
+	float gap = -radius;
+	for (unsigned int f = 0; f < mesh.faces.size(); f++)
+		gap = MAX(gap, center * mesh.faces[f].normal - mesh.faces[f].distance - radius);
+
+	return gap;
+}
+
+/*-----------------------------------------------------------------------------------
+Distance an object can move in the time left, used to decide if a cached pair
+can meet.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::UpdateReach(int obj, float dt)
+{
+	if (obj < num_balls)
+		p_reach[obj] = Magnitude(p_sim->GetBallVel(obj)) * dt * t_left;
+	else
+		p_reach[obj] = Magnitude(p_sim->GetBoxVel(obj - num_balls)) * dt * t_left;
+}
+
+/*-----------------------------------------------------------------------------------
+Check the cache for a pair which can not meet in the time left.  The gap left
+between the objects is at least the gap when the pair was last tested less the
+distance both objects have moved since, and the pair can be skipped if it is
+more than they can both move in the time left.  Objects are never moved without
+adding to their travel, so this holds however their velocities have changed.
+-----------------------------------------------------------------------------------*/
+
+bool CCollisions::IsPairApart(int type, int id1, int id2, int obj1, int obj2)
+{
+	if (!IsCacheActive())
+		return false;
+
+	CPairCache::TEntry *p_entry = pair_cache.Find(type, id1, id2);
+	if (p_entry == NULL)
+		return false;
+
+	double gap = p_entry->gap - (p_travel[obj1] - p_entry->travel1);
+	float reach = p_reach[obj1];
+
+	if (obj2 >= 0)
+	{
+		gap -= p_travel[obj2] - p_entry->travel2;
+		reach += p_reach[obj2];
+	}
+
+	return gap > reach + PAIR_CACHE_MARGIN;
+}
+
+/*-----------------------------------------------------------------------------------
+Remember the gap of a pair that has just been tested
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::RecordPair(int type, int id1, int id2, int obj1, int obj2, float gap)
+{
+	if (!IsCacheActive())
+		return;
+
+	CPairCache::TEntry *p_entry = pair_cache.Insert(type, id1, id2);
+	p_entry->gap = gap;
+	p_entry->travel1 = p_travel[obj1];
+	p_entry->travel2 = (obj2 >= 0) ? p_travel[obj2] : 0.0;
+}
+
+/*-----------------------------------------------------------------------------------
+Compute the swept bounds of the balls and boxes over the time left in the frame
+and update the active broadphase with them.  The bounds are stored with the
+balls as objects [0, num_balls) and the boxes as [num_balls, num_balls + num_boxes).
+They are computed without a broadphase too, to find the sleeping objects a moving
+one may reach.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::UpdateBroadphase(float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_BROADPHASE], "CCollisions::UpdateBroadphase");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BROADPHASE]);
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		p_bounds[i] = SweptBounds(	p_sim->GetBallCenter(i), p_sim->GetBallRadius(i),
+									p_sim->GetBallVel(i) * dt * t_left);
+	}
+	for (int i = 0; i < num_boxes; i++)
+	{
+		p_bounds[num_balls + i] = SweptBounds(	p_sim->GetBoxBounds(i),
+												p_sim->GetBoxVel(i) * dt * t_left);
+	}
+
+	if (IsCacheActive())
+	{
+		for (int obj = 0; obj < num_balls + num_boxes; obj++)
+			UpdateReach(obj, dt);
+	}
+
+	if (broadphase == BROADPHASE_NONE)
+		return;
+
+	if (broadphase == BROADPHASE_GRID)
+	{
+		grid.Build(p_bounds, num_balls + num_boxes);
+		return;
+	}
+
+	if (broadphase == BROADPHASE_SAP)
+	{
+		for (int i = 0; i < num_balls; i++)
+		{
+			ball_sap.Update(i, p_bounds[i]);
+		}
+		return;
+	}
+
+	// The balls go in the grid on their own, they are mostly of a size and the
+	// sweep along one axis finds far too many pairs in a crowd of them
+	grid.Build(p_bounds, num_balls);
+
+	// Boxes that stay inside their fat bounds are left where they are in the tree
+	for (int i = 0; i < num_boxes; i++)
+	{
+		box_tree.MoveProxy(	p_box_proxies[i], p_bounds[num_balls + i],
+							p_sim->GetBoxVel(i) * dt * t_left);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Record a collision if it occurs between 0 and t_left.  A collision at the same
+time as the earliest one found so far (within ZERO) is added to the list, one
+which is sooner replaces the list.  While scheduling events every collision is
+queued instead.  Returns the collision data to be filled in, or NULL if the
+collision was discarded.
+-----------------------------------------------------------------------------------*/
+
+CCollisions::colldata* CCollisions::AddCollision(float time, int coll_id, int object1, int object2)
+{
+	// Ensure collision is between 0 and t_left
+	if (time < 0.0f || time > t_left)
+		return NULL;
+
+	// Objects left resting against each other touch all the time
+	if (!contacts.empty() && IsRestingContact(coll_id, object1, object2))
+		return NULL;
+
+	// The event scheduler keeps every collision, not just the earliest
+	if (scheduling)
+	{
+		TEvent e;
+		e.time = (1.0f - t_left) + time;
+		e.data.collID = coll_id;
+		e.data.object1 = object1;
+		e.data.object2 = object2;
+		new_events.push_back(e);
+
+		return &new_events.back().data;
+	}
+
+	// If collision is at the same time as another collision add it to the list
+	if (abs(time - min_time) <= ZERO)
+	{
+		if (num_sim_collisions == max_collisions)
+			return NULL;					// It will be found again next iteration
+
+		num_sim_collisions++;
+	}
+	// If collision is sooner than those previous
+	else if (time < min_time)
+	{
+		num_sim_collisions = 1;
+		min_time = time;
+	}
+	else
+		return NULL;
+
+	colldata *p_data = &p_cdata[num_sim_collisions - 1];
+	p_data->collID = coll_id;
+	p_data->object1 = object1;
+	p_data->object2 = object2;
+
+	return p_data;
+}
+
+/*-----------------------------------------------------------------------------------
+Test for collisions between balls.  The broadphases return the candidate pairs
+in the same order as a loop over every pair would visit them so the collisions
+found are identical to testing all pairs.
+
+Each ball is tested against all of its candidates at once with the batched test.
+Without a broadphase the candidates are the balls after it, which are already
+contiguous in the store, otherwise they are gathered into ball_block.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBallBall(float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_BALL_BALL], "CCollisions::TestBallBall");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BALL_BALL]);
+
+	ReserveBlockResults(num_balls);
+
+	const TPair *p_pairs = NULL;
+	int num_pairs = 0;
+
+	if (broadphase == BROADPHASE_SAP)
+	{
+		// Only the pairs whose swept bounds overlap over the time left can collide
+		num_pairs = ball_sap.FindPairs();
+		p_pairs = ball_sap.GetPairs();
+	}
+	else if (broadphase == BROADPHASE_GRID || broadphase == BROADPHASE_TREE)
+	{
+		num_pairs = grid.FindPairs(0, num_balls, 0, num_balls, pairs);
+		p_pairs = num_pairs ? &pairs[0] : NULL;
+	}
+	else
+	{
+		for (int t = 0; t < num_balls - 1; t++)
+		{
+			int first = t + 1;
+
+			// A sleeping ball is only tested against the balls that are awake
+			if (p_asleep[t])
+			{
+				ball_block.Clear();
+				for (int i = first; i < num_balls; i++)
+				{
+					if (!p_asleep[i])
+						ball_block.Add(*p_sim, i);
+				}
+
+				if (ball_block.Size() > 0)
+				{
+					TestBallBallBlock(	t, &ball_block.x[0], &ball_block.y[0], &ball_block.z[0],
+										&ball_block.radius[0], &ball_block.vx[0], &ball_block.vy[0],
+										&ball_block.vz[0], ball_block.Size(), &ball_block.ids[0], 0, dt);
+				}
+				continue;
+			}
+
+			TestBallBallBlock(	t, p_sim->p_ball_x + first, p_sim->p_ball_y + first,
+								p_sim->p_ball_z + first, p_sim->p_ball_radius + first,
+								p_sim->p_ball_vx + first, p_sim->p_ball_vy + first,
+								p_sim->p_ball_vz + first, num_balls - first, NULL, first, dt);
+		}
+		return;
+	}
+
+	bool cache = IsCacheActive();
+
+	// The pairs are sorted so the candidates of each ball are consecutive
+	for (int k = 0; k < num_pairs; )
+	{
+		int t = p_pairs[k].object1;
+		TVector center = p_sim->GetBallCenter(t);
+		float radius = p_sim->GetBallRadius(t);
+
+		ball_block.Clear();
+		for (; k < num_pairs && p_pairs[k].object1 == t; k++)
+		{
+			int i = p_pairs[k].object2;
+
+			if (IsPairAsleep(t, i, true))
+				continue;
+
+			if (cache)
+			{
+				if (IsPairApart(BALL_BALL_COLLISION, t, i, t, i))
+					continue;
+
+				RecordPair(	BALL_BALL_COLLISION, t, i, t, i,
+							Magnitude(center - p_sim->GetBallCenter(i)) - radius -
+							p_sim->GetBallRadius(i));
+			}
+
+			ball_block.Add(*p_sim, i);
+		}
+
+		if (ball_block.Size() == 0)
+			continue;
+
+		TestBallBallBlock(	t, &ball_block.x[0], &ball_block.y[0], &ball_block.z[0],
+							&ball_block.radius[0], &ball_block.vx[0], &ball_block.vy[0],
+							&ball_block.vz[0], ball_block.Size(), &ball_block.ids[0], 0, dt);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Make sure a batched test of num objects has room for its results
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::ReserveBlockResults(int num)
+{
+	if ((int)block_hits.size() < num)
+	{
+		block_hits.resize(num);
+		block_times.resize(num);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Test ball t against a block of balls.  The ball of a hit is ids[hit], or first +
+hit when there are no ids.
+
+Outside of scheduling AddCollision keeps only the collisions within ZERO of the
+earliest found so far, so the batch only needs to return those up to twice ZERO
+past it (the extra ZERO covers the rounding of the window).  Every hit is then
+passed on in order so the collisions kept are the same as testing each pair.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBallBallBlock(int t, const float *x, const float *y, const float *z,
+									const float *radii, const float *vx, const float *vy,
+									const float *vz, int num, const int *ids, int first,
+									float dt)
+{
+	float t_max = scheduling ? t_left : MIN(t_left, min_time + 2.0f * ZERO);
+	float earliest = t_max;
+
+	stats.pairs[BALL_BALL_COLLISION] += num;
+	stats.geomath[GEOMATH_BALL_BALL_BATCH]++;
+
+	int num_hits;
+	{
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BALL_BALL_BATCH]);
+		num_hits = IntersectBallBallBatch(	p_sim->GetBallCenter(t), p_sim->GetBallRadius(t),
+											p_sim->GetBallVel(t) * dt, x, y, z, radii,
+											vx, vy, vz, dt, num, t_max,
+											&block_hits[0], &block_times[0], earliest);
+	}
+
+	for (int k = 0; k < num_hits; k++)
+	{
+		int i = ids ? ids[block_hits[k]] : first + block_hits[k];
+		AddCollision(block_times[k], BALL_BALL_COLLISION, t, i);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Empty the block of candidate balls
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TBallBlock::Clear()
+{
+	ids.clear();
+	x.clear();	y.clear();	z.clear();
+	radius.clear();
+	vx.clear();	vy.clear();	vz.clear();
+}
+
+/*-----------------------------------------------------------------------------------
+Copy ball i from the store to the end of the block
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TBallBlock::Add(const CSimStore& sim, int i)
+{
+	ids.push_back(i);
+	x.push_back(sim.p_ball_x[i]);
+	y.push_back(sim.p_ball_y[i]);
+	z.push_back(sim.p_ball_z[i]);
+	radius.push_back(sim.p_ball_radius[i]);
+	vx.push_back(sim.p_ball_vx[i]);
+	vy.push_back(sim.p_ball_vy[i]);
+	vz.push_back(sim.p_ball_vz[i]);
+}
+
+/*-----------------------------------------------------------------------------------
+Test for a collision between two balls
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBallBallPair(int t, int i, float dt)
+{
+	if (IsPairAsleep(t, i, true) ||
+		IsPairApart(BALL_BALL_COLLISION, t, i, t, i))
+		return;
+
+	TVector ball_vel1 = p_sim->GetBallVel(t);
+	float rad_1 = p_sim->GetBallRadius(t);
+	TVector center1 = p_sim->GetBallCenter(t);
+
+	TVector ball_vel2 = p_sim->GetBallVel(i);
+	float rad_2 = p_sim->GetBallRadius(i);
+	TVector center2 = p_sim->GetBallCenter(i);
+
+	stats.pairs[BALL_BALL_COLLISION]++;
+	stats.geomath[GEOMATH_BALL_BALL]++;
+
+	// Get time of collision
+	float temp_time;
+	{
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BALL_BALL]);
+		temp_time = IntersectBallBall(	center1, rad_1, ball_vel1 * dt,
+										center2, rad_2, ball_vel2 * dt);
+	}
+
+	AddCollision(temp_time, BALL_BALL_COLLISION, t, i);
+
+	if (IsCacheActive())
+		RecordPair(BALL_BALL_COLLISION, t, i, t, i, Magnitude(center1 - center2) - rad_1 - rad_2);
+}
+
+/*-----------------------------------------------------------------------------------
+Test for collisions between balls and walls.
+
+A ball can only hit a wall whose quad contains the projection of the ball's
+centre onto the wall plane (IsBallOnWall), and only if the centre is no further
+than the radius plus the distance travelled from the plane.  So the walls are
+looked up in the wall tree with a cube of that size around the centre.  Each
+ball is tested against its candidate walls (or every wall) in a single batched
+pass, then the collisions are recorded wall by wall like the loop over every
+wall does.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBallWall(float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_BALL_WALL], "CCollisions::TestBallWall");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BALL_WALL]);
+
+	ReserveBlockResults(num_walls);
+
+	float t_max = scheduling ? t_left : MIN(t_left, min_time + 2.0f * ZERO);
+	found.clear();
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		if (p_asleep[i])
+			continue;
+
+		if (broadphase == BROADPHASE_NONE)
+		{
+			TestBallWallBlock(i, all_walls, t_max, dt);
+			continue;
+		}
+
+		GatherBallWalls(i, dt);
+		TestBallWallBlock(i, wall_block, t_max, dt);
+	}
+
+	// Record the collisions wall by wall like the loop over every wall does
+	sort(found.begin(), found.end());
+
+	for (unsigned int k = 0; k < found.size(); k++)
+		AddCollision(found[k].time, BALL_WALL_COLLISION, found[k].pair.object2, found[k].pair.object1);
+}
+
+/*-----------------------------------------------------------------------------------
+Fill wall_block with the walls ball i may reach in the time left, found in the
+wall tree.  Walls the pair cache shows are out of reach are left out.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::GatherBallWalls(int i, float dt)
+{
+	TVector center = p_sim->GetBallCenter(i);
+	float radius = p_sim->GetBallRadius(i);
+	float reach = radius + Magnitude(p_sim->GetBallVel(i) * dt * t_left) + BROADPHASE_MARGIN;
+	TVector ext(reach, reach, reach);
+
+	wall_hits.clear();
+	wall_bvh.Query(TAABB(center - ext, center + ext), wall_hits);
+
+	bool cache = IsCacheActive();
+
+	wall_block.Clear();
+	for (unsigned int k = 0; k < wall_hits.size(); k++)
+	{
+		const TWall& wall = p_walls[wall_hits[k]];
+
+		if (cache)
+		{
+			if (IsPairApart(BALL_WALL_COLLISION, i, wall_hits[k], i, -1))
+				continue;
+
+			RecordPair(	BALL_WALL_COLLISION, i, wall_hits[k], i, -1,
+						ABS(center * wall.normal - wall.distance) - radius);
+		}
+
+		wall_block.Add(wall, wall_hits[k]);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Test ball i against a block of walls in one pass, adding the collisions up to
+t_max to found
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBallWallBlock(int i, const TWallBlock& block, float t_max, float dt)
+{
+	if (block.Size() == 0)
+		return;
+
+	float earliest = t_max;
+	int earliest_wall;
+
+	stats.pairs[BALL_WALL_COLLISION] += block.Size();
+	stats.geomath[GEOMATH_BALL_WALL_BATCH]++;
+
+	int num_hits;
+	{
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BALL_WALL_BATCH]);
+		num_hits = IntersectBallWallBatch(	p_sim->GetBallCenter(i), p_sim->GetBallRadius(i),
+											p_sim->GetBallVel(i) * dt, block.Arrays(),
+											block.Size(), t_max, &block_hits[0],
+											&block_times[0], earliest, earliest_wall);
+	}
+
+	for (int k = 0; k < num_hits; k++)
+	{
+		TFound f;
+		f.pair.object1 = block.ids[block_hits[k]];
+		f.pair.object2 = i;
+		f.time = block_times[k];
+		found.push_back(f);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Empty the block of walls
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TWallBlock::Clear()
+{
+	ids.clear();
+	nx.clear();	ny.clear();	nz.clear();
+	distance.clear();
+
+	for (int j = 0; j < 4; j++)
+	{
+		to_x[j].clear();
+		to_y[j].clear();
+	}
+
+	min_x.clear();	max_x.clear();
+	min_y.clear();	max_y.clear();
+}
+
+/*-----------------------------------------------------------------------------------
+Copy wall i to the end of the block.  The local coordinates of a point are given
+by the first two columns of the inverse transform of the wall (see IsPointOnWall).
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TWallBlock::Add(const TWall& wall, int i)
+{
+	ids.push_back(i);
+	nx.push_back(wall.normal.x);
+	ny.push_back(wall.normal.y);
+	nz.push_back(wall.normal.z);
+	distance.push_back(wall.distance);
+
+	for (int j = 0; j < 4; j++)
+	{
+		to_x[j].push_back(wall.inv_trans.m[j * 4]);
+		to_y[j].push_back(wall.inv_trans.m[j * 4 + 1]);
+	}
+
+	min_x.push_back(wall.min_x);
+	max_x.push_back(wall.max_x);
+	min_y.push_back(wall.min_y);
+	max_y.push_back(wall.max_y);
+}
+
+/*-----------------------------------------------------------------------------------
+Pointers to the arrays of the block, which must not be empty
+-----------------------------------------------------------------------------------*/
+
+TWallArrays CCollisions::TWallBlock::Arrays() const
+{
+	TWallArrays a;
+	a.nx = &nx[0];
+	a.ny = &ny[0];
+	a.nz = &nz[0];
+	a.distance = &distance[0];
+
+	for (int j = 0; j < 4; j++)
+	{
+		a.to_x[j] = &to_x[j][0];
+		a.to_y[j] = &to_y[j][0];
+	}
+
+	a.min_x = &min_x[0];
+	a.max_x = &max_x[0];
+	a.min_y = &min_y[0];
+	a.max_y = &max_y[0];
+
+	return a;
+}
+
+/*-----------------------------------------------------------------------------------
+Test for collisions between boxes and walls.
+
+A box only hits a wall whose quad contains the projection of its min or max
+corner (IsBoxOnWall), and only once the box is closer to the plane than its
+own diagonal plus the distance travelled.  The wall tree is queried with the
+box grown by that distance.
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBoxWall(float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_BOX_WALL], "CCollisions::TestBoxWall");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BOX_WALL]);
+
+	for (int t = 0; t < num_boxes; t++)
+	{
+		if (p_asleep[num_balls + t])
+			continue;
+
+		if (broadphase == BROADPHASE_NONE)
+		{
+			for (int i = 0; i < num_walls; i++)
+				TestBoxWallPair(t, i, dt);
+			continue;
+		}
+
+		float reach = Magnitude(p_sim->GetBoxMax(t) - p_sim->GetBoxMin(t)) +
+						Magnitude(p_sim->GetBoxVel(t) * dt * t_left) + BROADPHASE_MARGIN;
+		TVector ext(reach, reach, reach);
+
+		wall_hits.clear();
+		wall_bvh.Query(TAABB(p_sim->GetBoxMin(t) - ext, p_sim->GetBoxMax(t) + ext), wall_hits);
+		sort(wall_hits.begin(), wall_hits.end());
+
+		for (unsigned int k = 0; k < wall_hits.size(); k++)
+			TestBoxWallPair(t, wall_hits[k], dt);
+	}
+}
 
 /*-----------------------------------------------------------------------------------
-The world object reference that is passed to the constructor is used to create
-pointers to all the world object in the CWorld class so that their state variables
-can be visible for performing geometric tests and applying physics responses.
+Test for a collision between box t and wall i
 -----------------------------------------------------------------------------------*/
 
-CCollisions::CCollisions(CWorld &world)
+void CCollisions::TestBoxWallPair(int t, int i, float dt)
 {
-	num_walls = world.num_walls;
-	num_balls = world.num_balls;
-	num_boxes = world.num_boxes;
+	if (IsPairAsleep(num_balls + t, -1, false) ||
+		IsPairApart(BOX_WALL_COLLISION, t, i, num_balls + t, -1))
+		return;
 
-	p_walls = world.p_walls;
-	p_balls = world.p_balls;
-	p_boxes = world.p_boxes;
+	float temp_time;
 
-	// Size array large enough for max # of simultaneous collisions
-	p_cdata = new colldata[num_balls + num_boxes];
+	TVector box_min = p_sim->GetBoxMin(t);
+	TVector box_max = p_sim->GetBoxMax(t);
+	TVector box_vel = p_sim->GetBoxVel(t);
+
+	float wall_distance = p_walls[i].distance;
+	TVector wall_normal = p_walls[i].normal;
+
+	stats.pairs[BOX_WALL_COLLISION]++;
+	stats.geomath[GEOMATH_BOX_WALL]++;
+
+	// Check that the box would make contact with the wall then check if it
+	// will do so within the alloted time slice
+	{
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BOX_WALL]);
+
+		if (IsBoxOnWall(p_sim->GetBoxBounds(t), p_walls[i])) {
+			temp_time = IntersectBoxPlane(	box_min, box_max, box_vel * dt,
+											wall_distance, wall_normal);
+		}
+		else {
+			temp_time = -1.0f;
+		}
+	}
+
+	AddCollision(temp_time, BOX_WALL_COLLISION, t, i);
+
+	if (IsCacheActive())
+		RecordPair(	BOX_WALL_COLLISION, t, i, num_balls + t, -1,
+					BoxWallGap(p_sim->GetBoxBounds(t), p_walls[i]));
 }
 
 /*-----------------------------------------------------------------------------------
-The collision tests performed return the time at which a collision will occur.  Each
-frame is alotted a time value of 1.  All collision tests are performed and the
-collision which occurs the soones and is less than 1 is chosen.  The simulation
-advances forward in time until the first collision at which time the collision
-response effects are calculated for the objects that have collided.  The initial
-time value of 1 is decremented by that collision time (i.e. 1 - collision time where
-collision time was 0.75 = 0.25 left).  If there is still time left the collision
-tests are conducted again to see if there will be a collision within that time
-step (i.e. 0.25) if there is (the first one of course) the same process of
-advancing to that time and calculating the collision response is conducted.  Oncse
-the time value reaches 0 no more collisions within the time interval will occur
-and the simulation will advance to the next frame.  If no collisions occured
-within 1 from the beginning, all the objects are simply advanced by this time
-step.
-
-Note: The value ZERO can be considered an 'epsilon' value.  Any collisions that
-occur within 'epsilon' time of eachother are considered to be simultaneous
-collisions.  (This has to be done to avoid rounding errors)
+Test for collisions between boxes.  As with the balls each box is tested against
+all of its candidates at once, in pair order.
 -----------------------------------------------------------------------------------*/
 
-void CCollisions::Test(float dt)
+void CCollisions::TestBoxBox(float dt)
 {
-	t_left = 1.0f;						// All time values normalized between 0 and 1
-	
-	while (t_left > 0.0f)
+	TPhaseTimer timer(stats.phase_us[PHASE_BOX_BOX], "CCollisions::TestBoxBox");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BOX_BOX]);
+
+	ReserveBlockResults(num_boxes);
+
+	if (broadphase == BROADPHASE_GRID)
 	{
-		min_time = 1000.0f;
-		num_sim_collisions = 0;
+		grid.FindPairs(	num_balls, num_balls + num_boxes,
+						num_balls, num_balls + num_boxes, pairs);
+	}
+	else if (broadphase == BROADPHASE_TREE)
+	{
+		pairs.clear();
 
-		TestBallBall(dt);				// Test for collisions between balls
-		TestBallWall(dt);				// Test for collisions between balls and walls
-		TestBoxWall(dt);				// Test for collisions between boxes and walls
-		TestBoxBox(dt);					// Test for collisions between boxes
-		TestBoxBall(dt);				// Test for collisions between boxes and balls
-				
-		if (num_sim_collisions)				// There was a collision
+		for (int t = 0; t < num_boxes; t++)
 		{
-			// Advance objects according to displacement vectors 
-			// until first collision time 
-			for (int i = 0; i < num_balls; i++)
+			const TAABB& bounds = p_bounds[num_balls + t];
+
+			box_hits.clear();
+			box_tree.Query(bounds, box_hits);
+
+			// The tree holds fat bounds, check the swept bounds as well
+			for (unsigned int k = 0; k < box_hits.size(); k++)
 			{
-				p_balls[i].center += p_balls[i].vel * dt * min_time;
+				int i = box_hits[k];
+				if (i > t && Overlaps(bounds, p_bounds[num_balls + i]))
+				{
+					TPair pair;
+					pair.object1 = t;
+					pair.object2 = i;
+					pairs.push_back(pair);
+				}
 			}
-			for (int i = 0; i < num_boxes; i++)
+		}
+
+		sort(pairs.begin(), pairs.end());
+	}
+	else
+	{
+		for (int t = 0; t < num_boxes - 1; t++)
+		{
+			int first = t + 1;
+
+			// A sleeping box is only tested against the boxes that are awake
+			if (p_asleep[num_balls + t])
 			{
-				p_boxes[i].maxv += p_boxes[i].vel * dt * min_time;
-				p_boxes[i].minv += p_boxes[i].vel * dt * min_time;
+				box_block.Clear();
+				for (int i = first; i < num_boxes; i++)
+				{
+					if (!p_asleep[num_balls + i])
+						box_block.Add(*p_sim, i);
+				}
+
+				if (box_block.Size() > 0)
+				{
+					TestBoxBoxBlock(t, &box_block.min_x[0], &box_block.min_y[0], &box_block.min_z[0],
+									&box_block.max_x[0], &box_block.max_y[0], &box_block.max_z[0],
+									&box_block.vx[0], &box_block.vy[0], &box_block.vz[0],
+									box_block.Size(), &box_block.ids[0], 0, dt);
+				}
+				continue;
 			}
 
-			// Calculate collision reponse for any objects that may have collided
-			// (there could be some "simultaneous" collisions so any that occur
-			// at the same time are taken into account
-			for (int i = 0; i < num_sim_collisions; i++)
-			{
-				if (p_cdata[i].collID == BALL_BALL_COLLISION)
-					BallBallResponse(i);
-				else if (p_cdata[i].collID == BALL_WALL_COLLISION)
-					BallWallResponse(i);
-				else if (p_cdata[i].collID == BOX_WALL_COLLISION)
-					BoxWallResponse(i);
-				else if (p_cdata[i].collID == BOX_BOX_COLLISION)
-					BoxBoxResponse(i);
-				else if (p_cdata[i].collID == BALL_BOX_COLLISION)
-					BallBoxResponse(i);
-			} // End for
+			TestBoxBoxBlock(t, p_sim->p_box_min_x + first, p_sim->p_box_min_y + first,
+							p_sim->p_box_min_z + first, p_sim->p_box_max_x + first,
+							p_sim->p_box_max_y + first, p_sim->p_box_max_z + first,
+							p_sim->p_box_vx + first, p_sim->p_box_vy + first,
+							p_sim->p_box_vz + first, num_boxes - first, NULL, first, dt);
+		}
+		return;
+	}
 
-			t_left -= min_time;
-		} // End if (num_sim_collisions)
-		else											// No more collisions
+	bool cache = IsCacheActive();
+
+	// The pairs are sorted so the candidates of each box are consecutive
+	for (unsigned int k = 0; k < pairs.size(); )
+	{
+		int t = pairs[k].object1;
+		TAABB box = p_sim->GetBoxBounds(t);
+
+		box_block.Clear();
+		for (; k < pairs.size() && pairs[k].object1 == t; k++)
 		{
-			for (int i = 0; i < num_balls; i++)
-			{
-				p_balls[i].center += p_balls[i].vel * dt * t_left;
-			}
-			for (int i = 0; i < num_boxes; i++)
+			int i = pairs[k].object2;
+
+			if (IsPairAsleep(num_balls + t, num_balls + i, true))
+				continue;
+
+			if (cache)
 			{
-				p_boxes[i].maxv += p_boxes[i].vel * dt * t_left;
-				p_boxes[i].minv += p_boxes[i].vel * dt * t_left;
+				if (IsPairApart(BOX_BOX_COLLISION, t, i, num_balls + t, num_balls + i))
+					continue;
+
+				RecordPair(	BOX_BOX_COLLISION, t, i, num_balls + t, num_balls + i,
+							BoxBoxGap(box, p_sim->GetBoxBounds(i)));
 			}
-			t_left = 0.0f;
+
+			box_block.Add(*p_sim, i);
 		}
+
+		if (box_block.Size() == 0)
+			continue;
+
+		TestBoxBoxBlock(t, &box_block.min_x[0], &box_block.min_y[0], &box_block.min_z[0],
+						&box_block.max_x[0], &box_block.max_y[0], &box_block.max_z[0],
+						&box_block.vx[0], &box_block.vy[0], &box_block.vz[0],
+						box_block.Size(), &box_block.ids[0], 0, dt);
 	}
 }
 
 /*-----------------------------------------------------------------------------------
-Test for collisions between balls.
+Test box t against a block of boxes, the hits are passed on to AddCollision in
+the same way as TestBallBallBlock.
 -----------------------------------------------------------------------------------*/
 
-void CCollisions::TestBallBall(float dt)
+void CCollisions::TestBoxBoxBlock(	int t, const float *min_x, const float *min_y,
+									const float *min_z, const float *max_x, const float *max_y,
+									const float *max_z, const float *vx, const float *vy,
+									const float *vz, int num, const int *ids, int first,
+									float dt)
 {
-	float temp_time;
+	float t_max = scheduling ? t_left : MIN(t_left, min_time + 2.0f * ZERO);
+	float earliest = t_max;
+
+	stats.pairs[BOX_BOX_COLLISION] += num;
+	stats.geomath[GEOMATH_BOX_BOX_BATCH]++;
 
-	for (int t = 0; t < num_balls - 1; t++)
+	int num_hits;
 	{
-		TVector ball_vel1 = p_balls[t].vel;
-		float rad_1 = p_balls[t].radius;
-		TVector center1 = p_balls[t].center;
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BOX_BOX_BATCH]);
+		num_hits = IntersectBoxBoxBatch(p_sim->GetBoxMin(t), p_sim->GetBoxMax(t),
+										p_sim->GetBoxVel(t) * dt, min_x, min_y, min_z,
+										max_x, max_y, max_z, vx, vy, vz, dt, num, t_max,
+										&block_hits[0], &block_times[0], earliest);
+	}
 
-		for (int i = t + 1; i < num_balls; i++)
-		{
-			TVector ball_vel2 = p_balls[i].vel;
-			float rad_2 = p_balls[i].radius;
-			TVector center2 = p_balls[i].center;
+	for (int k = 0; k < num_hits; k++)
+	{
+		int i = ids ? ids[block_hits[k]] : first + block_hits[k];
+		AddCollision(block_times[k], BOX_BOX_COLLISION, t, i);
+	}
+}
 
-			// Get time of collision
-			temp_time = IntersectBallBall(	center1, rad_1, ball_vel1 * dt, 
-											center2, rad_2, ball_vel2 * dt);
+/*-----------------------------------------------------------------------------------
+Empty the block of candidate boxes
+-----------------------------------------------------------------------------------*/
 
-			// Ensure collision is between 0 and t_left
-			if (temp_time >= 0.0f && temp_time <= t_left)
-			{
-				// If collision is at the same time as another collision add it to the list
-				if (abs(temp_time - min_time) <= ZERO)
-				{
-					num_sim_collisions++;
-					p_cdata[num_sim_collisions - 1].collID = BALL_BALL_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = t;
-					p_cdata[num_sim_collisions - 1].object2 = i;
-				}
-				// If collision is sooner than those previous
-				else if (temp_time < min_time)
-				{
-					num_sim_collisions = 1;
-					min_time = temp_time;
-					p_cdata[num_sim_collisions - 1].collID = BALL_BALL_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = t;
-					p_cdata[num_sim_collisions - 1].object2 = i;
-				}
-			} // End if		
-		} // End for
-	} // End for
+void CCollisions::TBoxBlock::Clear()
+{
+	ids.clear();
+	min_x.clear();	min_y.clear();	min_z.clear();
+	max_x.clear();	max_y.clear();	max_z.clear();
+	vx.clear();		vy.clear();		vz.clear();
 }
 
 /*-----------------------------------------------------------------------------------
-Test for collisions between balls and walls
+Copy box i from the store to the end of the block
 -----------------------------------------------------------------------------------*/
 
-void CCollisions::TestBallWall(float dt)
+void CCollisions::TBoxBlock::Add(const CSimStore& sim, int i)
 {
-	float temp_time;
+	ids.push_back(i);
+	min_x.push_back(sim.p_box_min_x[i]);
+	min_y.push_back(sim.p_box_min_y[i]);
+	min_z.push_back(sim.p_box_min_z[i]);
+	max_x.push_back(sim.p_box_max_x[i]);
+	max_y.push_back(sim.p_box_max_y[i]);
+	max_z.push_back(sim.p_box_max_z[i]);
+	vx.push_back(sim.p_box_vx[i]);
+	vy.push_back(sim.p_box_vy[i]);
+	vz.push_back(sim.p_box_vz[i]);
+}
+
+/*-----------------------------------------------------------------------------------
+Test for a collision between two boxes
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::TestBoxBoxPair(int t, int i, float dt)
+{
+	if (IsPairAsleep(num_balls + t, num_balls + i, true) ||
+		IsPairApart(BOX_BOX_COLLISION, t, i, num_balls + t, num_balls + i))
+		return;
+
+	TVector box_min1 = p_sim->GetBoxMin(t);
+	TVector box_max1 = p_sim->GetBoxMax(t);
+	TVector box_vel1 = p_sim->GetBoxVel(t);
 
-	for (int t = 0; t < num_walls; t++)
+	TVector box_min2 = p_sim->GetBoxMin(i);
+	TVector box_max2 = p_sim->GetBoxMax(i);
+	TVector box_vel2 = p_sim->GetBoxVel(i);
+
+	stats.pairs[BOX_BOX_COLLISION]++;
+	stats.geomath[GEOMATH_BOX_BOX]++;
+
+	float temp_time;
 	{
-		TVector wall_point = p_walls[t].point1 * p_walls[t].trans;
-		TVector wall_normal = p_walls[t].normal;
-		
-		for (int i = 0; i < num_balls; i++)
-		{
-			TVector ball_vel = p_balls[i].vel;
-			float rad = p_balls[i].radius;
-			TVector center = p_balls[i].center;
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BOX_BOX]);
+		temp_time = IntersectBoxBox(box_min1, box_max1, box_vel1 * dt,
+									box_min2, box_max2, box_vel2 * dt);
+	}
 
-			// Check that the ball would make contact with the wall then check if it
-			// will do so within the alloted time slice
-			if (IsBallOnWall(p_balls[i], p_walls[t])) {
-				temp_time = IntersectBallPlane(	center, rad, ball_vel * dt,
-												wall_point, wall_normal);
-			}
-			else {
-				temp_time = -1.0f;
-			}
+	AddCollision(temp_time, BOX_BOX_COLLISION, t, i);
 
-			// Ensure collision is between 0 and t_left
-			if (temp_time >= 0.0f && temp_time <= t_left)
-			{
-				// If collision is at the same time as another collision add it to the list
-				if (abs(temp_time - min_time) <= ZERO)
-				{
-					num_sim_collisions++;
-					p_cdata[num_sim_collisions - 1].collID = BALL_WALL_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = i;
-					p_cdata[num_sim_collisions - 1].object2 = t;
-				}
-				// If collision is sooner than those previous
-				else if (temp_time < min_time)
-				{
-					num_sim_collisions = 1;
-					min_time = temp_time;
-					p_cdata[num_sim_collisions - 1].collID = BALL_WALL_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = i;
-					p_cdata[num_sim_collisions - 1].object2 = t;
-				}
-			} // End if		
-		} // End for
-	} // End for
+	if (IsCacheActive())
+		RecordPair(	BOX_BOX_COLLISION, t, i, num_balls + t, num_balls + i,
+					BoxBoxGap(TAABB(box_min1, box_max1), TAABB(box_min2, box_max2)));
 }
 
 /*-----------------------------------------------------------------------------------
-Test for collisions between boxes and walls
+Test for collisions between boxes and balls.
 -----------------------------------------------------------------------------------*/
 
-void CCollisions::TestBoxWall(float dt)
+void CCollisions::TestBoxBall(float dt)
 {
-	float temp_time;
+	TPhaseTimer timer(stats.phase_us[PHASE_BOX_BALL], "CCollisions::TestBoxBall");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BOX_BALL]);
 
-	for (int t = 0; t < num_boxes; t++)
+	if (broadphase == BROADPHASE_GRID)
 	{
-		TVector box_min = p_boxes[t].minv;
-		TVector box_max = p_boxes[t].maxv;
-		TVector box_vel = p_boxes[t].vel;
-		for (int i = 0; i < num_walls; i++)
-		{
-			TVector wall_point = p_walls[i].point1 * p_walls[i].trans;
-			TVector wall_normal = p_walls[i].normal;
-			wall_normal.Normalize();
+		int num_pairs = grid.FindPairs(	num_balls, num_balls + num_boxes,
+										0, num_balls, pairs);
 
-			// Check that the box would make contact with the wall then check if it
-			// will do so within the alloted time slice
-			if (IsBoxOnWall(p_boxes[t], p_walls[i])) {
-				temp_time = IntersectBoxPlane(	box_min, box_max, box_vel * dt,
-												wall_point, wall_normal);
-			}
-			else {
-				temp_time = -1.0f;
-			}
+		for (int k = 0; k < num_pairs; k++)
+			TestBoxBallPair(pairs[k].object1, pairs[k].object2, dt);
+	}
+	else if (broadphase == BROADPHASE_TREE)
+	{
+		pairs.clear();
+
+		for (int i = 0; i < num_balls; i++)
+		{
+			box_hits.clear();
+			box_tree.Query(p_bounds[i], box_hits);
 
-			if (temp_time >= 0.0f && temp_time <= t_left)
+			for (unsigned int k = 0; k < box_hits.size(); k++)
 			{
-				// If collision is at the same time as another collision add it to the list
-				if (abs(temp_time - min_time) <= ZERO)
-				{
-					num_sim_collisions++;
-					p_cdata[num_sim_collisions - 1].collID = BOX_WALL_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = t;
-					p_cdata[num_sim_collisions - 1].object2 = i;
-				}
-				// If collision is sooner than those previous
-				else if (temp_time < min_time)
+				int t = box_hits[k];
+				if (Overlaps(p_bounds[i], p_bounds[num_balls + t]))
 				{
-					num_sim_collisions = 1;
-					min_time = temp_time;
-					p_cdata[num_sim_collisions - 1].collID = BOX_WALL_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = t;
-					p_cdata[num_sim_collisions - 1].object2 = i;
+					TPair pair;
+					pair.object1 = t;
+					pair.object2 = i;
+					pairs.push_back(pair);
 				}
-			} // End if		
-		} // End for
-	} // End for
+			}
+		}
+
+		sort(pairs.begin(), pairs.end());
+
+		for (unsigned int k = 0; k < pairs.size(); k++)
+			TestBoxBallPair(pairs[k].object1, pairs[k].object2, dt);
+	}
+	else
+	{
+		for (int t = 0; t < num_boxes; t++)
+			for (int i = 0; i < num_balls; i++)
+				TestBoxBallPair(t, i, dt);
+	}
 }
 
 /*-----------------------------------------------------------------------------------
-Test for collisions between boxes
+Test for a collision between a box and a ball.  The box is axis aligned so the
+ball is tested against the box rounded by its radius directly, which also finds
+the face, edge or corner of the box that is hit.
 -----------------------------------------------------------------------------------*/
 
-void CCollisions::TestBoxBox(float dt)
+void CCollisions::TestBoxBallPair(int t, int i, float dt)
 {
+	if (IsPairAsleep(i, num_balls + t, true) ||
+		IsPairApart(BALL_BOX_COLLISION, i, t, i, num_balls + t))
+		return;
+
+	TVector face[3];							// 3 corners of the face hit
+	TVector ep1, ep2;							// Edge vertices
+	bool edge_collision;						// Used when balls hit edges of blocks
+
+	TAABB box = p_sim->GetBoxBounds(t);
+	TVector box_vel = p_sim->GetBoxVel(t);
+
+	TVector ball_vel = p_sim->GetBallVel(i);
+	float rad = p_sim->GetBallRadius(i);
+	TVector center = p_sim->GetBallCenter(i);
+
+	stats.pairs[BALL_BOX_COLLISION]++;
+	stats.geomath[GEOMATH_BALL_BOX]++;
+
 	float temp_time;
+	{
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BALL_BOX]);
+		temp_time = IntersectBallBox(	center, rad, ball_vel * dt, box, box_vel * dt, t_left,
+										edge_collision, face, ep1, ep2);
+	}
 
-	for (int t = 0; t < num_boxes - 1; t++)
+	colldata *p_data = AddCollision(temp_time, BALL_BOX_COLLISION, i, t);
+	if (p_data != NULL)
 	{
-		TVector box_min1 = p_boxes[t].minv;
-		TVector box_max1 = p_boxes[t].maxv;
-		TVector box_vel1 = p_boxes[t].vel;
+		p_data->edge_collision = edge_collision;
+		p_data->v1 = face[0];
+		p_data->v2 = face[1];
+		p_data->v3 = face[2];
+		p_data->edge_p1 = ep1;
+		p_data->edge_p2 = ep2;
+	}
 
-		for (int i = t + 1; i < num_boxes; i++)
-		{
-			TVector box_min2 = p_boxes[i].minv;
-			TVector box_max2 = p_boxes[i].maxv;
-			TVector box_vel2 = p_boxes[i].vel;
+	if (IsCacheActive())
+		RecordPair(BALL_BOX_COLLISION, i, t, i, num_balls + t, BallBoxGap(center, rad, box));
+}
 
-			temp_time = IntersectBoxBox(	box_min1, box_max1, box_vel1 * dt,
-											box_min2, box_max2, box_vel2 * dt);
+/*-----------------------------------------------------------------------------------
+Test for collisions between balls and meshes.  There are few meshes, each ball
+is tested against those whose bounds its swept bounds overlap.
+-----------------------------------------------------------------------------------*/
 
-			if (temp_time >= 0.0f && temp_time <= t_left)
-			{
-				// If collision is at the same time as another collision add it to the list
-				if (abs(temp_time - min_time) <= ZERO)
-				{
-					num_sim_collisions++;
-					p_cdata[num_sim_collisions - 1].collID = BOX_BOX_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = t;
-					p_cdata[num_sim_collisions - 1].object2 = i;
-				}
-				// If collision is sooner than those previous
-				else if (temp_time < min_time)
-				{
-					num_sim_collisions = 1;
-					min_time = temp_time;
-					p_cdata[num_sim_collisions - 1].collID = BOX_BOX_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = t;
-					p_cdata[num_sim_collisions - 1].object2 = i;
-				}
-			} // End if		
-		} // End for
-	} // End for
+void CCollisions::TestBallMesh(float dt)
+{
+	TPhaseTimer timer(stats.phase_us[PHASE_BALL_MESH], "CCollisions::TestBallMesh");
+	CPerfScope perf(p_perf, perf_phases[PHASE_BALL_MESH]);
+
+	bool cull = (broadphase != BROADPHASE_NONE);
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		for (int m = 0; m < num_meshes; m++)
+		{
+			if (!cull || Overlaps(p_bounds[i], p_mesh_bounds[m]))
+				TestBallMeshPair(i, m, dt);
+		}
+	}
 }
 
 /*-----------------------------------------------------------------------------------
-Test for collisions between boxes and balls.  In order to achieve simmulation
-collision detection where we obtain the precise time of collision the box
-is decomposed into triangles and each triangle is tested for a collision
+Test for a collision between a ball and a mesh.  The normal where the ball hits
+the mesh is kept for the response.
 -----------------------------------------------------------------------------------*/
 
-void CCollisions::TestBoxBall(float dt)
+void CCollisions::TestBallMeshPair(int i, int m, float dt)
 {
-	float temp_time;
-	float t_min;								// Find fastest time
-	TVector vert[3];							// 3 vertices of a triangle
-	TVector ep1, ep2;							// Edge vertices
-	bool v_collision;							// true if vertex collision
-	bool edge_collision = false;				// Used when balls hit edges of blocks
-	bool top_collision = false;					// When balls hit top of blocks
+	if (IsPairAsleep(i, -1, false) || IsPairApart(BALL_MESH_COLLISION, i, m, i, -1))
+		return;
 
-	for (int t = 0; t < num_boxes; t++)
+	TVector normal;
+	TVector center = p_sim->GetBallCenter(i);
+	float radius = p_sim->GetBallRadius(i);
+
+	stats.pairs[BALL_MESH_COLLISION]++;
+	stats.geomath[GEOMATH_BALL_MESH]++;
+
+	float temp_time;
 	{
-		TVector box_min = p_boxes[t].minv;
-		TVector box_max = p_boxes[t].maxv;
-		TVector box_vel = p_boxes[t].vel;
+		CPerfScope perf(p_perf, perf_geomath[GEOMATH_BALL_MESH]);
+		temp_time = IntersectBallMesh(	center, radius, p_sim->GetBallVel(i) * dt,
+										p_meshes[m], t_left, normal);
+	}
 
-		for (int i = 0; i < num_balls; i++)
-		{
-			TVector ball_vel = p_balls[i].vel;
-			float rad = p_balls[i].radius;
-			TVector center = p_balls[i].center;
-
-			// We need to test for collision with the 4 sides of the cube and 
-			// the top, since balls will never make contact with the bottom.
-			// Each side will be composed of 2 triangles, resulting in 8 tests
-			// the smallest positive time value will be the resultant time of
-			// collision
-
-			temp_time = 1000.0f;
-			
-			// Front Face Triangle 1
-			vert[0] = p_boxes[t].GetVertex(4);
-			vert[1] = p_boxes[t].GetVertex(5);
-			vert[2] = p_boxes[t].GetVertex(6);
-
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+	colldata *p_data = AddCollision(temp_time, BALL_MESH_COLLISION, i, m);
+	if (p_data != NULL)
+		p_data->normal = normal;
 
-			// Front Face Triangle 2
-			vert[0] = p_boxes[t].GetVertex(5);
-			vert[1] = p_boxes[t].GetVertex(7);
-			vert[2] = p_boxes[t].GetVertex(6);
+	if (IsCacheActive())
+		RecordPair(BALL_MESH_COLLISION, i, m, i, -1, BallMeshGap(center, radius, p_meshes[m]));
+}
 
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+/*-----------------------------------------------------------------------------------
+Coefficient of restitution of an object hitting a static surface.  An object
+resting on the surface (gravity pulls it back in every frame) would bounce off
+it again and again, so a contact slower than RESTING_SPEED is stopped instead.
+A stopped object is left touching the surface, or just inside it after rounding,
+where the next frame's test finds it at a time below 0 and lets it through.  So
+it is moved CONTACT_SLOP away from the surface.
+-----------------------------------------------------------------------------------*/
 
-			// Left Face Triangle 1
-			vert[0] = p_boxes[t].GetVertex(6);
-			vert[1] = p_boxes[t].GetVertex(0);
-			vert[2] = p_boxes[t].GetVertex(2);
+float CCollisions::Restitution(int i, const TVector& vel, const TVector& normal)
+{
+	float vn = vel * normal;
 
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+	if (ABS(vn) < RESTING_SPEED)
+	{
+		TVector away = (vn < 0.0f) ? normal : -1.0f * normal;
 
-			// Left Face Triangle 2
-			vert[0] = p_boxes[t].GetVertex(6);
-			vert[1] = p_boxes[t].GetVertex(0);
-			vert[2] = p_boxes[t].GetVertex(4);
+		int obj1, obj2;
+		GetObjects(p_cdata[i], obj1, obj2);
+		Nudge(obj1, away * CONTACT_SLOP, TVector(0.0f, 0.0f, 0.0f));
 
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+		AddContact(i, away);
+		return 0.0f;
+	}
 
-			// Right Face Triangle 1
-			vert[0] = p_boxes[t].GetVertex(1);
-			vert[1] = p_boxes[t].GetVertex(3);
-			vert[2] = p_boxes[t].GetVertex(5);
+	return 0.5f;
+}
 
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+/*-----------------------------------------------------------------------------------
+Keep collision i as a resting contact for the rest of the frame, normal points from
+the second object towards the first.  The response leaves the objects touching
+with next to no speed between them along the normal, but rounding leaves enough
+for the same pair to be found colliding again straight away, over and over.  So
+until the end of the frame the pair only collides again if it closes in faster
+than CONTACT_SPEED, which would take it further into the other object than
+rounding does.
+-----------------------------------------------------------------------------------*/
 
-			// Right Face Triangle 2
-			vert[0] = p_boxes[t].GetVertex(5);
-			vert[1] = p_boxes[t].GetVertex(3);
-			vert[2] = p_boxes[t].GetVertex(7);
+void CCollisions::AddContact(int i, const TVector& normal)
+{
+	contacts[CPairCache::Key(p_cdata[i].collID, p_cdata[i].object1, p_cdata[i].object2)] = normal;
+	stats.resting_contacts++;
+}
 
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+/*-----------------------------------------------------------------------------------
+Check if a collision is a resting contact that is not closing in on itself
+-----------------------------------------------------------------------------------*/
 
-			// Top Face Triangle 1
-			vert[0] = p_boxes[t].GetVertex(7);
-			vert[1] = p_boxes[t].GetVertex(3);
-			vert[2] = p_boxes[t].GetVertex(2);
-
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f) {
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-			}
-			
-			// Top Face Triangle 2
-			vert[0] = p_boxes[t].GetVertex(6);
-			vert[1] = p_boxes[t].GetVertex(7);
-			vert[2] = p_boxes[t].GetVertex(2);
-
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f) {
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-			}
-			
-			// Back Face Triangle 1
-			vert[0] = p_boxes[t].GetVertex(2);
-			vert[1] = p_boxes[t].GetVertex(3);
-			vert[2] = p_boxes[t].GetVertex(0);
-
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-			if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+bool CCollisions::IsRestingContact(int coll_id, int object1, int object2) const
+{
+	map<unsigned long long, TVector>::const_iterator it =
+		contacts.find(CPairCache::Key(coll_id, object1, object2));
 
-			// Back Face Triangle 2
-			vert[0] = p_boxes[t].GetVertex(3);
-			vert[1] = p_boxes[t].GetVertex(1);
-			vert[2] = p_boxes[t].GetVertex(0);
+	if (it == contacts.end())
+		return false;
 
-			t_min = IntersectBallTriangle(	center, ball_vel * dt, rad,
-											box_vel * dt, vert, 1.0f, 
-											v_collision, ep1, ep2);
-			
-            if (t_min < temp_time && t_min >= 0.0f)
-			{
-				temp_time = t_min;
-				tri_coords[0] = vert[0]; tri_coords[1] = vert[1]; tri_coords[2] = vert[2];
-				edge_collision = v_collision;
-			}
+	colldata data;
+	data.collID = coll_id;
+	data.object1 = object1;
+	data.object2 = object2;
 
-			if (temp_time >= 0.0f && temp_time <= t_left)
-			{
-				// If collision is at the same time as another collision add it to the list
-				if (abs(temp_time - min_time) <= ZERO)
-				{
-					num_sim_collisions++;
-					p_cdata[num_sim_collisions - 1].collID = BALL_BOX_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = i;
-					p_cdata[num_sim_collisions - 1].object2 = t;
-					p_cdata[num_sim_collisions - 1].edge_collision = edge_collision;
-					p_cdata[num_sim_collisions - 1].v1 = tri_coords[0];
-					p_cdata[num_sim_collisions - 1].v2 = tri_coords[1];
-					p_cdata[num_sim_collisions - 1].v3 = tri_coords[2];
-					p_cdata[num_sim_collisions - 1].edge_p1 = ep1;
-					p_cdata[num_sim_collisions - 1].edge_p2 = ep2;
+	int obj1, obj2;
+	GetObjects(data, obj1, obj2);
 
-				}
-				// If collision is sooner than those previous
-				else if (temp_time < min_time)
-				{
-					num_sim_collisions = 1;
-					min_time = temp_time;
-					p_cdata[num_sim_collisions - 1].collID = BALL_BOX_COLLISION;
-					p_cdata[num_sim_collisions - 1].object1 = i;
-					p_cdata[num_sim_collisions - 1].object2 = t;
-					p_cdata[num_sim_collisions - 1].edge_collision = edge_collision;
-					p_cdata[num_sim_collisions - 1].v1 = tri_coords[0];
-					p_cdata[num_sim_collisions - 1].v2 = tri_coords[1];
-					p_cdata[num_sim_collisions - 1].v3 = tri_coords[2];
-					p_cdata[num_sim_collisions - 1].edge_p1 = ep1;
-					p_cdata[num_sim_collisions - 1].edge_p2 = ep2;
-				}
-			} // End if		
-			
-		} // End for
-	}
+	TVector vel = GetObjectVel(obj1);
+	if (obj2 >= 0)
+		vel -= GetObjectVel(obj2);
+
+	return -(vel * it->second) < CONTACT_SPEED;
 }
 
 /*-----------------------------------------------------------------------------------
@@ -565,24 +2339,34 @@ Apply collision response between two balls
 void CCollisions::BallBallResponse(int i)
 {
 	// Apply collision effects to both balls
-	float mass1 = 1.0f, mass2 = 1.0f;
 	int ball1_id = p_cdata[i].object1;
 	int ball2_id = p_cdata[i].object2;
 
-	TVector vel1 = p_balls[p_cdata[i].object1].vel;
-	TVector vel2 = p_balls[p_cdata[i].object2].vel;
+	TVector vel1 = p_sim->GetBallVel(ball1_id);
+	TVector vel2 = p_sim->GetBallVel(ball2_id);
+
+	TVector center1 = p_sim->GetBallCenter(ball1_id);
+	TVector center2 = p_sim->GetBallCenter(ball2_id);
 
-	MObjMObjEffects(vel1, p_balls[ball1_id].center,
-					vel2, p_balls[ball2_id].center);
+	// Balls that are only just touching stay together instead of bouncing (a pair
+	// that is already moving apart is not resting)
+	float speed = ApproachSpeed(vel1, center1, vel2, center2);
+	if (speed >= 0.0f && speed < RESTING_SPEED)
+	{
+		MObjMObjRestingEffects(vel1, center1, vel2, center2);
+		AddContact(i, Normalized(center1 - center2));
+	}
+	else
+		MObjMObjEffects(vel1, center1, vel2, center2);
 
 	// With the new velocity vectors we can adjust the
 	// speed, and axis of rotation for each ball
-	p_balls[ball1_id].vel = vel1;
+	p_sim->SetBallVel(ball1_id, vel1);
 	p_balls[ball1_id].axis.x = vel1.z;
 	p_balls[ball1_id].axis.z = -vel1.x;
 	p_balls[ball1_id].axis.Normalize();
 					
-	p_balls[ball2_id].vel = vel2;
+	p_sim->SetBallVel(ball2_id, vel2);
 	p_balls[ball2_id].axis.x = vel2.z;
 	p_balls[ball2_id].axis.z = -vel2.x;
 	p_balls[ball2_id].axis.Normalize();
@@ -598,13 +2382,13 @@ void CCollisions::BallWallResponse(int i)
 	int wall_id = p_cdata[i].object2;
 
 	TVector norm = p_walls[wall_id].normal;
-	TVector initial_vec = p_balls[ball_id].vel;
+	TVector initial_vec = p_sim->GetBallVel(ball_id);
 	
-	MObjSObjEffects(initial_vec, norm, 0.5f);
+	MObjSObjEffects(initial_vec, norm, Restitution(i, initial_vec, norm));
 	
 	// We now change the direction that the ball is moving in
 	// we do not change speed (we must also change the axis of rotation)
-	p_balls[ball_id].vel = initial_vec;
+	p_sim->SetBallVel(ball_id, initial_vec);
 	p_balls[ball_id].axis.x = initial_vec.z;
 	p_balls[ball_id].axis.z = -initial_vec.x;
 	p_balls[ball_id].axis.Normalize();
@@ -619,14 +2403,14 @@ void CCollisions::BoxWallResponse(int i)
 	int box_id = p_cdata[i].object1;
 	int wall_id = p_cdata[i].object2;
 
-	TVector initial_vec = p_boxes[box_id].vel;
+	TVector initial_vec = p_sim->GetBoxVel(box_id);
 	TVector norm = p_walls[wall_id].normal;
 
-	MObjSObjEffects(initial_vec, norm, 0.5f);
+	MObjSObjEffects(initial_vec, norm, Restitution(i, initial_vec, norm));
 	
 	// We now change the direction that the box is moving in
 	// we do not change speed
-	p_boxes[box_id].vel = initial_vec;
+	p_sim->SetBoxVel(box_id, initial_vec);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -636,22 +2420,30 @@ Apply collision response between boxes
 void CCollisions::BoxBoxResponse(int i)
 {
 	// Apply collision effects to both boxes
-	float mass1 = 1.0f, mass2 = 1.0f;
 	int box1_id = p_cdata[i].object1;
 	int box2_id = p_cdata[i].object2;
 
-	TVector vel1 = p_boxes[box1_id].vel;
-	TVector vel2 = p_boxes[box2_id].vel;
+	TVector vel1 = p_sim->GetBoxVel(box1_id);
+	TVector vel2 = p_sim->GetBoxVel(box2_id);
 
-	TVector center1 = (p_boxes[box1_id].maxv + p_boxes[box1_id].minv) * 0.5f;
-	TVector center2 = (p_boxes[box2_id].maxv + p_boxes[box2_id].minv) * 0.5f;
+	TVector center1 = (p_sim->GetBoxMax(box1_id) + p_sim->GetBoxMin(box1_id)) * 0.5f;
+	TVector center2 = (p_sim->GetBoxMax(box2_id) + p_sim->GetBoxMin(box2_id)) * 0.5f;
 
-	MObjMObjEffects2(vel1, center1, vel2, center2);
+	// Boxes stacked on each other stay together instead of bouncing (a pair
+	// that is already moving apart is not resting)
+	float speed = ApproachSpeed(vel1, center1, vel2, center2);
+	if (speed >= 0.0f && speed < RESTING_SPEED)
+	{
+		MObjMObjRestingEffects(vel1, center1, vel2, center2);
+		AddContact(i, Normalized(center1 - center2));
+	}
+	else
+		MObjMObjEffects2(vel1, center1, vel2, center2);
 
 	// With the new velocity vectors we can adjust the
 	// direction and speed of the boxes
-	p_boxes[box1_id].vel = vel1;					
-	p_boxes[box2_id].vel = vel2;
+	p_sim->SetBoxVel(box1_id, vel1);					
+	p_sim->SetBoxVel(box2_id, vel2);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -660,45 +2452,47 @@ Apply collision response between ball and box
 
 void CCollisions::BallBoxResponse(int i)
 {
-	float mass1 = 1.0f, mass2 = 1.0f;
 	int ball_id = p_cdata[i].object1;
 	int box_id = p_cdata[i].object2;
 
-	TVector vel1 = p_balls[ball_id].vel;
-	TVector vel2 = p_boxes[box_id].vel;
+	TVector vel1 = p_sim->GetBallVel(ball_id);
+	TVector vel2 = p_sim->GetBoxVel(box_id);
 
-	TVector center1 = p_balls[ball_id].center;
+	TVector center1 = p_sim->GetBallCenter(ball_id);
 
 	if (p_cdata[i].edge_collision) {
 		// We must first project the centre of the box onto the edge of collision
-		TVector v = p_balls[ball_id].center - p_cdata[i].edge_p1;		// Vector between edge base and center
-		TVector edge = p_cdata[i].edge_p2 - p_cdata[i].edge_p1;			// Edge vector
+		// (a corner is given as an edge of no length, which projects onto itself)
+		TVector v = center1 - p_cdata[i].edge_p1;						// Vector between edge base and center
+		TVector edge = Normalized(p_cdata[i].edge_p2 - p_cdata[i].edge_p1);	// Edge direction
 		float proj = v * edge;											// v projected on edge
-		TVector edge_point = p_cdata[i].edge_p1 + proj * Normalized(edge);
+		TVector edge_point = p_cdata[i].edge_p1 + proj * edge;
 
 		// Now we find the collision normal
-		TVector n_col = p_balls[ball_id].center - edge_point;
+		TVector n_col = center1 - edge_point;
 		n_col.Normalize();
 
 		// Move the ball a little bit away
-		p_balls[ball_id].center += (n_col * 0.001f);
+		p_sim->MoveBall(ball_id, (n_col * 0.001f));
+		p_travel[ball_id] += 0.001f;
 
 		// If the dot product of the normal of collision and the
 		// vector of the ball is less then 0, the objects are in compacted
-		float vb = p_balls[ball_id].vel * n_col;
+		float vb = p_sim->GetBallVel(ball_id) * n_col;
 
 		if (vb < 0.0f)
-			p_balls[ball_id].vel += (-2.0f * vb) * n_col;
+			p_sim->SetBallVel(ball_id, p_sim->GetBallVel(ball_id) + (-2.0f * vb) * n_col);
 
 		n_col *= -1.0f;
 
 		// Move the box a little bit away
-		p_boxes[box_id].minv += (n_col * 0.001f);
+		p_sim->SetBoxMin(box_id, p_sim->GetBoxMin(box_id) + (n_col * 0.001f));
+		p_travel[num_balls + box_id] += 0.001f;
 
-		vb = p_boxes[box_id].vel * n_col;
+		vb = p_sim->GetBoxVel(box_id) * n_col;
 
 		if (vb < 0.0f)
-			p_boxes[box_id].vel += (-2.0f * vb) * n_col;
+			p_sim->SetBoxVel(box_id, p_sim->GetBoxVel(box_id) + (-2.0f * vb) * n_col);
 	}
 	else {
 		// Simmulate a collision between the 
@@ -712,17 +2506,26 @@ void CCollisions::BallBoxResponse(int i)
 		n.Normalize();
 
 		// project center of ball onto plane
-		TVector center2 = center1 + (-1 * n * (center1 - tri_coords[0])) * n;
+		TVector center2 = center1 + (-1 * n * (center1 - p_cdata[i].v1)) * n;
 
-		MObjMObjEffects(vel1, center1, vel2, center2);
+		// A ball resting on the box stays on it instead of bouncing (a pair
+		// that is already moving apart is not resting)
+		float speed = ApproachSpeed(vel1, center1, vel2, center2);
+		if (speed >= 0.0f && speed < RESTING_SPEED)
+		{
+			MObjMObjRestingEffects(vel1, center1, vel2, center2);
+			AddContact(i, Normalized(center1 - center2));
+		}
+		else
+			MObjMObjEffects(vel1, center1, vel2, center2);
 		
 		// With the new velocity vectors we can adjust the
 		// direction, speed, and axis of rotation for the ball
 		// and the direction and speed of the box
-		p_balls[ball_id].vel = vel1;
-		p_balls[ball_id].axis.x = p_balls[ball_id].vel.z;
+		p_sim->SetBallVel(ball_id, vel1);
+		p_balls[ball_id].axis.x = p_sim->GetBallVel(ball_id).z;
 		p_balls[ball_id].axis.y = 0.0f;
-		p_balls[ball_id].axis.z = -p_balls[ball_id].vel.x;
+		p_balls[ball_id].axis.z = -p_sim->GetBallVel(ball_id).x;
 		if (Magnitude(p_balls[ball_id].axis) > 0.0f) {
 			p_balls[ball_id].axis.Normalize();
 		}
@@ -732,11 +2535,50 @@ void CCollisions::BallBoxResponse(int i)
 			p_balls[ball_id].axis.z = 0.0f;
 		}
 						
-		p_boxes[box_id].vel = vel2;
+		p_sim->SetBoxVel(box_id, vel2);
 	} // End else
 }
 
+/*-----------------------------------------------------------------------------------
+Apply collision response between ball and mesh, the mesh does not move so the
+ball bounces off the plane touching the mesh where it was hit
+-----------------------------------------------------------------------------------*/
+
+void CCollisions::BallMeshResponse(int i)
+{
+	int ball_id = p_cdata[i].object1;
+
+	TVector initial_vec = p_sim->GetBallVel(ball_id);
+	
+	MObjSObjEffects(initial_vec, p_cdata[i].normal, Restitution(i, initial_vec, p_cdata[i].normal));
+	
+	// Change the direction the ball is moving in and its axis of rotation
+	p_sim->SetBallVel(ball_id, initial_vec);
+	p_balls[ball_id].axis.x = initial_vec.z;
+	p_balls[ball_id].axis.y = 0.0f;
+	p_balls[ball_id].axis.z = -initial_vec.x;
+	if (Magnitude(p_balls[ball_id].axis) > 0.0f) {
+		p_balls[ball_id].axis.Normalize();
+	}
+	else {
+		p_balls[ball_id].axis.x = -1.0f;
+		p_balls[ball_id].axis.y = 0.0f;
+		p_balls[ball_id].axis.z = 0.0f;
+	}
+}
+
 CCollisions::~CCollisions()
 {
 	delete [] p_cdata;
+	delete [] p_mesh_bounds;
+	delete [] p_bounds;
+	delete [] p_box_proxies;
+	delete [] p_event_proxies;
+	delete [] p_versions;
+	delete [] p_marks;
+	delete [] p_local_times;
+	delete [] p_travel;
+	delete [] p_reach;
+	delete [] p_asleep;
+	delete [] p_still_frames;
 }
\ No newline at end of file
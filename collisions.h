@@ -7,7 +7,19 @@ Description:	Header file defining collision management class.
 #ifndef COLLISIONS_H
 #define COLLISIONS_H
 
-#include "world.h"
+#include "scene.h"
+#include "sweepPrune.h"			// Broadphase for ball pairs
+#include "spatialHash.h"		// Broadphase for ball and box pairs
+#include "bvh.h"					// Hierarchy over the static walls
+#include "aabbTree.h"			// Dynamic tree over the boxes
+#include "geoMath.h"				// Batched tests take blocks of arrays
+#include "pairCache.h"			// Separation of pairs kept between frames
+#include "trace.h"				// Phases are marked on the timeline when tracing
+#include "perfCounters.h"		// Hardware counters of the phases and kernels
+
+#include <queue>
+#include <map>
+#include <chrono>
 
 /*-----------------------------------------------------------------------------------
 Constants
@@ -19,6 +31,49 @@ Constants
 #define BOX_WALL_COLLISION			3
 #define BOX_BOX_COLLISION			4
 #define BALL_BOX_COLLISION			5
+#define BALL_MESH_COLLISION			6
+#define NUM_COLLISION_TYPES			7	// Counters are indexed by collID
+
+#define BROADPHASE_NONE				0	// Test every pair of objects
+#define BROADPHASE_SAP				1	// Sweep and prune the ball pairs
+#define BROADPHASE_GRID				2	// Hash grid for ball and box pairs
+#define BROADPHASE_TREE				3	// Hash grid for balls, AABB tree for boxes
+
+#define PAIR_CACHE_MARGIN			0.01f	// Gap a cached pair must keep to be skipped
+
+#define SLEEP_SPEED					0.75f	// Objects slower than this at the end of a frame are still
+#define SLEEP_FRAMES				25		// Frames an object must stay still before it sleeps
+
+#define TOI_MAX_ITERATIONS			256		// Collision iterations allowed in a frame
+#define TOI_BUDGET_US				10000	// Microseconds the game gives the exact tests of a frame
+#define RESTING_SPEED				1.0f	// Contacts approaching slower than this stop instead of bouncing
+#define CONTACT_SPEED				0.01f	// Resting contacts closing slower than this are not collisions
+#define CONTACT_SLOP				0.001f	// Gap left between a stopped object and the surface it rests on
+
+#define PHASE_BROADPHASE			0	// Parts of Test timed in the frame stats
+#define PHASE_BALL_BALL				1	// One for each Test* function
+#define PHASE_BALL_WALL				2
+#define PHASE_BOX_WALL				3
+#define PHASE_BOX_BOX				4
+#define PHASE_BOX_BALL				5
+#define PHASE_BALL_MESH				6
+#define PHASE_RETEST				7	// Event driven retests of the objects changed
+#define PHASE_ADVANCE				8
+#define PHASE_RESPONSE				9
+#define PHASE_OVERLAPS				10	// Pushing apart overlaps once over budget
+#define PHASE_SLEEP					11
+#define NUM_PHASES					12
+
+#define GEOMATH_BALL_BALL			0	// Geomath tests counted in the frame stats
+#define GEOMATH_BALL_BALL_BATCH		1	// A batched test counts once for the block
+#define GEOMATH_BALL_WALL_BATCH		2
+#define GEOMATH_BOX_WALL			3
+#define GEOMATH_BOX_BOX				4
+#define GEOMATH_BOX_BOX_BATCH		5
+#define GEOMATH_BALL_BOX			6
+#define GEOMATH_BALL_MESH			7
+#define GEOMATH_OVERLAP				8	// Any of the static overlap tests
+#define NUM_GEOMATH_KINDS			9
 
 class CCollisions
 {
@@ -32,48 +87,293 @@ public:
         int object1;
 		int object2;
 		bool edge_collision;
-		TVector v1, v2, v3;
-		TVector edge_p1, edge_p2;
+		TVector v1, v2, v3;			// Corners of the face of a box hit by a ball
+		TVector edge_p1, edge_p2;	// Edge of a box hit by a ball, equal at a corner
+		TVector normal;				// Normal of the mesh where a ball hits it
+	};
+
+	// Work done by the last call to Test
+	struct TFrameStats
+	{
+		int frame;					// # of the frame, counted from 1
+		int iterations;				// Batches of simultaneous collisions responded to
+		int resting_contacts;		// Collisions too slow to bounce which were stopped instead
+		bool over_budget;			// The iteration or time budget ran out
+		float t_exact;				// Frame time simulated exactly, the rest was approximated
+		int corrections;			// Overlaps pushed apart by the approximation
+		int collisions;				// Collisions responded to, over all the iterations
+		int max_simultaneous;		// Most collisions responded to in one iteration
+		int pairs[NUM_COLLISION_TYPES];			// Pairs given to the narrow phase, by collID
+		int responses[NUM_COLLISION_TYPES];		// Responses applied, by collID
+		int geomath[NUM_GEOMATH_KINDS];			// Calls of each geomath test
+		float phase_us[NUM_PHASES];				// Microseconds in each part of Test
+		float frame_us;				// Microseconds in the whole of Test
+
+		void Clear();				// Zero the counters of the frame, keeping its #
 	};
 	
 private:
 
+	// Collision predicted by the event driven scheduler.  The event is stale
+	// once either object has changed version since the prediction was made.
+	struct TEvent
+	{
+		float time;					// Frame time of the collision (0 to 1)
+		int version1;				// Versions of the objects when predicted
+		int version2;
+		colldata data;
+	};
+
+	// Adds the time from its creation to the end of its scope to a phase of the
+	// frame stats, and records the phase in the trace when it is recording
+	struct TPhaseTimer
+	{
+		float& us;
+		const char *name;
+		CTrace::TClock::time_point start;
+
+		TPhaseTimer(float& phase_us, const char *name)
+			: us(phase_us), name(name), start(CTrace::TClock::now()) {}
+		~TPhaseTimer()
+		{
+			CTrace::TClock::time_point end = CTrace::TClock::now();
+			us += chrono::duration<float, micro>(end - start).count();
+
+#ifndef NO_TRACE
+			if (CTrace::IsRecording())
+				CTrace::Record(name, start, end);
+#endif
+		}
+	};
+
+	// Orders the event queue so the earliest event is on top
+	struct TEventLater
+	{
+		bool operator () (const TEvent& a, const TEvent& b) const
+		{
+			return a.time > b.time;
+		}
+	};
+
+	// Candidate balls gathered into contiguous arrays for the batched tests
+	struct TBallBlock
+	{
+		vector<int> ids;
+		vector<float> x, y, z;
+		vector<float> radius;
+		vector<float> vx, vy, vz;
+
+		void Clear();
+		void Add(const CSimStore& sim, int i);
+		int Size() const { return (int)ids.size(); }
+	};
+
+	// Candidate boxes gathered into contiguous arrays for the batched tests
+	struct TBoxBlock
+	{
+		vector<int> ids;
+		vector<float> min_x, min_y, min_z;
+		vector<float> max_x, max_y, max_z;
+		vector<float> vx, vy, vz;
+
+		void Clear();
+		void Add(const CSimStore& sim, int i);
+		int Size() const { return (int)ids.size(); }
+	};
+
+	// Walls as arrays of their components for the batched wall tests
+	struct TWallBlock
+	{
+		vector<int> ids;
+		vector<float> nx, ny, nz;
+		vector<float> distance;
+		vector<float> to_x[4], to_y[4];
+		vector<float> min_x, max_x, min_y, max_y;
+
+		void Clear();
+		void Add(const TWall& wall, int i);
+		int Size() const { return (int)ids.size(); }
+		geomath::TWallArrays Arrays() const;
+	};
+
+	// Collision found by a batched test, recorded later on in pair order
+	struct TFound
+	{
+		TPair pair;
+		float time;
+
+		bool operator < (const TFound& rhs) const { return pair < rhs.pair; }
+	};
+
 	int num_walls;					// Number of walls
 	int num_balls;					// Number of balls
 	int num_boxes;					// Number of boxes
+	int num_meshes;					// Number of convex meshes
 
 	TWall *p_walls;					// Declare walls
-	TBall *p_balls;					// Declare balls
-	TBox *p_boxes;					// Declare boxes
+	TBall *p_balls;					// Drawing attributes of the balls, the axes turn with them
+	TConvexMesh *p_meshes;			// Declare convex meshes
+	CSimStore *p_sim;				// Positions, velocities and bounds of the balls and boxes
 
 	int num_sim_collisions;			// Number of simultaneous collisions
+	int max_collisions;				// Size of the collision information array
 	colldata *p_cdata;				// Collision information
 
 	float min_time;					// Time of earliest collision
 	float t_left;					// Each frame has time slice which decrements to 0 (starts at 1.0)
-	
-	TVector tri_coords[3];			// Keep track of the coordinates of triangle collided with
+
+	int broadphase;					// Broadphase used to cull pairs of moving objects
+	CSweepAndPrune ball_sap;		// Culls the ball pairs tested in TestBallBall
+	CSpatialHash grid;				// Culls the ball and box pairs, only the balls under BROADPHASE_TREE
+	TAABB *p_bounds;				// Swept bounds of the balls followed by the boxes
+	vector<TPair> pairs;			// Candidate pairs returned by a broadphase
+	TBallBlock ball_block;			// Ball candidates of the ball being tested
+	TBoxBlock box_block;			// Box candidates of the box being tested
+	vector<int> block_hits;			// Results of a batched test
+	vector<float> block_times;
+
+	CAABBTree box_tree;				// Fat bounds of the boxes
+	int *p_box_proxies;				// Tree leaf of each box
+	vector<int> box_hits;			// Boxes returned by a query of the tree
+
+	CStaticBVH wall_bvh;			// Walls never move so the tree is built once
+	vector<int> wall_hits;			// Walls returned by a query of the tree
+	TWallBlock all_walls;			// Every wall, for the batched wall tests
+	TWallBlock wall_block;			// Wall candidates of the ball being tested
+	vector<TFound> found;			// Collisions waiting to be recorded
+
+	TAABB *p_mesh_bounds;			// Bounds of the meshes grown by the broadphase margin
+
+	bool use_pair_cache;			// Skip the pairs the cache shows can not meet
+	CPairCache pair_cache;			// Separation of the pairs tested recently
+	double *p_travel;				// Distance moved by each ball and box so far
+	float *p_reach;					// Distance each ball and box can move in the time left
+
+	bool use_sleeping;				// Park the balls and boxes that have come to rest
+	bool *p_asleep;					// Parked objects do not move, fall or get tested together
+	int *p_still_frames;			// Frames each ball and box has stayed under SLEEP_SPEED
+	int num_asleep;					// Number of parked objects
+
+	bool event_driven;				// Schedule collisions in a queue instead of rescanning
+	bool scheduling;				// AddCollision queues every collision it is given
+	priority_queue<TEvent, vector<TEvent>, TEventLater> events;
+	vector<TEvent> new_events;		// Events predicted since the queue was last updated
+	int *p_versions;				// Bumped each time a ball or box changes velocity
+	int *p_marks;					// Objects changed (batch) or retested (-batch)
+	int batch;						// # of the current batch of simultaneous collisions
+	vector<int> changed;			// Objects changed by the current batch
+	float *p_local_times;			// Frame time each ball and box has been advanced to
+	CAABBTree event_tree;			// Fat bounds of the balls and boxes, for the retests
+	int *p_event_proxies;			// Tree leaf of each ball and box
+	vector<int> event_hits;			// Objects returned by a query of the tree
+	vector<int> retest_hits;		// Objects an object changed is tested against again
+
+	int max_iterations;				// Iteration budget of a frame
+	int budget_us;					// Time budget of the current frame, 0 for none
+	chrono::steady_clock::time_point frame_start;
+	TFrameStats stats;				// Work done in the current frame
+	int num_over_budget;			// Frames that ran out of budget so far
+	map<unsigned long long, TVector> contacts;	// Normal of each resting contact of the frame
+
+	CPerfCounters *p_perf;			// Read around each phase and geomath call, NULL for none
+	TPerfCount perf_phases[NUM_PHASES];			// Counts of each phase so far
+	TPerfCount perf_geomath[NUM_GEOMATH_KINDS];	// Counts of each kind of geomath call so far
 
 	// METHODS
 public:
 
-	CCollisions(CWorld& world);
-	void Test(float dt);			// Test collisions between all objects
+	CCollisions(CScene& world);
+	void Test(float dt, int budget_us = 0);	// Test collisions between all objects
 	~CCollisions();
 
+	void SetBroadphase(int mode);			// Choose one of the BROADPHASE_ modes
+	void SetGridCellSize(float size);		// Cell size of the hash grid broadphase
+	void SetEventDriven(bool enable);		// Use the event queue instead of rescanning
+	void SetPairCache(bool enable);			// Skip pairs that stay apart (needs a broadphase)
+	void SetSleeping(bool enable);			// Park the objects that have come to rest
+	void SetBudget(int iterations);			// Limit the iterations of a frame
+	void SetPerfCounters(CPerfCounters *p_perf);	// Count the phases and kernels, NULL to stop
+
+	const TFrameStats& GetFrameStats() const { return stats; }
+	int GetNumOverBudget() const { return num_over_budget; }
+	const TPerfCount& GetPhaseCount(int phase) const { return perf_phases[phase]; }
+	const TPerfCount& GetGeomathCount(int kind) const { return perf_geomath[kind]; }
+
+	// Sleeping objects are left out of the gravity applied by the game
+	bool IsBallAsleep(int i) const { return p_asleep[i]; }
+	bool IsBoxAsleep(int i) const { return p_asleep[num_balls + i]; }
+
 private:
 
+	void TestScan(float dt);		// Rescan every pair after each collision
+	bool IsOverBudget();			// Check the budget before the next iteration
+	void SkipRest(float dt);		// Approximate the rest of the frame
+	void ResolveOverlaps();			// Push apart the objects left overlapping
+	void Separate(int obj1, int obj2, const TVector& normal, float depth);
+	void Nudge(int obj, const TVector& disp, const TVector& dvel);
+
+	void UpdateBroadphase(float dt);	// Update the broadphase with the swept bounds
+	void UpdateReach(int obj, float dt);	// Distance an object can move in the time left
+
+	// Pair cache, obj1 and obj2 number the balls and boxes as in the swept bounds
+	// array or are -1 for a wall or mesh
+	bool IsCacheActive() const { return use_pair_cache && broadphase != BROADPHASE_NONE; }
+	bool IsPairApart(int type, int id1, int id2, int obj1, int obj2);
+	void RecordPair(int type, int id1, int id2, int obj1, int obj2, float gap);
+	// Sleeping, obj1 and obj2 are numbered as for the pair cache
+	void WakeChangedObjects();		// Wake the objects the game has moved or pushed
+	void UpdateSleep();				// Park the objects that have stayed still
+	void WakeObject(int obj, bool reset);
+	bool IsMoving(int obj) const;	// Faster than SLEEP_SPEED
+	bool IsPairAsleep(int obj1, int obj2, bool wake);
+
+	colldata* AddCollision(float time, int coll_id, int object1, int object2);
+	void AdvanceObjects(float time, float dt);		// Move every object forward in time
+	void ApplyResponses();							// Respond to the collisions found
+
+	void TestEvents(float dt);						// Event driven version of Test
+	void ScheduleEvents();							// Move new events to the queue
+	bool IsStale(const TEvent& e) const;			// Objects changed since the prediction
+	void GetObjects(const colldata& data, int& obj1, int& obj2) const;
+	void RetestObjects(float dt);					// Predict for objects just changed
+	void RetestObject(int obj, float dt);
+	void GatherRetestObjects(int obj);				// Objects obj may now reach
+	void MoveEventProxy(int obj, float dt);			// Update the event tree with the swept bounds
+	void SyncObject(int obj, float dt);				// Advance an object to the current time
+
 	void TestBallBall(float dt);	// Test for collisions between balls
 	void TestBallWall(float dt);	// Test for collisions between balls and walls
 	void TestBoxWall(float dt);		// Test for collisions between boxes and walls
 	void TestBoxBox(float dt);		// Test for collisions between boxes
 	void TestBoxBall(float dt);		// Test for collisions between boxes and balls
+	void TestBallMesh(float dt);	// Test for collisions between balls and meshes
+
+	void ReserveBlockResults(int num);				// Room for the hits of a batched test
+	void TestBallBallPair(int t, int i, float dt);	// Test a pair of balls
+	void TestBallBallBlock(	int t, const float *x, const float *y, const float *z,
+							const float *radii, const float *vx, const float *vy,
+							const float *vz, int num, const int *ids, int first, float dt);
+	void TestBoxBoxPair(int t, int i, float dt);	// Test a pair of boxes
+	void TestBoxBoxBlock(	int t, const float *min_x, const float *min_y, const float *min_z,
+							const float *max_x, const float *max_y, const float *max_z,
+							const float *vx, const float *vy, const float *vz, int num,
+							const int *ids, int first, float dt);
+	void TestBoxBallPair(int t, int i, float dt);	// Test box t against ball i
+	void GatherBallWalls(int i, float dt);			// Walls ball i may reach into wall_block
+	void TestBallWallBlock(int i, const TWallBlock& block, float t_max, float dt);
+	void TestBoxWallPair(int t, int i, float dt);	// Test box t against wall i
+	void TestBallMeshPair(int i, int m, float dt);	// Test ball i against mesh m
 
+	float Restitution(int i, const TVector& vel, const TVector& normal);	// Bounce off a static surface
+	void AddContact(int i, const TVector& normal);	// Keep collision i as a resting contact
+	bool IsRestingContact(int coll_id, int object1, int object2) const;
+	TVector GetObjectVel(int obj) const;			// Velocity of a ball or box
 	void BallBallResponse(int i);	// Collision response between balls
 	void BallWallResponse(int i);	// Collision response between balls and walls
 	void BoxWallResponse(int i);	// Collision response between boxes and walls
 	void BoxBoxResponse(int i);		// Collision response between boxes
 	void BallBoxResponse(int i);	// Collision response between balls and boxes
+	void BallMeshResponse(int i);	// Collision response between balls and meshes
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,159 @@
+/*-----------------------------------------------------------------------------------
+File:			convexMesh.cpp
+Authors:		Steve Costa
+Description:	Define methods for the static convex mesh datatype.
+-----------------------------------------------------------------------------------*/
+
+#include "convexMesh.h"
+
+#include <map>
+
+/*-----------------------------------------------------------------------------------
+Append a face to the mesh.  Build must be called once all faces have been added.
+-----------------------------------------------------------------------------------*/
+
+void TConvexMesh::AddFace(const int *indices, int count)
+{
+	TMeshFace face;
+	face.first = (int)face_indices.size();
+	face.count = count;
+
+	for (int k = 0; k < count; k++)
+		face_indices.push_back(indices[k]);
+
+	faces.push_back(face);
+}
+
+/*-----------------------------------------------------------------------------------
+Work out the plane and side normals of every face, the unique edges, the
+components of the vertices and edge end points for the batched tests and the
+bounds of the mesh.
+
+The normal of a face is found with Newell's method, the sum of the cross
+products of its sides, which does not depend on any three of its vertices being
+well spread.  Each side of a face is an edge going one way, the face across the
+edge lists it going the other way.  A mesh is closed when every edge is found
+exactly twice, once in each direction, and convex when no vertex lies in front
+of any face.
+-----------------------------------------------------------------------------------*/
+
+bool TConvexMesh::Build()
+{
+	if (vertices.empty() || faces.size() < 4)
+		return false;
+
+	side_normals.resize(face_indices.size());
+	edges.clear();
+
+	// Index of the edge joining a pair of vertices, lowest index first
+	map<pair<int, int>, int> edge_ids;
+
+	for (unsigned int f = 0; f < faces.size(); f++)
+	{
+		TMeshFace& face = faces[f];
+
+		if (face.count < 3)
+			return false;
+
+		for (int k = 0; k < face.count; k++)
+		{
+			int i = face_indices[face.first + k];
+			if (i < 0 || i >= (int)vertices.size())
+				return false;
+		}
+
+		// Newell's method
+		TVector normal(0.0f, 0.0f, 0.0f);
+		for (int k = 0; k < face.count; k++)
+		{
+			const TVector& p = GetFaceVertex(face, k);
+			const TVector& q = GetFaceVertex(face, (k + 1) % face.count);
+			normal += CrossProduct(p, q);
+		}
+
+		if (Magnitude(normal) == 0.0f)
+			return false;
+
+		face.normal = Normalized(normal);
+		face.distance = face.normal * GetFaceVertex(face, 0);
+
+		for (int k = 0; k < face.count; k++)
+		{
+			int a = face_indices[face.first + k];
+			int b = face_indices[face.first + (k + 1) % face.count];
+
+			TVector side = vertices[b] - vertices[a];
+			if (Magnitude(side) == 0.0f)
+				return false;
+
+			side_normals[face.first + k] = Normalized(CrossProduct(face.normal, side));
+
+			// Each edge is added by the first face found on it
+			pair<int, int> key(a < b ? a : b, a < b ? b : a);
+			map<pair<int, int>, int>::iterator it = edge_ids.find(key);
+
+			if (it == edge_ids.end())
+			{
+				TMeshEdge edge;
+				edge.v1 = a;
+				edge.v2 = b;
+				edge.face1 = f;
+				edge.face2 = -1;
+
+				edge_ids[key] = (int)edges.size();
+				edges.push_back(edge);
+			}
+			else
+			{
+				// The second face must go the other way along the edge
+				TMeshEdge& edge = edges[it->second];
+				if (edge.face2 != -1 || edge.v1 != b)
+					return false;
+
+				edge.face2 = f;
+			}
+		}
+	}
+
+	// Closed
+	for (unsigned int e = 0; e < edges.size(); e++)
+	{
+		if (edges[e].face2 == -1)
+			return false;
+	}
+
+	// Convex
+	for (unsigned int f = 0; f < faces.size(); f++)
+	{
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			if (vertices[i] * faces[f].normal - faces[f].distance > MESH_TOLERANCE)
+				return false;
+		}
+	}
+
+	vertex_x.clear();	vertex_y.clear();	vertex_z.clear();
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		vertex_x.push_back(vertices[i].x);
+		vertex_y.push_back(vertices[i].y);
+		vertex_z.push_back(vertices[i].z);
+	}
+
+	edge_x1.clear();	edge_y1.clear();	edge_z1.clear();
+	edge_x2.clear();	edge_y2.clear();	edge_z2.clear();
+	for (unsigned int e = 0; e < edges.size(); e++)
+	{
+		const TVector& p1 = vertices[edges[e].v1];
+		const TVector& p2 = vertices[edges[e].v2];
+
+		edge_x1.push_back(p1.x);	edge_y1.push_back(p1.y);	edge_z1.push_back(p1.z);
+		edge_x2.push_back(p2.x);	edge_y2.push_back(p2.y);	edge_z2.push_back(p2.z);
+	}
+
+	bounds.Empty();
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		bounds.Add(vertices[i]);
+
+	return true;
+}
@@ -0,0 +1,111 @@
+/*-----------------------------------------------------------------------------------
+File:			convexMesh.h
+Authors:		Steve Costa
+Description:	Header file defining a static convex mesh, a closed convex solid
+				made of flat polygonal faces that can be used for ramps, pillars
+				and other obstacles that would otherwise take many walls.
+-----------------------------------------------------------------------------------*/
+
+#ifndef CONVEX_MESH_H
+#define CONVEX_MESH_H
+
+#include <vector>
+using namespace std;
+
+#include "vector.h"
+using namespace vec;
+
+#include "aabb.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define MESH_TOLERANCE		0.001f		// Distance a vertex may lie outside a face
+#define MESH_BATCH			64			// Edges or vertices tested in one batch
+
+/*-----------------------------------------------------------------------------------
+Face of a mesh.  Its vertices are listed counter-clockwise seen from outside of
+the mesh in face_indices, from first to first + count.
+-----------------------------------------------------------------------------------*/
+
+struct TMeshFace
+{
+	TVector normal;				// Outward facing unit normal
+	float distance;				// Distance from the plane to the origin along the normal
+	int first;					// First vertex in face_indices
+	int count;					// # of vertices
+};
+
+/*-----------------------------------------------------------------------------------
+Edge of a mesh, which is shared by exactly two faces
+-----------------------------------------------------------------------------------*/
+
+struct TMeshEdge
+{
+	int v1, v2;					// End points
+	int face1, face2;			// Faces on either side
+};
+
+/*-----------------------------------------------------------------------------------
+Class representing a static convex mesh.  The vertices and the vertex lists of
+the faces are given when the mesh is created, Build then works out everything
+the collision tests need once: the plane of each face, the inward normals of
+the sides of each face, each edge listed once with the faces it joins, the
+components of the vertices and edges and the bounds of the mesh.
+-----------------------------------------------------------------------------------*/
+
+class TConvexMesh
+{
+	// ATTRIBUTES
+public:
+
+	vector<TVector> vertices;		// Corners of the mesh
+	vector<int> face_indices;		// Vertex indices of all the faces
+	vector<TVector> side_normals;	// Inward normal in the face plane of each side,
+									// side k of a face runs from vertex k to k + 1
+	vector<TMeshFace> faces;
+	vector<TMeshEdge> edges;		// Unique edges
+
+	// Components of the vertices and of the end points of the edges, so they can
+	// be tested in batches
+	vector<float> vertex_x, vertex_y, vertex_z;
+	vector<float> edge_x1, edge_y1, edge_z1;
+	vector<float> edge_x2, edge_y2, edge_z2;
+	TAABB bounds;					// Bounds of the vertices
+	int color;						// ID specifying global colour to choose
+	int texture;					// ID specifying global texture to choose
+
+	// METHODS
+public:
+
+	// Common constructor
+	TConvexMesh() : color(-1), texture(-1) {}
+
+	// Add a face given its vertex indices, counter-clockwise seen from outside
+	void AddFace(const int *indices, int count);
+
+	// Compute the face planes, edges and bounds.  Returns false if the mesh is
+	// not closed or not convex.
+	bool Build();
+
+	// Vertex k of a face
+	const TVector& GetFaceVertex(const TMeshFace& face, int k) const
+	{
+		return vertices[face_indices[face.first + k]];
+	}
+
+	// Check if a point on the plane of a face lies within the face
+	bool IsPointOnFace(const TMeshFace& face, const TVector& point) const
+	{
+		for (int k = 0; k < face.count; k++)
+		{
+			if ((point - GetFaceVertex(face, k)) * side_normals[face.first + k] < 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+};
+
+#endif
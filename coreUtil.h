@@ -0,0 +1,48 @@
+/*-----------------------------------------------------------------------------------
+File:			coreUtil.h
+Authors:		Steve Costa
+Description:	Define the constants and macros used by the simulation core.  Unlike
+				commonUtil.h this pulls in no platform or graphics headers, so the
+				core can be built on its own.
+-----------------------------------------------------------------------------------*/
+
+#ifndef CORE_UTIL_H
+#define CORE_UTIL_H
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+// PI
+#define PI		3.14159265f
+#define PI2		6.28318531f
+
+// What will be considered a negligible time interval
+#define ZERO	0.005f
+
+// Square macro
+#ifndef SQR
+#define SQR(a)	((a) * (a))
+#endif
+
+// Min macro
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+// Max macro
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+// Swap macro
+#ifndef SWAP
+#define SWAP(a, b, t) { t = a; a = b; b = t; }
+#endif
+
+// Absolute macro
+#ifndef ABS
+#define ABS(a) ((a) < 0 ? -(a) : (a))
+#endif
+
+#endif
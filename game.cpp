@@ -72,7 +72,9 @@ int CGame::Init()
 	glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
 
 	// Start the timing clock
-	current_time = GetTickCount();
+	QueryPerformanceFrequency(&counter_freq);
+	QueryPerformanceCounter(&current_time);
+	accumulator = 0.0f;
 
 	return 0;
 }
@@ -83,6 +85,8 @@ Get user input from the keyboard and apply changes depending on what is pressed.
 
 void CGame::GetInput()
 {
+	TRACE_SCOPE("CGame::GetInput");
+
 	input.LoadKeyboardState();							// Poll the keyboard
 
 	// Exit if the user presses escape
@@ -92,43 +96,46 @@ void CGame::GetInput()
 	
 	// Accelerate ball
 	if (input.IsKeyPressed(DIK_UP)) {
-		TVector temp_v(world.p_balls[0].vel.x, 0.0f, world.p_balls[0].vel.z);
-		TVector old_y(0.0f, world.p_balls[0].vel.y, 0.0f);
+		TVector vel = world.sim.GetBallVel(0);
+		TVector temp_v(vel.x, 0.0f, vel.z);
+		TVector old_y(0.0f, vel.y, 0.0f);
 		float speed = Magnitude(temp_v);
 		if (speed == 0.0f) {
 			speed = 0.5f;
 			TVector dir(-world.p_balls[0].axis.z, 0.0f, world.p_balls[0].axis.x);
-			world.p_balls[0].vel = speed * dir + old_y;
+			world.sim.SetBallVel(0, speed * dir + old_y);
 		}
 		else {
 			speed += 0.3f;
 			temp_v.Normalize();
-			world.p_balls[0].vel = speed * temp_v + old_y;
+			world.sim.SetBallVel(0, speed * temp_v + old_y);
 		}
 	}
 
 	// Decelerate ball
 	if (input.IsKeyPressed(DIK_DOWN)) {
-		TVector temp_v(world.p_balls[0].vel.x, 0.0f, world.p_balls[0].vel.z);
-		TVector old_y(0.0f, world.p_balls[0].vel.y, 0.0f);
+		TVector vel = world.sim.GetBallVel(0);
+		TVector temp_v(vel.x, 0.0f, vel.z);
+		TVector old_y(0.0f, vel.y, 0.0f);
 		float speed = Magnitude(temp_v);
 		if (speed == 0.0f) {
 			speed = -0.5f;
 			TVector dir(-world.p_balls[0].axis.z, 0.0f, world.p_balls[0].axis.x);
-			world.p_balls[0].vel = speed * dir + old_y;
+			world.sim.SetBallVel(0, speed * dir + old_y);
 		}
 		else {
 			speed -= 0.3f;
 			temp_v.Normalize();
-			world.p_balls[0].vel = speed * temp_v + old_y;
+			world.sim.SetBallVel(0, speed * temp_v + old_y);
 		}
 	}
 
 	// Turn ball
-	if (input.IsKeyPressed(DIK_LEFT))
-		world.p_balls[0].Turn(-0.1f);
-	else if (input.IsKeyPressed(DIK_RIGHT))
-		world.p_balls[0].Turn(0.1f);
+	if (input.IsKeyPressed(DIK_LEFT) || input.IsKeyPressed(DIK_RIGHT)) {
+		TVector vel = world.sim.GetBallVel(0);
+		world.p_balls[0].Turn(input.IsKeyPressed(DIK_LEFT) ? -0.1f : 0.1f, vel);
+		world.sim.SetBallVel(0, vel);
+	}
 
 	// Change camera view
 	if (input.IsKeyPressed(DIK_1)) cam_view = 0;
@@ -141,39 +148,80 @@ void CGame::GetInput()
 }
 
 /*-----------------------------------------------------------------------------------
-Simply applies gravity acceleration to all objects.
+Simply applies gravity acceleration to all objects that are awake.
 -----------------------------------------------------------------------------------*/
 
 void CGame::ApplyGravity()
 {
+	TRACE_SCOPE("CGame::ApplyGravity");
+
 	for (int i = 0; i < world.num_balls; i++)
 	{
-		world.p_balls[i].vel += world.p_balls[i].accel;
+		if (!p_collide->IsBallAsleep(i))
+			world.sim.AccelerateBall(i);
 	}
 	for (int i = 0; i < world.num_boxes; i++)
 	{
-		world.p_boxes[i].vel += world.p_boxes[i].accel;
+		if (!p_collide->IsBoxAsleep(i))
+			world.sim.AccelerateBox(i);
 	}
 }
 
 /*-----------------------------------------------------------------------------------
-Depending on cam_view, different cameras are used to view the scene.
+Advance the simulation by one fixed step.  The positions before the step are
+kept so the frames drawn can fall between steps.
+-----------------------------------------------------------------------------------*/
+
+void CGame::Step()
+{
+	TRACE_SCOPE("CGame::Step");
+
+	world.SavePositions();
+
+	ApplyGravity();					// Apply gravity to objects
+	p_collide->Test(SIM_STEP, TOI_BUDGET_US);	// Test for collisions within the budget
+	ReportBudget();					// Log the step if the tests ran out of budget
+}
+
+/*-----------------------------------------------------------------------------------
+Write a line to the debugger output for each frame in which the collision tests
+ran out of budget and approximated the end of the frame.
 -----------------------------------------------------------------------------------*/
 
-void CGame::CameraView()
+void CGame::ReportBudget()
 {
+	const CCollisions::TFrameStats& stats = p_collide->GetFrameStats();
+	if (!stats.over_budget)
+		return;
+
+	char msg[160];
+	sprintf_s(msg, sizeof(msg), "Frame %d over collision budget: %d iterations, %.3f of the frame exact, "
+				"%d overlaps corrected\n", stats.frame, stats.iterations, stats.t_exact,
+				stats.corrections);
+	OutputDebugString(msg);
+}
+
+/*-----------------------------------------------------------------------------------
+Depending on cam_view, different cameras are used to view the scene.  The cameras
+following the ball look at where it is drawn.
+-----------------------------------------------------------------------------------*/
+
+void CGame::CameraView(float alpha)
+{
+	TRACE_SCOPE("CGame::CameraView");
+
 	switch(cam_view)
 	{
 	case 0:		// Over the shoulder 1
 		{
-			TVector c = world.p_balls[0].center;
+			TVector c = world.GetDrawCenter(0, alpha);
 			gluLookAt(	c.x + 3.0f, c.y + 3.0f, c.z + 5.0f,
 						c.x, c.y, c.z, 0.0f, 1.0f, 0.0f);
 			break;
 		}
 	case 1:		// Over the shoulder 2
 		{
-			TVector c = world.p_balls[0].center;
+			TVector c = world.GetDrawCenter(0, alpha);
 			gluLookAt(	c.x + 5.0f, c.y + 5.0f, c.z + 10.0f,
 						c.x, c.y, c.z, 0.0f, 1.0f, 0.0f);
 			break;
@@ -198,7 +246,7 @@ void CGame::CameraView()
 		}
 	case 5:		// 2-D View 2
 		{
-			TVector c = world.p_balls[0].center;
+			TVector c = world.GetDrawCenter(0, alpha);
 			gluLookAt(	c.x, 30.0f, c.z, 
 						c.x, 2.0f, c.z, 0.0f, 0.0f, -1.0f);
 			break;
@@ -219,33 +267,53 @@ void CGame::CameraView()
 
 /*-----------------------------------------------------------------------------------
 Main Game Loop. This is where the magic happens!
+
+The simulation always advances in steps of SIM_STEP whatever time the frames
+take.  The time drawn is added to an accumulator and as many steps are run as
+fit in it, none when the frames are quicker than a step and several when a
+frame was slow, so the cost of a step does not depend on how the frames are
+drawn.  A frame that took longer than SIM_MAX_STEPS (the window being dragged
+or a breakpoint) is not caught up on, as the steps would only take longer again.
 -----------------------------------------------------------------------------------*/
 
 int CGame::Main()
 {
+	TRACE_SCOPE("CGame::Main");
+
 	// Calculate the elapsed time
-	DWORD elapsed_time = GetTickCount() - current_time;
-	current_time += elapsed_time;
-	float elapsed_secs = (float)elapsed_time * 0.001f;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	float elapsed_secs = (float)(now.QuadPart - current_time.QuadPart) / (float)counter_freq.QuadPart;
+	current_time = now;
+
+	accumulator += MIN(elapsed_secs, SIM_MAX_STEPS * SIM_STEP);
 
 	// Clear the buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	glLoadIdentity();
 
 	GetInput();						// Get user input
-	ApplyGravity();					// Apply gravity to objects
-	p_collide->Test(elapsed_secs);	// Test for collisions
 
-	CameraView();					// View the scene from current camera
+	while (accumulator >= SIM_STEP)
+	{
+		Step();						// Advance the simulation
+		accumulator -= SIM_STEP;
+	}
+
+	// Fraction of the way to the next step the frame is drawn at
+	float alpha = accumulator / SIM_STEP;
+
+	CameraView(alpha);				// View the scene from current camera
 
-	world.DrawReflectiveSurface(posl, elapsed_secs);	
-	world.DrawWorld(elapsed_secs);
+	world.DrawReflectiveSurface(posl, elapsed_secs, alpha);	
+	world.DrawWorld(elapsed_secs, alpha);
 	glFlush();
 	
 	// Ensure that we keep a constant frame rate
-	DWORD sleep_time = GetTickCount() - current_time;
-	sleep_time = (sleep_time > FRAME_INTERVAL) ? 0 : FRAME_INTERVAL - sleep_time;
-	Sleep(sleep_time);
+	QueryPerformanceCounter(&now);
+	float frame_ms = (float)(now.QuadPart - current_time.QuadPart) * 1000.0f / (float)counter_freq.QuadPart;
+	if (frame_ms < FRAME_INTERVAL)
+		Sleep((DWORD)(FRAME_INTERVAL - frame_ms));
 
 	return 0;
 }
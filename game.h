@@ -13,6 +13,13 @@ Description:	Header file defining the main game class.
 #include "world.h"
 #include "collisions.h"
 
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define SIM_STEP				(FRAME_INTERVAL * 0.001f)	// Seconds simulated by each step
+#define SIM_MAX_STEPS			5							// Steps caught up on in one frame
+
 class CGame
 {
 	// ATTRIBUTES
@@ -31,14 +38,18 @@ class CGame
 
 		int cam_view;					// Camera choice
 
-		DWORD current_time;				// Timing variable
+		LARGE_INTEGER counter_freq;		// Ticks of the performance counter per second
+		LARGE_INTEGER current_time;		// Counter at the start of the frame
+		float accumulator;				// Time drawn but not simulated yet
 		
 	// METHODS
 private:
 
     void GetInput();					// Get user input
 	void ApplyGravity();				// Apply gravity
-	void CameraView();					// View world through correct camera
+	void Step();						// Advance the simulation by SIM_STEP
+	void CameraView(float alpha);		// View world through correct camera
+	void ReportBudget();				// Log frames where the collision tests ran out of budget
 
 public:
 
@@ -7,7 +7,9 @@ Description:	Geometric test functions for determining collisions between
 
 #include "geoMath.h"
 
-#include "commonUtil.h"
+#include "coreUtil.h"
+
+#include <cfloat>
 
 /*-----------------------------------------------------------------------------------
 Dynamic test for intersection between the plane and a sphere given a plane
@@ -27,13 +29,26 @@ float geomath::IntersectBallPlane(const TVector& ball_center,
 								  const TVector& ball_vel,
 								  const TVector& plane_point,
 								  const TVector& plane_norm)
+{
+	// Distance from plane to origin
+	return IntersectBallPlane(	ball_center, ball_radius, ball_vel,
+								plane_point * plane_norm, plane_norm);
+}
+
+/*-----------------------------------------------------------------------------------
+Same test given the distance d_ of the plane from the origin, for planes whose
+distance has been computed ahead of time.
+-----------------------------------------------------------------------------------*/
+
+float geomath::IntersectBallPlane(const TVector& ball_center,
+								  float ball_radius,
+								  const TVector& ball_vel,
+								  float d_,
+								  const TVector& plane_norm)
 {
 	// Ensure that the plane normal is normalized
 	assert(fabs(plane_norm * plane_norm - 1.0) < 0.01f);
 
-	// Distance from plane to origin
-	float d_ = plane_point * plane_norm;
-
 	// Direction of motion
 	TVector d = Normalized(ball_vel);
 
@@ -54,35 +69,15 @@ float geomath::IntersectBallPlane(const TVector& ball_center,
 /*-----------------------------------------------------------------------------------
 Once a collision with a wall surface is established, there must be a check done
 to see if that collision was within the wall coordinates.
-If the dot product between the normal of a vertex and the the vector between the
-vertex and the point is < 0 for any of the vertices, the point is outside the
-square.
+The centre of the ball is taken into the local frame of the wall where the wall
+is an axis aligned rectangle, so the test is just a comparison against its
+extents.  Projecting the centre onto the plane is not needed as the local z
+coordinate is ignored.
 -----------------------------------------------------------------------------------*/
 
-bool geomath::IsBallOnWall(	const TBall& ball, const TWall& wall)
+bool geomath::IsBallOnWall(	const TVector& center, const TWall& wall)
 {
-	// Transform from local to world coordinates
-	TVector coords[4];
-	coords[0] = (wall.GetVertex(0) * wall.trans);
-	coords[1] = (wall.GetVertex(1) * wall.trans);
-	coords[2] = (wall.GetVertex(3) * wall.trans);
-	coords[3] = (wall.GetVertex(2) * wall.trans);
-
-	// Project the center of the ball onto the wall plane
-	TVector c = ball.center;
-	TVector point = c + (-1 * wall.normal * (c - coords[0])) * wall.normal;
-
-	int i = 3;
-
-	for (int j = 0; j < 4; i = j, j++)
-	{
-		TVector E = coords[j] - coords[i];
-		TVector E_normal = CrossProduct(wall.normal, E);
-		TVector D = point - coords[i];
-		if (D * E_normal < 0.0f)
-			return false;
-	}
-	return true;
+	return wall.IsPointOnWall(center);
 }
 
 /*-----------------------------------------------------------------------------------
@@ -90,50 +85,9 @@ Project the min and max coordinates onto the plane of the wall and test to see
 if either of those projected coordinates are within the confines of the wall.
 -----------------------------------------------------------------------------------*/
 
-bool geomath::IsBoxOnWall(const TBox& box, const TWall& wall)
+bool geomath::IsBoxOnWall(const TAABB& box, const TWall& wall)
 {
-	bool p1_hitwall = true, p2_hitwall = true;
-
-	// Transform from local to world coordinates
-	TVector coords[4];
-	coords[0] = (wall.GetVertex(0) * wall.trans);
-	coords[1] = (wall.GetVertex(1) * wall.trans);
-	coords[2] = (wall.GetVertex(3) * wall.trans);
-	coords[3] = (wall.GetVertex(2) * wall.trans);
-
-	// Project min vertex onto the wall
-	TVector c = box.minv;
-	TVector point = c + (-1 * wall.normal * (c - coords[0])) * wall.normal;
-
-	// Test if it is within wall limits
-	int i = 3;
-
-	for (int j = 0; j < 4; i = j, j++)
-	{
-		TVector E = coords[j] - coords[i];
-		TVector E_normal = CrossProduct(wall.normal, E);
-		TVector D = point - coords[i];
-		if (D * E_normal < 0.0f)
-			p1_hitwall = false;
-	}
-
-	// Project max vertex onto the wall
-	c = box.maxv;
-	point = c + (-1 * wall.normal * (c - coords[0])) * wall.normal;
-
-	// Test if it is within wall limits
-	i = 3;
-
-	for (int j = 0; j < 4; i = j, j++)
-	{
-		TVector E = coords[j] - coords[i];
-		TVector E_normal = CrossProduct(wall.normal, E);
-		TVector D = point - coords[i];
-		if (D * E_normal < 0.0f)
-			p2_hitwall = false;
-	}
-
-	return (p1_hitwall || p2_hitwall);
+	return (wall.IsPointOnWall(box.minv) || wall.IsPointOnWall(box.maxv));
 }
 
 /*-----------------------------------------------------------------------------------
@@ -188,6 +142,19 @@ A negative number is returned if there is no collision.
 float geomath::IntersectBoxPlane(const TVector& box_min, const TVector& box_max, 
 								 const TVector& box_vel, const TVector& wall_point,
 								 const TVector& wall_normal)
+{
+	// Compute distance from plane to origin
+	return IntersectBoxPlane(	box_min, box_max, box_vel,
+								wall_normal * wall_point, wall_normal);
+}
+
+/*-----------------------------------------------------------------------------------
+Same test given the distance of the plane from the origin.
+-----------------------------------------------------------------------------------*/
+
+float geomath::IntersectBoxPlane(const TVector& box_min, const TVector& box_max, 
+								 const TVector& box_vel, float plane_distance,
+								 const TVector& wall_normal)
 {
 	// Ensure that the plane normal is normalized
 	assert(fabs(wall_normal * wall_normal - 1.0) < 0.01f);
@@ -195,9 +162,6 @@ float geomath::IntersectBoxPlane(const TVector& box_min, const TVector& box_max,
 	// Compute the normalized vector of the box velocity
 	TVector dn = Normalized(box_vel);
 
-	// Compute distance from plane to origin
-	float plane_distance = wall_normal * wall_point;
-
 	// Compute glancing angle, if 0 or positive then
 	// it is travelling parallel to plane or away from it
 	float theta = wall_normal * dn;
@@ -357,6 +321,510 @@ float geomath::IntersectBoxBox(	const TVector& box_min1, const TVector& box_max1
 		return -1.0f;
 }
 
+/*-----------------------------------------------------------------------------------
+Time at which a point moving by velocity reaches the sphere of radius r around
+vertex, or -1 if it does not within t_left.  The point starts outside the sphere.
+-----------------------------------------------------------------------------------*/
+
+float geomath::EnterSphere(	const TVector& point, const TVector& velocity,
+							const TVector& vertex, float r, float t_left)
+{
+	TVector D = point - vertex;
+	float a = velocity * velocity;
+	float b = velocity * D;
+	float c = D * D - r * r;
+
+	// Moving away or missing the sphere
+	if (b >= 0.0f) return -1.0f;
+
+	float disc = b * b - a * c;
+	if (disc < 0.0f) return -1.0f;
+
+	float t = (-b - sqrt(disc)) / a;
+	if (t < 0.0f || t > t_left) return -1.0f;
+
+	return t;
+}
+
+/*-----------------------------------------------------------------------------------
+Time at which a point moving by v reaches the capsule of radius r around the box
+edge running along axis k from lo to hi, whose other two coordinates are given
+in edge.  The cylinder only needs a 2D test across the edge since the edge is
+axis aligned.  Returns -1 if the capsule is not reached within t_left.
+-----------------------------------------------------------------------------------*/
+
+static float EnterEdgeCapsule(	const float *p, const float *v, int k, const float *edge,
+								float lo, float hi, float r, float t_left)
+{
+	int i = (k + 1) % 3;
+	int j = (k + 2) % 3;
+
+	float t = -1.0f;
+
+	// Side of the capsule
+	float dx = p[i] - edge[i];
+	float dy = p[j] - edge[j];
+	float a = v[i] * v[i] + v[j] * v[j];
+	float b = v[i] * dx + v[j] * dy;
+	float c = dx * dx + dy * dy - r * r;
+
+	if (a > 0.0f && b < 0.0f && c > 0.0f)
+	{
+		float disc = b * b - a * c;
+		if (disc >= 0.0f)
+		{
+			float t_side = (-b - sqrt(disc)) / a;
+			float along = p[k] + v[k] * t_side;
+
+			if (t_side <= t_left && along >= lo && along <= hi)
+				t = t_side;
+		}
+	}
+
+	// Spheres at the ends of the edge
+	TVector point(p[0], p[1], p[2]);
+	TVector velocity(v[0], v[1], v[2]);
+
+	for (int end = 0; end < 2; end++)
+	{
+		float vertex[3] = { edge[0], edge[1], edge[2] };
+		vertex[k] = end ? hi : lo;
+
+		float t_end = geomath::EnterSphere(	point, velocity,
+											TVector(vertex[0], vertex[1], vertex[2]),
+											r, t_left);
+		if (t_end >= 0.0f && (t < 0.0f || t_end < t))
+			t = t_end;
+	}
+
+	return t;
+}
+
+/*-----------------------------------------------------------------------------------
+Face of the box (min to max) closest to a point inside it, given by its axis and
+side (0 for the min face, 1 for the max face)
+-----------------------------------------------------------------------------------*/
+
+static void NearestBoxFace(const float *p, const float *mn, const float *mx, int& axis, int& side)
+{
+	float depth = mx[0] - mn[0];
+	axis = 0;
+	side = 0;
+
+	for (int k = 0; k < 3; k++)
+	{
+		if (p[k] - mn[k] < depth)
+		{
+			depth = p[k] - mn[k];
+			axis = k;
+			side = 0;
+		}
+
+		if (mx[k] - p[k] < depth)
+		{
+			depth = mx[k] - p[k];
+			axis = k;
+			side = 1;
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Dynamic test for intersection between a sphere and an axis aligned box.  The
+sphere touches the box when its centre reaches the box grown by the radius with
+rounded edges and corners.
+
+The path of the centre is first clipped against the box grown by the radius
+(slab test).  Where it enters tells which feature is hit: if the centre is
+outside the box along one axis only it is on a face, outside along two axes it
+can only reach the rounded edge between them, along all three axes one of the
+three edges meeting at the corner.
+
+Returns the time at which the collision occurs (between 0 and t_left) or a
+negative number if there is none.  A sphere already touching the box collides at
+time 0 unless it is moving away.  The feature hit is returned as for
+IntersectBallTriangle: a face as three of its corners with edge_collision false,
+an edge by its end points, and a corner with both end points equal to it.
+-----------------------------------------------------------------------------------*/
+
+float geomath::IntersectBallBox(const TVector& center, float radius, const TVector& ball_vel,
+								const TAABB& box, const TVector& box_vel, float t_left,
+								bool& edge_collision, TVector* face,
+								TVector& edge_p1, TVector& edge_p2)
+{
+	// Assume that the box is stationary and the ball is moving
+	TVector velocity = ball_vel - box_vel;
+
+	float c[3] = { center.x, center.y, center.z };
+	float v[3] = { velocity.x, velocity.y, velocity.z };
+	float mn[3] = { box.minv.x, box.minv.y, box.minv.z };
+	float mx[3] = { box.maxv.x, box.maxv.y, box.maxv.z };
+
+	float t;
+	float p[3];								// Centre at the time of collision
+
+	// Closest point on the box to the centre
+	TVector closest(c[0] < mn[0] ? mn[0] : (c[0] > mx[0] ? mx[0] : c[0]),
+					c[1] < mn[1] ? mn[1] : (c[1] > mx[1] ? mx[1] : c[1]),
+					c[2] < mn[2] ? mn[2] : (c[2] > mx[2] ? mx[2] : c[2]));
+	TVector n = center - closest;
+
+	if (n * n < radius * radius)
+	{
+		// Already touching, a collision only if not moving away.  When the
+		// centre is inside the box use the face it is closest to.
+		if (n * n == 0.0f)
+		{
+			int axis, side;
+			NearestBoxFace(c, mn, mx, axis, side);
+
+			float normal[3] = { 0.0f, 0.0f, 0.0f };
+			normal[axis] = side ? 1.0f : -1.0f;
+			n = TVector(normal[0], normal[1], normal[2]);
+		}
+
+		if (velocity * n >= 0.0f) return -1.0f;
+
+		t = 0.0f;
+	}
+	else
+	{
+		// Clip the path against the slabs of the grown box
+		float t_enter = 0.0f;
+		float t_exit = t_left;
+
+		for (int k = 0; k < 3; k++)
+		{
+			float lo = mn[k] - radius;
+			float hi = mx[k] + radius;
+
+			if (v[k] == 0.0f)
+			{
+				if (c[k] < lo || c[k] > hi) return -1.0f;
+				continue;
+			}
+
+			float flipped = 1.0f / v[k];
+			float k_enter = (lo - c[k]) * flipped;
+			float k_exit = (hi - c[k]) * flipped;
+
+			float temp;
+			if (k_enter > k_exit) SWAP(k_enter, k_exit, temp);
+
+			if (k_enter > t_enter) t_enter = k_enter;
+			if (k_exit < t_exit) t_exit = k_exit;
+
+			if (t_enter > t_exit) return -1.0f;
+		}
+
+		// Axes along which the entry point is outside of the box
+		int outside = 0, num_outside = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			float x = c[k] + v[k] * t_enter;
+			if (x < mn[k] || x > mx[k])
+			{
+				outside |= 1 << k;
+				num_outside++;
+			}
+		}
+
+		if (num_outside <= 1)
+		{
+			// Starting on the face within rounding, a resting contact unless the
+			// ball is moving into the box
+			if (t_enter == 0.0f && num_outside == 1)
+			{
+				int k = (outside & 1) ? 0 : ((outside & 2) ? 1 : 2);
+				if (c[k] < mn[k] ? v[k] <= 0.0f : v[k] >= 0.0f) return -1.0f;
+			}
+
+			t = t_enter;
+		}
+		else
+		{
+			// Rounded edge or corner, the nearest corner gives the edge lines
+			float corner[3];
+			for (int k = 0; k < 3; k++)
+				corner[k] = (c[k] + v[k] * t_enter < mn[k]) ? mn[k] : mx[k];
+
+			t = -1.0f;
+			for (int k = 0; k < 3; k++)
+			{
+				if (num_outside == 2 && (outside & (1 << k)))
+					continue;			// Not the edge of this region
+
+				float t_edge = EnterEdgeCapsule(c, v, k, corner, mn[k], mx[k], radius, t_left);
+				if (t_edge >= 0.0f && (t < 0.0f || t_edge < t))
+					t = t_edge;
+			}
+
+			if (t < 0.0f) return -1.0f;
+		}
+	}
+
+	for (int k = 0; k < 3; k++)
+		p[k] = c[k] + v[k] * t;
+
+	// Find the feature the centre is closest to at the time of collision
+	int lo_bits = 0, hi_bits = 0, num_outside = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		if (p[k] < mn[k]) { lo_bits |= 1 << k; num_outside++; }
+		else if (p[k] > mx[k]) { hi_bits |= 1 << k; num_outside++; }
+	}
+
+	if (num_outside <= 1)
+	{
+		// Face, when inside the box the one closest to the centre
+		int axis = 0, side = 0;
+		if (num_outside == 1)
+		{
+			int bits = lo_bits | hi_bits;
+			axis = (bits & 1) ? 0 : ((bits & 2) ? 1 : 2);
+			side = hi_bits ? 1 : 0;
+		}
+		else
+			NearestBoxFace(p, mn, mx, axis, side);
+
+		// Three corners of the face
+		int num_corners = 0;
+		for (int i = 0; i < 8 && num_corners < 3; i++)
+		{
+			if (((i >> axis) & 1) == side)
+				face[num_corners++] = box.GetVertex(i);
+		}
+
+		edge_collision = false;
+	}
+	else
+	{
+		// Corner closest to the centre, an edge runs from it along the axis
+		// the centre is within
+		int corner = hi_bits | (7 & ~(lo_bits | hi_bits));
+		edge_p1 = box.GetVertex(corner);
+		edge_p2 = edge_p1;
+
+		if (num_outside == 2)
+		{
+			int along = 7 & ~(lo_bits | hi_bits);
+			edge_p1 = box.GetVertex(corner & ~along);
+			edge_p2 = box.GetVertex(corner | along);
+		}
+
+		edge_collision = true;
+	}
+
+	return t;
+}
+
+/*-----------------------------------------------------------------------------------
+Time at which a point moving by velocity reaches the cylinder of radius r around
+the edge (point1, point2) between its end points, or -1 if it does not within
+t_left.  The parts of the point and velocity along the edge are removed so the
+cylinder becomes a circle.  The point starts outside the cylinder.
+-----------------------------------------------------------------------------------*/
+
+float geomath::EnterEdgeCylinder(	const TVector& point, const TVector& velocity,
+									const TVector& point1, const TVector& point2,
+									float r, float t_left)
+{
+	TVector L = point2 - point1;
+	float inv_len2 = 1.0f / (L * L);
+
+	TVector D = point - point1;
+	TVector D_perp = D - ((D * L) * inv_len2) * L;
+	TVector v_perp = velocity - ((velocity * L) * inv_len2) * L;
+
+	float a = v_perp * v_perp;
+	float b = v_perp * D_perp;
+	float c = D_perp * D_perp - r * r;
+
+	// Moving away, parallel to the edge or already within the cylinder
+	if (a == 0.0f || b >= 0.0f || c <= 0.0f) return -1.0f;
+
+	float disc = b * b - a * c;
+	if (disc < 0.0f) return -1.0f;
+
+	float t = (-b - sqrt(disc)) / a;
+	if (t > t_left) return -1.0f;
+
+	// Only the part of the cylinder between the end points
+	float along = ((D + velocity * t) * L) * inv_len2;
+	if (along < 0.0f || along > 1.0f) return -1.0f;
+
+	return t;
+}
+
+/*-----------------------------------------------------------------------------------
+Dynamic test for intersection between a sphere and a static convex mesh.  The
+sphere touches the mesh when its centre reaches the mesh grown by the radius,
+which is made of the faces pushed out along their normals, a cylinder around
+each edge and a sphere around each vertex.  The earliest time the centre reaches
+any of these is the time of collision, so each face, edge and vertex is visited
+exactly once instead of going over the edges of every face as
+IntersectBallTriangle does.
+
+If the sphere already touches the mesh it collides at time 0 unless it is
+moving away from the closest point.  The closest point is found over the
+interior of the faces and the edges, which also cover the vertices.
+
+Returns the time at which the collision occurs (between 0 and t_left) or a
+negative number if there is none, and the unit normal of the grown mesh at the
+point the centre hits it, pointing away from the mesh.
+-----------------------------------------------------------------------------------*/
+
+float geomath::IntersectBallMesh(	const TVector& center, float radius,
+									const TVector& velocity, const TConvexMesh& mesh,
+									float t_left, TVector& normal)
+{
+	// Cull with the bounds of the mesh grown by the radius and the swept sphere
+	TVector start = center;
+	TVector end = center + velocity * t_left;
+	TVector lo = mesh.bounds.minv, hi = mesh.bounds.maxv;
+
+	for (int k = 0; k < 3; k++)
+	{
+		if (MIN(start[k], end[k]) > hi[k] + radius) return -1.0f;
+		if (MAX(start[k], end[k]) < lo[k] - radius) return -1.0f;
+	}
+
+	// Distance of the centre in front of the faces, the centre is inside the
+	// mesh if it is behind all of them
+	float max_dist = -FLT_MAX;
+	int max_face = 0;
+	float closest_dist2 = FLT_MAX;
+	TVector closest(0.0f, 0.0f, 0.0f);
+
+	for (unsigned int f = 0; f < mesh.faces.size(); f++)
+	{
+		const TMeshFace& face = mesh.faces[f];
+		float dist = center * face.normal - face.distance;
+
+		if (dist > max_dist)
+		{
+			max_dist = dist;
+			max_face = f;
+		}
+
+		if (dist > 0.0f && dist * dist < closest_dist2)
+		{
+			TVector p = center - dist * face.normal;
+			if (mesh.IsPointOnFace(face, p))
+			{
+				closest_dist2 = dist * dist;
+				closest = p;
+			}
+		}
+	}
+
+	if (max_dist <= 0.0f)
+	{
+		// Inside the mesh, leave through the nearest face
+		normal = mesh.faces[max_face].normal;
+		return (velocity * normal < 0.0f) ? 0.0f : -1.0f;
+	}
+
+	if (max_dist < radius)
+	{
+		for (unsigned int e = 0; e < mesh.edges.size(); e++)
+		{
+			const TVector& p1 = mesh.vertices[mesh.edges[e].v1];
+			const TVector& p2 = mesh.vertices[mesh.edges[e].v2];
+			TVector L = p2 - p1;
+
+			float along = ((center - p1) * L) / (L * L);
+			along = MAX(0.0f, MIN(1.0f, along));
+
+			TVector p = p1 + along * L;
+			TVector D = center - p;
+			if (D * D < closest_dist2)
+			{
+				closest_dist2 = D * D;
+				closest = p;
+			}
+		}
+
+		if (closest_dist2 < radius * radius)
+		{
+			// Already touching
+			normal = Normalized(center - closest);
+			return (velocity * normal < 0.0f) ? 0.0f : -1.0f;
+		}
+	}
+
+	float t = -1.0f;
+
+	// Faces pushed out by the radius
+	for (unsigned int f = 0; f < mesh.faces.size(); f++)
+	{
+		const TMeshFace& face = mesh.faces[f];
+		float dist = center * face.normal - face.distance;
+		float approach = velocity * face.normal;
+
+		// Behind the pushed out face or not moving towards it
+		if (dist < radius || approach >= 0.0f) continue;
+
+		float t_face = (radius - dist) / approach;
+		if (t_face > t_left || (t >= 0.0f && t_face >= t)) continue;
+
+		if (mesh.IsPointOnFace(face, center + velocity * t_face - radius * face.normal))
+		{
+			t = t_face;
+			normal = face.normal;
+		}
+	}
+
+	// Cylinders around the edges, MESH_BATCH at a time
+	float times[MESH_BATCH];
+	int num_edges = (int)mesh.edges.size();
+
+	for (int first = 0; first < num_edges; first += MESH_BATCH)
+	{
+		int num = MIN(MESH_BATCH, num_edges - first);
+		EnterEdgeCylinderBatch(	center, velocity, &mesh.edge_x1[first], &mesh.edge_y1[first],
+								&mesh.edge_z1[first], &mesh.edge_x2[first], &mesh.edge_y2[first],
+								&mesh.edge_z2[first], radius, num, t_left, times);
+
+		for (int k = 0; k < num; k++)
+		{
+			float t_edge = times[k];
+			if (t_edge >= 0.0f && (t < 0.0f || t_edge < t))
+			{
+				const TVector& p1 = mesh.vertices[mesh.edges[first + k].v1];
+				const TVector& p2 = mesh.vertices[mesh.edges[first + k].v2];
+				TVector p = center + velocity * t_edge;
+				TVector L = p2 - p1;
+
+				t = t_edge;
+				normal = Normalized(p - (p1 + (((p - p1) * L) / (L * L)) * L));
+			}
+		}
+	}
+
+	// Spheres around the vertices
+	int num_vertices = (int)mesh.vertices.size();
+
+	for (int first = 0; first < num_vertices; first += MESH_BATCH)
+	{
+		int num = MIN(MESH_BATCH, num_vertices - first);
+		EnterSphereBatch(	center, velocity, &mesh.vertex_x[first], &mesh.vertex_y[first],
+							&mesh.vertex_z[first], radius, num, t_left, times);
+
+		for (int k = 0; k < num; k++)
+		{
+			float t_vertex = times[k];
+			if (t_vertex >= 0.0f && (t < 0.0f || t_vertex < t))
+			{
+				t = t_vertex;
+				normal = Normalized(center + velocity * t_vertex - mesh.vertices[first + k]);
+			}
+		}
+	}
+
+	return t;
+}
+
 /*-----------------------------------------------------------------------------------
 The following methods are adapted from code presented by Olivier Renault in
 http://www.gamedev.net on how to determing the time at which a collision
@@ -581,4 +1049,231 @@ float geomath::IntersectBallVertex(const TVector& center, const TVector& velocit
 	if (t < 0.0f) return -1.0f;
 
 	return t;
-}
\ No newline at end of file
+}
+
+/*-----------------------------------------------------------------------------------
+Static overlap tests, used when there is no time left in a frame to find when
+objects meet.  Each returns true if the objects overlap, along with the unit
+normal pointing from the second object towards the first and the depth the
+first must be moved along it to no longer overlap.
+-----------------------------------------------------------------------------------*/
+
+bool geomath::OverlapBallBall(	const TVector& center1, float radius1,
+								const TVector& center2, float radius2,
+								TVector& normal, float& depth)
+{
+	TVector d = center1 - center2;
+	float r = radius1 + radius2;
+	float dist2 = d * d;
+
+	if (dist2 >= r * r)
+		return false;
+
+	// Balls at the same place are pushed apart vertically
+	float dist = sqrt(dist2);
+	normal = (dist > 0.0f) ? d * (1.0f / dist) : TVector(0.0f, 1.0f, 0.0f);
+	depth = r - dist;
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Sphere against box, a centre inside the box is pushed out of the nearest face
+-----------------------------------------------------------------------------------*/
+
+bool geomath::OverlapBallBox(	const TVector& center, float radius, const TAABB& box,
+								TVector& normal, float& depth)
+{
+	float c[3] = { center.x, center.y, center.z };
+	float mn[3] = { box.minv.x, box.minv.y, box.minv.z };
+	float mx[3] = { box.maxv.x, box.maxv.y, box.maxv.z };
+
+	TVector closest(c[0] < mn[0] ? mn[0] : (c[0] > mx[0] ? mx[0] : c[0]),
+					c[1] < mn[1] ? mn[1] : (c[1] > mx[1] ? mx[1] : c[1]),
+					c[2] < mn[2] ? mn[2] : (c[2] > mx[2] ? mx[2] : c[2]));
+	TVector d = center - closest;
+	float dist2 = d * d;
+
+	if (dist2 >= radius * radius)
+		return false;
+
+	if (dist2 > 0.0f)
+	{
+		float dist = sqrt(dist2);
+		normal = d * (1.0f / dist);
+		depth = radius - dist;
+		return true;
+	}
+
+	int axis, side;
+	NearestBoxFace(c, mn, mx, axis, side);
+
+	float n[3] = { 0.0f, 0.0f, 0.0f };
+	n[axis] = side ? 1.0f : -1.0f;
+	normal = TVector(n[0], n[1], n[2]);
+	depth = radius + (side ? mx[axis] - c[axis] : c[axis] - mn[axis]);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Box against box, separated along the axis on which they overlap the least
+-----------------------------------------------------------------------------------*/
+
+bool geomath::OverlapBoxBox(const TAABB& box1, const TAABB& box2, TVector& normal, float& depth)
+{
+	float mn1[3] = { box1.minv.x, box1.minv.y, box1.minv.z };
+	float mx1[3] = { box1.maxv.x, box1.maxv.y, box1.maxv.z };
+	float mn2[3] = { box2.minv.x, box2.minv.y, box2.minv.z };
+	float mx2[3] = { box2.maxv.x, box2.maxv.y, box2.maxv.z };
+
+	int axis = 0;
+	float sign = 1.0f;
+	depth = -1.0f;
+
+	for (int k = 0; k < 3; k++)
+	{
+		float up = mx2[k] - mn1[k];			// Moving box1 up along k by this separates them
+		float down = mx1[k] - mn2[k];		// and so does moving it down by this
+
+		if (up <= 0.0f || down <= 0.0f)
+			return false;
+
+		float d = MIN(up, down);
+		if (depth < 0.0f || d < depth)
+		{
+			depth = d;
+			axis = k;
+			sign = (up < down) ? 1.0f : -1.0f;
+		}
+	}
+
+	float n[3] = { 0.0f, 0.0f, 0.0f };
+	n[axis] = sign;
+	normal = TVector(n[0], n[1], n[2]);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Sphere against wall, pushed out on the side of the wall its centre is on
+-----------------------------------------------------------------------------------*/
+
+bool geomath::OverlapBallWall(	const TVector& center, float radius, const TWall& wall,
+								TVector& normal, float& depth)
+{
+	float dist = center * wall.normal - wall.distance;
+
+	if (ABS(dist) >= radius || !IsBallOnWall(center, wall))
+		return false;
+
+	normal = (dist >= 0.0f) ? wall.normal : -1.0f * wall.normal;
+	depth = radius - ABS(dist);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Box against wall, pushed out on the side of the wall its centre is on
+-----------------------------------------------------------------------------------*/
+
+bool geomath::OverlapBoxWall(const TAABB& box, const TWall& wall, TVector& normal, float& depth)
+{
+	TVector center = (box.minv + box.maxv) * 0.5f;
+	TVector half = (box.maxv - box.minv) * 0.5f;
+	float extent =	ABS(wall.normal.x) * half.x + ABS(wall.normal.y) * half.y +
+					ABS(wall.normal.z) * half.z;
+	float dist = center * wall.normal - wall.distance;
+
+	if (ABS(dist) >= extent || !IsBoxOnWall(box, wall))
+		return false;
+
+	normal = (dist >= 0.0f) ? wall.normal : -1.0f * wall.normal;
+	depth = extent - ABS(dist);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Sphere against a convex mesh.  A centre outside the mesh is pushed away from the
+closest point on the surface, found on the faces the centre lies in front of and
+their edges and vertices.  A centre inside is pushed out of the nearest face.
+-----------------------------------------------------------------------------------*/
+
+bool geomath::OverlapBallMesh(	const TVector& center, float radius, const TConvexMesh& mesh,
+								TVector& normal, float& depth)
+{
+	// Nearest face to a centre inside, any face more than the radius away
+	// means there is no overlap
+	int nearest = 0;
+	float max_dist = -FLT_MAX;
+
+	for (unsigned int f = 0; f < mesh.faces.size(); f++)
+	{
+		float dist = center * mesh.faces[f].normal - mesh.faces[f].distance;
+		if (dist >= radius)
+			return false;
+
+		if (dist > max_dist)
+		{
+			max_dist = dist;
+			nearest = f;
+		}
+	}
+
+	if (max_dist <= 0.0f)
+	{
+		normal = mesh.faces[nearest].normal;
+		depth = radius - max_dist;
+		return true;
+	}
+
+	float best2 = radius * radius;
+	TVector best(0.0f, 0.0f, 0.0f);
+
+	for (unsigned int f = 0; f < mesh.faces.size(); f++)
+	{
+		const TMeshFace& face = mesh.faces[f];
+		float dist = center * face.normal - face.distance;
+
+		if (dist <= 0.0f)
+			continue;
+
+		TVector on_plane = center - dist * face.normal;
+		if (mesh.IsPointOnFace(face, on_plane))
+		{
+			if (dist * dist < best2)
+			{
+				best2 = dist * dist;
+				best = on_plane;
+			}
+			continue;
+		}
+
+		// Closest point on each side of the face
+		for (int k = 0; k < face.count; k++)
+		{
+			const TVector& a = mesh.GetFaceVertex(face, k);
+			TVector side = mesh.GetFaceVertex(face, (k + 1) % face.count) - a;
+
+			float s = ((center - a) * side) / (side * side);
+			TVector p = a + MAX(0.0f, MIN(1.0f, s)) * side;
+			TVector d = center - p;
+
+			if (d * d < best2)
+			{
+				best2 = d * d;
+				best = p;
+			}
+		}
+	}
+
+	if (best2 >= radius * radius)
+		return false;
+
+	float dist = sqrt(best2);
+	normal = (dist > 0.0f) ? (center - best) * (1.0f / dist) : mesh.faces[nearest].normal;
+	depth = radius - dist;
+
+	return true;
+}
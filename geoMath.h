@@ -16,6 +16,7 @@ using namespace vec;
 #include "plane.h"
 #include "sphere.h"
 #include "aabb.h"
+#include "convexMesh.h"
 
 /*-----------------------------------------------------------------------------------
 Encapsulate within the geomath namespace in order to prevent functions
@@ -24,6 +25,17 @@ from having global scope.
 
 namespace geomath
 {
+	// Walls held as arrays of their components for the batched wall tests
+	struct TWallArrays
+	{
+		const float *nx, *ny, *nz;		// Plane normals
+		const float *distance;			// Distances of the planes from the origin
+		const float *to_x[4];			// Columns of inv_trans giving the local x
+		const float *to_y[4];			// and y coordinates of a point
+		const float *min_x, *max_x;		// Extents of the walls in local coords
+		const float *min_y, *max_y;
+	};
+
 	// Check for intersection between the plane and a sphere sphere
 	float IntersectBallPlane(const TVector& ball_center,
 							 float ball_radius,
@@ -31,6 +43,12 @@ namespace geomath
 							 const TVector& plane_point,
 							 const TVector& plane_norm);
 
+	float IntersectBallPlane(const TVector& ball_center,
+							 float ball_radius,
+							 const TVector& ball_vel,
+							 float plane_distance,
+							 const TVector& plane_norm);
+
 	// Check for intersection between two spheres
 	float IntersectBallBall( const TVector& ball_center1,
 							 float ball_radius1,
@@ -39,19 +57,74 @@ namespace geomath
 							 float ball_radius2,
 							 const TVector& ball_vel2);
 
+	// Check for intersection between one sphere and a block of spheres
+	int IntersectBallBallBatch(	const TVector& center, float radius, const TVector& disp,
+								const float *x, const float *y, const float *z,
+								const float *radii, const float *vx, const float *vy,
+								const float *vz, float dt, int num, float t_max,
+								int *hits, float *times, float& min_time);
+
+	bool EnableSimd(bool enable);	// Let the batch tests use SIMD if supported
+	bool IsSimdEnabled();
 	
 	float IntersectBoxPlane(const TVector& box_min, const TVector& box_max, 
 							const TVector& box_vel, const TVector& wall_point,
 							const TVector& wall_normal);
 
-	bool IsBallOnWall(	const TBall& ball, const TWall& wall);
+	float IntersectBoxPlane(const TVector& box_min, const TVector& box_max, 
+							const TVector& box_vel, float plane_distance,
+							const TVector& wall_normal);
+
+	bool IsBallOnWall(	const TVector& center, const TWall& wall);
+
+	// Check for intersection between a sphere and a block of walls
+	int IntersectBallWallBatch(	const TVector& center, float radius, const TVector& disp,
+								const TWallArrays& walls, int num, float t_max,
+								int *hits, float *times, float& min_time, int& min_wall);
 
-	bool IsBoxOnWall(const TBox& box, const TWall& wall);
+	bool IsBoxOnWall(const TAABB& box, const TWall& wall);
 
     float IntersectBoxBox(	const TVector& box_min1, const TVector& box_max1, 
 							const TVector& box_vel1, const TVector& box_min2,
 							const TVector& box_max2, const TVector& box_vel2);
 
+	// Check for intersection between one box and a block of boxes
+	int IntersectBoxBoxBatch(	const TVector& box_min, const TVector& box_max,
+								const TVector& disp, const float *min_x, const float *min_y,
+								const float *min_z, const float *max_x, const float *max_y,
+								const float *max_z, const float *vx, const float *vy,
+								const float *vz, float dt, int num, float t_max,
+								int *hits, float *times, float& min_time);
+
+	// Check for intersection between a sphere and a box (rounded by the radius)
+	float IntersectBallBox(	const TVector& center, float radius, const TVector& ball_vel,
+							const TAABB& box, const TVector& box_vel, float t_left,
+							bool& edge_collision, TVector* face,
+							TVector& edge_p1, TVector& edge_p2);
+
+	// Check for intersection between a sphere and a static convex mesh
+	float IntersectBallMesh(const TVector& center, float radius, const TVector& velocity,
+							const TConvexMesh& mesh, float t_left, TVector& normal);
+
+	// Time a moving point enters the sphere around a vertex or the cylinder around
+	// an edge (between its end points), for the grown faces of IntersectBallMesh
+	float EnterSphere(	const TVector& point, const TVector& velocity,
+						const TVector& vertex, float r, float t_left);
+
+	float EnterEdgeCylinder(const TVector& point, const TVector& velocity,
+							const TVector& point1, const TVector& point2,
+							float r, float t_left);
+
+	// The same for blocks of vertices or edges
+	void EnterSphereBatch(	const TVector& point, const TVector& velocity, const float *x,
+							const float *y, const float *z, float r, int num, float t_left,
+							float *times);
+
+	void EnterEdgeCylinderBatch(const TVector& point, const TVector& velocity,
+								const float *x1, const float *y1, const float *z1,
+								const float *x2, const float *y2, const float *z2,
+								float r, int num, float t_left, float *times);
+
 	float IntersectBallTriangle(const TVector& center, const TVector& ball_vel,
 								float radius, const TVector& tri_vel,
 								const TVector* vertices, float t_left, 
@@ -68,6 +141,25 @@ namespace geomath
 	float IntersectBallEdge(const TVector& center, const TVector& velocity, float radius,
 							const TVector& point1, const TVector& point2, bool test_vertices,
 							float t_left);
+
+	// Static overlap tests, the normal points from the second object to the first
+	// and the depth is how far they overlap along it
+	bool OverlapBallBall(	const TVector& center1, float radius1,
+							const TVector& center2, float radius2,
+							TVector& normal, float& depth);
+
+	bool OverlapBallBox(const TVector& center, float radius, const TAABB& box,
+						TVector& normal, float& depth);
+
+	bool OverlapBoxBox(const TAABB& box1, const TAABB& box2, TVector& normal, float& depth);
+
+	bool OverlapBallWall(	const TVector& center, float radius, const TWall& wall,
+							TVector& normal, float& depth);
+
+	bool OverlapBoxWall(const TAABB& box, const TWall& wall, TVector& normal, float& depth);
+
+	bool OverlapBallMesh(	const TVector& center, float radius, const TConvexMesh& mesh,
+							TVector& normal, float& depth);
 }
 
 #endif
\ No newline at end of file
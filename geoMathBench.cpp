@@ -0,0 +1,1155 @@
+/*-----------------------------------------------------------------------------------
+File:			geoMathBench.cpp
+Authors:		Steve Costa
+Description:	Microbenchmarks of the geomath kernels.  Each kernel is run over
+				a set of generated cases mixing hits, misses, grazing contacts
+				and edge cases (touching at the start, barely moving), and the
+				time per call is written as CSV or JSON lines so runs can be
+				compared against a baseline.
+
+Usage:			geomath_bench [options]
+
+				-kernel name	Only run the kernel with this name
+				-cases n		Cases generated for each kernel (default BENCH_CASES)
+				-ms n			Milliseconds of each timed run (default BENCH_RUN_MS)
+				-runs n			Timed runs of each kernel (default BENCH_RUNS)
+				-seed n			Seed of the generated cases
+				-json			Write JSON lines instead of CSV
+				-verify			Instead of timing the kernels, check that the batch
+								tests give the same results bit for bit with SIMD as
+								without it, over -cases blocks of each.  Fails if any
+								differ.
+-----------------------------------------------------------------------------------*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+#include "geoMath.h"
+using namespace geomath;
+
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define BENCH_CASES			4096		// Cases generated for each kernel
+#define BENCH_RUN_MS		100			// Length of each timed run
+#define BENCH_RUNS			5			// Timed runs, the median is reported
+#define BENCH_WALLS			64			// Walls shared by the wall cases
+#define BENCH_SEED			12345
+
+#define VERIFY_MAX_BLOCK	37			// Largest block of the batch tests
+#define VERIFY_PRINTED		10			// Mismatches printed for each batch test
+
+#define CASE_HIT			0			// Meets the object within the step
+#define CASE_MISS			1			// Moves away or falls short
+#define CASE_GRAZE			2			// Passes along the surface just touching it
+#define CASE_EDGE			3			// Touching at the start or barely moving
+#define NUM_CASE_KINDS		4
+
+/*-----------------------------------------------------------------------------------
+Small generator (xorshift) so the cases are the same on every platform
+-----------------------------------------------------------------------------------*/
+
+struct TRandom
+{
+	unsigned int state;
+
+	explicit TRandom(unsigned int seed) : state(seed ? seed : 1) {}
+
+	unsigned int Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// Uniform in [lo, hi)
+	float Uniform(float lo, float hi)
+	{
+		return lo + (hi - lo) * (float)(Next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	TVector Point(float extent)
+	{
+		return TVector(Uniform(-extent, extent), Uniform(-extent, extent), Uniform(-extent, extent));
+	}
+
+	TVector Unit()
+	{
+		TVector v;
+		do
+		{
+			v = Point(1.0f);
+		} while (v * v < 0.01f || v * v > 1.0f);
+
+		return Normalized(v);
+	}
+
+	// Unit vector at right angles to n
+	TVector Perpendicular(const TVector& n)
+	{
+		TVector v;
+		do
+		{
+			v = CrossProduct(n, Unit());
+		} while (v * v < 0.01f);
+
+		return Normalized(v);
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Inputs of one call.  Each kernel uses the fields it needs.
+-----------------------------------------------------------------------------------*/
+
+struct TCase
+{
+	TVector a, b;				// Ball centres, box corners, plane or edge points
+	TVector c, d;				// Second box corners, plane normal
+	TVector vel1, vel2;
+	TVector tri[3];
+	float r1, r2;
+	int wall;					// Index into the shared walls
+};
+
+struct TBenchData
+{
+	vector<TCase> cases;
+	vector<TWall> walls;
+};
+
+/*-----------------------------------------------------------------------------------
+Start and velocity of a body reaching out r from its centre approaching the
+surface point p with outward normal n, for each kind of case
+-----------------------------------------------------------------------------------*/
+
+static void Approach(	TRandom& rng, int kind, const TVector& p, const TVector& n, float r,
+						TVector& start, TVector& vel)
+{
+	TVector tangent = rng.Perpendicular(n);
+	float gap = rng.Uniform(0.1f, 2.0f);
+
+	switch (kind)
+	{
+	case CASE_HIT:
+		start = p + n * (r + gap) + tangent * (gap * rng.Uniform(-0.5f, 0.5f));
+		vel = (p + n * r - start) * rng.Uniform(1.1f, 3.0f);
+		break;
+
+	case CASE_MISS:
+		start = p + n * (r + gap);
+		if (rng.Next() & 1)
+			vel = n * rng.Uniform(0.5f, 3.0f) + tangent * rng.Uniform(-1.0f, 1.0f);
+		else
+			vel = n * (-gap * rng.Uniform(0.1f, 0.8f));
+		break;
+
+	case CASE_GRAZE:
+		start = p + n * r - tangent * gap;
+		vel = tangent * (gap * rng.Uniform(1.5f, 3.0f));
+		break;
+
+	default:
+		start = p + n * r;
+		if (rng.Next() & 1)
+			vel = n * -rng.Uniform(0.1f, 1.0f);
+		else
+			vel = rng.Unit() * 1e-6f;
+		break;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+The kernels.  Generate fills in a case of the given kind and Run makes the call,
+returning the time found (negative for none) or 0 and -1 for the yes or no
+tests.  A result from 0 to 1 counts as a hit.
+-----------------------------------------------------------------------------------*/
+
+struct KBallPlane
+{
+	static const char* Name() { return "IntersectBallPlane"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		c.d = rng.Unit();
+		c.b = rng.Point(10.0f);
+		c.r1 = rng.Uniform(0.1f, 1.0f);
+
+		TVector p = c.b + rng.Perpendicular(c.d) * rng.Uniform(0.0f, 5.0f);
+		Approach(rng, kind, p, c.d, c.r1, c.a, c.vel1);
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		return IntersectBallPlane(c.a, c.r1, c.vel1, c.b, c.d);
+	}
+};
+
+struct KBallBall
+{
+	static const char* Name() { return "IntersectBallBall"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		c.a = rng.Point(10.0f);
+		c.r1 = rng.Uniform(0.1f, 1.0f);
+		c.r2 = rng.Uniform(0.1f, 1.0f);
+		c.vel1 = rng.Point(1.0f);
+
+		// The second ball approaches the first, which is taken as still
+		TVector n = rng.Unit();
+		TVector vel;
+		Approach(rng, kind, c.a + n * c.r1, n, c.r2, c.b, vel);
+		c.vel2 = c.vel1 + vel;
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		return IntersectBallBall(c.a, c.r1, c.vel1, c.b, c.r2, c.vel2);
+	}
+};
+
+struct KBoxPlane
+{
+	static const char* Name() { return "IntersectBoxPlane"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		c.d = rng.Unit();
+		c.c = rng.Point(10.0f);
+
+		TVector half(rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f));
+		float extent = ABS(c.d.x) * half.x + ABS(c.d.y) * half.y + ABS(c.d.z) * half.z;
+
+		TVector center;
+		TVector p = c.c + rng.Perpendicular(c.d) * rng.Uniform(0.0f, 5.0f);
+		Approach(rng, kind, p, c.d, extent, center, c.vel1);
+
+		c.a = center - half;
+		c.b = center + half;
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		return IntersectBoxPlane(c.a, c.b, c.vel1, c.c, c.d);
+	}
+};
+
+struct KBoxBox
+{
+	static const char* Name() { return "IntersectBoxBox"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		TVector center1 = rng.Point(10.0f);
+		TVector half1(rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f));
+		TVector half2(rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f));
+
+		c.a = center1 - half1;
+		c.b = center1 + half1;
+		c.vel1 = rng.Point(1.0f);
+
+		// The second box approaches a face of the first
+		int axis = rng.Next() % 3;
+		float sign = (rng.Next() & 1) ? 1.0f : -1.0f;
+		TVector n(0.0f, 0.0f, 0.0f);
+		n[axis] = sign;
+
+		TVector p = center1 + n * half1[axis];
+		for (int k = 0; k < 3; k++)
+		{
+			if (k != axis)
+				p[k] += rng.Uniform(-half1[k], half1[k]);
+		}
+
+		TVector center2, vel;
+		Approach(rng, kind, p, n, half2[axis], center2, vel);
+
+		c.c = center2 - half2;
+		c.d = center2 + half2;
+		c.vel2 = c.vel1 + vel;
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		return IntersectBoxBox(c.a, c.b, c.vel1, c.c, c.d, c.vel2);
+	}
+};
+
+struct KBallTriangle
+{
+	static const char* Name() { return "IntersectBallTriangle"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		TVector origin = rng.Point(10.0f);
+		for (int k = 0; k < 3; k++)
+			c.tri[k] = origin + rng.Point(3.0f);
+
+		TVector normal = Normalized(CrossProduct(c.tri[1] - c.tri[0], c.tri[2] - c.tri[1]));
+		c.r1 = rng.Uniform(0.1f, 1.0f);
+		c.vel2 = TVector(0.0f, 0.0f, 0.0f);
+
+		// Aim inside the triangle, or at one of its edges for the grazing and
+		// edge cases so the edge tests are run
+		float u = rng.Uniform(0.0f, 1.0f), v = rng.Uniform(0.0f, 1.0f);
+		if (kind == CASE_GRAZE || kind == CASE_EDGE)
+			v = 1.0f - u;
+		else if (u + v > 1.0f)
+		{
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+
+		TVector p = c.tri[0] + (c.tri[1] - c.tri[0]) * u + (c.tri[2] - c.tri[0]) * v;
+		Approach(rng, kind, p, normal, c.r1, c.a, c.vel1);
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		bool edge_collision;
+		TVector edge_p1, edge_p2;
+		return IntersectBallTriangle(	c.a, c.vel1, c.r1, c.vel2, c.tri, 1.0f,
+										edge_collision, edge_p1, edge_p2);
+	}
+};
+
+struct KBallEdge
+{
+	static const char* Name() { return "IntersectBallEdge"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		c.b = rng.Point(10.0f);
+		c.c = c.b + rng.Point(3.0f);
+		c.r1 = rng.Uniform(0.1f, 1.0f);
+
+		// The edge cases aim past the ends so the vertices are tested
+		float l = (kind == CASE_EDGE) ? rng.Uniform(-0.2f, 1.2f) : rng.Uniform(0.0f, 1.0f);
+		TVector p = c.b + (c.c - c.b) * l;
+		Approach(rng, kind, p, rng.Perpendicular(c.c - c.b), c.r1, c.a, c.vel1);
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		return IntersectBallEdge(c.a, c.vel1, c.r1, c.b, c.c, true, 1.0f);
+	}
+};
+
+struct KBallVertex
+{
+	static const char* Name() { return "IntersectBallVertex"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData&)
+	{
+		c.b = rng.Point(10.0f);
+		c.r1 = rng.Uniform(0.1f, 1.0f);
+
+		Approach(rng, kind, c.b, rng.Unit(), c.r1, c.a, c.vel1);
+	}
+
+	static float Run(const TCase& c, const TBenchData&)
+	{
+		return IntersectBallVertex(c.a, c.vel1, c.r1, c.b, 1.0f);
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Point relative to a wall for the wall tests: inside it, outside it, on one of its
+sides or on one of its corners
+-----------------------------------------------------------------------------------*/
+
+static TVector WallPoint(TRandom& rng, int kind, const TWall& wall, float offset)
+{
+	float w = wall.point2.x - wall.point1.x;
+	float h = wall.point2.y - wall.point1.y;
+	float x, y;
+
+	switch (kind)
+	{
+	case CASE_HIT:
+		x = rng.Uniform(0.0f, 1.0f);
+		y = rng.Uniform(0.0f, 1.0f);
+		break;
+
+	case CASE_MISS:
+		x = rng.Uniform(1.05f, 2.0f) * ((rng.Next() & 1) ? 1.0f : -1.0f);
+		y = rng.Uniform(-1.0f, 2.0f);
+		break;
+
+	case CASE_GRAZE:
+		x = (rng.Next() & 1) ? 0.0f : 1.0f;
+		y = rng.Uniform(0.0f, 1.0f);
+		break;
+
+	default:
+		x = (rng.Next() & 1) ? 0.0f : 1.0f;
+		y = (rng.Next() & 1) ? 0.0f : 1.0f;
+		break;
+	}
+
+	TVector local(wall.point1.x + w * x, wall.point1.y + h * y, offset);
+	return local * wall.trans;
+}
+
+struct KBallOnWall
+{
+	static const char* Name() { return "IsBallOnWall"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData& data)
+	{
+		c.wall = rng.Next() % data.walls.size();
+		c.a = WallPoint(rng, kind, data.walls[c.wall], rng.Uniform(-1.0f, 1.0f));
+	}
+
+	static float Run(const TCase& c, const TBenchData& data)
+	{
+		return IsBallOnWall(c.a, data.walls[c.wall]) ? 0.0f : -1.0f;
+	}
+};
+
+struct KBoxOnWall
+{
+	static const char* Name() { return "IsBoxOnWall"; }
+
+	static void Generate(TRandom& rng, int kind, TCase& c, TBenchData& data)
+	{
+		c.wall = rng.Next() % data.walls.size();
+
+		// One corner of the box is placed by the kind of case, the other beyond it
+		TVector corner = WallPoint(rng, kind, data.walls[c.wall], rng.Uniform(-1.0f, 1.0f));
+		TVector size(rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f));
+
+		if (rng.Next() & 1)
+		{
+			c.a = corner;
+			c.b = corner + size;
+		}
+		else
+		{
+			c.a = corner - size;
+			c.b = corner;
+		}
+	}
+
+	static float Run(const TCase& c, const TBenchData& data)
+	{
+		return IsBoxOnWall(TAABB(c.a, c.b), data.walls[c.wall]) ? 0.0f : -1.0f;
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Results of a kernel
+-----------------------------------------------------------------------------------*/
+
+struct TResult
+{
+	const char *name;
+	int cases;
+	long long calls;			// Calls made by all the timed runs
+	double ns_per_call;			// Median of the runs
+	double min_ns_per_call;		// Fastest run
+	float hit_rate;				// Fraction of the cases with a result from 0 to 1
+};
+
+typedef chrono::steady_clock TClock;
+
+static volatile float sink;		// Keeps the results of the calls from being optimised away
+
+/*-----------------------------------------------------------------------------------
+Generate the cases of a kernel, shuffled so the kinds do not follow a pattern
+the branch predictor could learn, then time the kernel over them.  Each timed
+run loops over all the cases until run_ms has passed.
+-----------------------------------------------------------------------------------*/
+
+template <class TKernel>
+static TResult Bench(TBenchData& data, int num_cases, int run_ms, int runs, unsigned int seed)
+{
+	TRandom rng(seed);
+
+	data.cases.resize(num_cases);
+	for (int k = 0; k < num_cases; k++)
+		TKernel::Generate(rng, k % NUM_CASE_KINDS, data.cases[k], data);
+
+	for (int k = num_cases - 1; k > 0; k--)
+		swap(data.cases[k], data.cases[rng.Next() % (k + 1)]);
+
+	TResult result;
+	result.name = TKernel::Name();
+	result.cases = num_cases;
+	result.calls = 0;
+
+	// Warm up, counting the hits
+	int hits = 0;
+	for (int k = 0; k < num_cases; k++)
+	{
+		float t = TKernel::Run(data.cases[k], data);
+		if (t >= 0.0f && t <= 1.0f)
+			hits++;
+	}
+	result.hit_rate = (float)hits / num_cases;
+
+	vector<double> run_ns(runs);
+	float sum = 0.0f;
+
+	for (int r = 0; r < runs; r++)
+	{
+		long long calls = 0;
+		double elapsed_ns;
+		TClock::time_point start = TClock::now();
+
+		do
+		{
+			for (int k = 0; k < num_cases; k++)
+				sum += TKernel::Run(data.cases[k], data);
+
+			calls += num_cases;
+			elapsed_ns = chrono::duration<double, nano>(TClock::now() - start).count();
+		} while (elapsed_ns < run_ms * 1e6);
+
+		run_ns[r] = elapsed_ns / calls;
+		result.calls += calls;
+	}
+
+	sink = sum;
+
+	sort(run_ns.begin(), run_ns.end());
+	result.ns_per_call = run_ns[runs / 2];
+	result.min_ns_per_call = run_ns[0];
+
+	return result;
+}
+
+/*-----------------------------------------------------------------------------------
+Walls of random sizes and orientations shared by the wall cases
+-----------------------------------------------------------------------------------*/
+
+static void MakeWalls(TBenchData& data, unsigned int seed)
+{
+	TRandom rng(seed);
+
+	for (int k = 0; k < BENCH_WALLS; k++)
+	{
+		TVector p1(rng.Uniform(-5.0f, 0.0f), rng.Uniform(-5.0f, 0.0f), 0.0f);
+		TVector p2(rng.Uniform(0.5f, 5.0f), rng.Uniform(0.5f, 5.0f), 0.0f);
+		int axis = rng.Next() % 4;					// 0 for no rotation
+
+		data.walls.push_back(TWall(	p1, p2, rng.Point(10.0f), rng.Uniform(0.0f, PI2),
+									axis, -1, -1));
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Inputs of one call of a batch test: a single ball or box and a block of balls,
+boxes or walls laid out as the collision tests lay them out
+-----------------------------------------------------------------------------------*/
+
+struct TBatchCase
+{
+	TVector center, box_max;		// The single ball or point, or the corners of the single box
+	TVector disp;
+	float radius, dt, t_max, min_time;
+	int num;
+
+	vector<float> x, y, z;			// Ball centres, box minimums, vertices or edge starts
+	vector<float> max_x, max_y, max_z;	// Box maximums or edge ends
+	vector<float> radii;
+	vector<float> vx, vy, vz;
+
+	// Walls, see CCollisions::TWallBlock
+	vector<float> nx, ny, nz, distance;
+	vector<float> to_x[4], to_y[4];
+	vector<float> wall_min_x, wall_max_x, wall_min_y, wall_max_y;
+
+	void Clear();
+	void AddWall(const TWall& wall);
+	TWallArrays WallArrays() const;
+};
+
+void TBatchCase::Clear()
+{
+	x.clear();		y.clear();		z.clear();
+	max_x.clear();	max_y.clear();	max_z.clear();
+	radii.clear();
+	vx.clear();		vy.clear();		vz.clear();
+
+	nx.clear();		ny.clear();		nz.clear();
+	distance.clear();
+
+	for (int j = 0; j < 4; j++)
+	{
+		to_x[j].clear();
+		to_y[j].clear();
+	}
+
+	wall_min_x.clear();	wall_max_x.clear();
+	wall_min_y.clear();	wall_max_y.clear();
+}
+
+void TBatchCase::AddWall(const TWall& wall)
+{
+	nx.push_back(wall.normal.x);
+	ny.push_back(wall.normal.y);
+	nz.push_back(wall.normal.z);
+	distance.push_back(wall.distance);
+
+	for (int j = 0; j < 4; j++)
+	{
+		to_x[j].push_back(wall.inv_trans.m[j * 4]);
+		to_y[j].push_back(wall.inv_trans.m[j * 4 + 1]);
+	}
+
+	wall_min_x.push_back(wall.min_x);
+	wall_max_x.push_back(wall.max_x);
+	wall_min_y.push_back(wall.min_y);
+	wall_max_y.push_back(wall.max_y);
+}
+
+TWallArrays TBatchCase::WallArrays() const
+{
+	TWallArrays a;
+	a.nx = &nx[0];
+	a.ny = &ny[0];
+	a.nz = &nz[0];
+	a.distance = &distance[0];
+
+	for (int j = 0; j < 4; j++)
+	{
+		a.to_x[j] = &to_x[j][0];
+		a.to_y[j] = &to_y[j][0];
+	}
+
+	a.min_x = &wall_min_x[0];
+	a.max_x = &wall_max_x[0];
+	a.min_y = &wall_min_y[0];
+	a.max_y = &wall_max_y[0];
+
+	return a;
+}
+
+/*-----------------------------------------------------------------------------------
+What a batch test gives back
+-----------------------------------------------------------------------------------*/
+
+struct TBatchOutput
+{
+	int num_hits;
+	int hits[VERIFY_MAX_BLOCK];
+	float times[VERIFY_MAX_BLOCK];
+	float min_time;
+	int min_wall;				// -1 for the tests between balls or boxes
+
+	// Equal bit for bit
+	bool operator==(const TBatchOutput& o) const
+	{
+		return	num_hits == o.num_hits && min_wall == o.min_wall &&
+				memcmp(&min_time, &o.min_time, sizeof(float)) == 0 &&
+				memcmp(hits, o.hits, num_hits * sizeof(int)) == 0 &&
+				memcmp(times, o.times, num_hits * sizeof(float)) == 0;
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+The batch tests.  Generate fills in a block of random size, each member of which
+is a case of a random kind against the single object, so every width of the
+SIMD loop and of the scalar loop finishing it is run.  Run makes the call.
+-----------------------------------------------------------------------------------*/
+
+static void StartBatch(TRandom& rng, TBatchCase& c)
+{
+	c.Clear();
+	c.num = 1 + rng.Next() % VERIFY_MAX_BLOCK;
+	c.dt = rng.Uniform(0.005f, 0.05f);
+	c.t_max = rng.Uniform(0.5f, 1.0f);
+
+	// Either nothing found yet, or an earlier hit the block may not lower
+	c.min_time = (rng.Next() & 1) ? c.t_max : rng.Uniform(0.0f, c.t_max);
+}
+
+struct KBallBallBatch
+{
+	static const char* Name() { return "IntersectBallBallBatch"; }
+
+	static void Generate(TRandom& rng, TBatchCase& c, TBenchData&)
+	{
+		StartBatch(rng, c);
+		c.center = rng.Point(10.0f);
+		c.radius = rng.Uniform(0.1f, 1.0f);
+		c.disp = rng.Point(1.0f);
+
+		for (int k = 0; k < c.num; k++)
+		{
+			TVector n = rng.Unit();
+			float r = rng.Uniform(0.1f, 1.0f);
+
+			TVector start, vel;
+			Approach(rng, rng.Next() % NUM_CASE_KINDS, c.center + n * c.radius, n, r, start, vel);
+			vel = (c.disp + vel) * (1.0f / c.dt);
+
+			c.x.push_back(start.x);
+			c.y.push_back(start.y);
+			c.z.push_back(start.z);
+			c.radii.push_back(r);
+			c.vx.push_back(vel.x);
+			c.vy.push_back(vel.y);
+			c.vz.push_back(vel.z);
+		}
+	}
+
+	static void Run(const TBatchCase& c, const TBenchData&, TBatchOutput& out)
+	{
+		out.min_time = c.min_time;
+		out.min_wall = -1;
+		out.num_hits = IntersectBallBallBatch(	c.center, c.radius, c.disp, &c.x[0], &c.y[0],
+												&c.z[0], &c.radii[0], &c.vx[0], &c.vy[0],
+												&c.vz[0], c.dt, c.num, c.t_max, out.hits,
+												out.times, out.min_time);
+	}
+};
+
+struct KBoxBoxBatch
+{
+	static const char* Name() { return "IntersectBoxBoxBatch"; }
+
+	static void Generate(TRandom& rng, TBatchCase& c, TBenchData&)
+	{
+		StartBatch(rng, c);
+		TVector center1 = rng.Point(10.0f);
+		TVector half1(rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f));
+		c.center = center1 - half1;
+		c.box_max = center1 + half1;
+		c.disp = rng.Point(1.0f);
+
+		// Each box of the block approaches a face of the single box
+		for (int k = 0; k < c.num; k++)
+		{
+			TVector half2(rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f), rng.Uniform(0.1f, 1.0f));
+			int axis = rng.Next() % 3;
+			TVector n(0.0f, 0.0f, 0.0f);
+			n[axis] = (rng.Next() & 1) ? 1.0f : -1.0f;
+
+			TVector p = center1 + n * half1[axis];
+			for (int j = 0; j < 3; j++)
+			{
+				if (j != axis)
+					p[j] += rng.Uniform(-half1[j], half1[j]);
+			}
+
+			TVector center2, vel;
+			Approach(rng, rng.Next() % NUM_CASE_KINDS, p, n, half2[axis], center2, vel);
+			vel = (c.disp + vel) * (1.0f / c.dt);
+
+			c.x.push_back(center2.x - half2.x);
+			c.y.push_back(center2.y - half2.y);
+			c.z.push_back(center2.z - half2.z);
+			c.max_x.push_back(center2.x + half2.x);
+			c.max_y.push_back(center2.y + half2.y);
+			c.max_z.push_back(center2.z + half2.z);
+			c.vx.push_back(vel.x);
+			c.vy.push_back(vel.y);
+			c.vz.push_back(vel.z);
+		}
+	}
+
+	static void Run(const TBatchCase& c, const TBenchData&, TBatchOutput& out)
+	{
+		out.min_time = c.min_time;
+		out.min_wall = -1;
+		out.num_hits = IntersectBoxBoxBatch(c.center, c.box_max, c.disp, &c.x[0], &c.y[0],
+											&c.z[0], &c.max_x[0], &c.max_y[0], &c.max_z[0],
+											&c.vx[0], &c.vy[0], &c.vz[0], c.dt, c.num,
+											c.t_max, out.hits, out.times, out.min_time);
+	}
+};
+
+struct KBallWallBatch
+{
+	static const char* Name() { return "IntersectBallWallBatch"; }
+
+	static void Generate(TRandom& rng, TBatchCase& c, TBenchData& data)
+	{
+		StartBatch(rng, c);
+		int target = rng.Next() % c.num;
+		int target_wall = 0;
+
+		for (int k = 0; k < c.num; k++)
+		{
+			int w = rng.Next() % data.walls.size();
+			c.AddWall(data.walls[w]);
+			if (k == target)
+				target_wall = w;
+		}
+
+		// The ball is placed against one wall of the block, the others it may or
+		// may not meet.  Some balls have sunk part way into the wall.
+		const TWall& wall = data.walls[target_wall];
+		c.radius = rng.Uniform(0.1f, 1.0f);
+
+		int kind = rng.Next() % NUM_CASE_KINDS;
+		Approach(rng, kind, WallPoint(rng, kind, wall, 0.0f), wall.normal, c.radius,
+				 c.center, c.disp);
+
+		if (rng.Next() % 4 == 0)
+			c.center = c.center - wall.normal * rng.Uniform(0.0f, c.radius);
+	}
+
+	static void Run(const TBatchCase& c, const TBenchData&, TBatchOutput& out)
+	{
+		out.min_time = c.min_time;
+		out.num_hits = IntersectBallWallBatch(	c.center, c.radius, c.disp, c.WallArrays(),
+												c.num, c.t_max, out.hits, out.times,
+												out.min_time, out.min_wall);
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Keep the times of the tests writing a time for each object, those from 0 on,
+as the hits
+-----------------------------------------------------------------------------------*/
+
+static void KeepTimes(const TBatchCase& c, const float *times, TBatchOutput& out)
+{
+	out.num_hits = 0;
+	out.min_time = c.min_time;
+	out.min_wall = -1;
+
+	for (int k = 0; k < c.num; k++)
+	{
+		if (!(times[k] >= 0.0f))
+			continue;
+
+		out.hits[out.num_hits] = k;
+		out.times[out.num_hits] = times[k];
+		out.num_hits++;
+
+		if (times[k] < out.min_time)
+			out.min_time = times[k];
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Point near the path of a point moving by disp from start, at about r from it so
+the sphere or cylinder of radius r around it is entered, grazed or missed.  Some
+are just touching at the start.
+-----------------------------------------------------------------------------------*/
+
+static TVector NearPath(TRandom& rng, const TVector& start, const TVector& disp, float r)
+{
+	if (rng.Next() % 8 == 0)
+		return start + rng.Unit() * r;
+
+	return start + disp * rng.Uniform(-0.2f, 1.2f) + rng.Unit() * rng.Uniform(0.0f, 2.0f * r);
+}
+
+struct KEnterSphereBatch
+{
+	static const char* Name() { return "EnterSphereBatch"; }
+
+	static void Generate(TRandom& rng, TBatchCase& c, TBenchData&)
+	{
+		StartBatch(rng, c);
+		c.center = rng.Point(10.0f);
+		c.disp = rng.Point(3.0f);
+		c.radius = rng.Uniform(0.1f, 1.0f);
+
+		for (int k = 0; k < c.num; k++)
+		{
+			TVector p = NearPath(rng, c.center, c.disp, c.radius);
+			c.x.push_back(p.x);
+			c.y.push_back(p.y);
+			c.z.push_back(p.z);
+		}
+	}
+
+	static void Run(const TBatchCase& c, const TBenchData&, TBatchOutput& out)
+	{
+		float times[VERIFY_MAX_BLOCK];
+		EnterSphereBatch(	c.center, c.disp, &c.x[0], &c.y[0], &c.z[0], c.radius, c.num,
+							c.t_max, times);
+		KeepTimes(c, times, out);
+	}
+};
+
+struct KEnterEdgeCylinderBatch
+{
+	static const char* Name() { return "EnterEdgeCylinderBatch"; }
+
+	static void Generate(TRandom& rng, TBatchCase& c, TBenchData&)
+	{
+		StartBatch(rng, c);
+		c.center = rng.Point(10.0f);
+		c.disp = rng.Point(3.0f);
+		c.radius = rng.Uniform(0.1f, 1.0f);
+
+		// Some of the edges run along the path, so the point does not move across them
+		for (int k = 0; k < c.num; k++)
+		{
+			TVector p1 = NearPath(rng, c.center, c.disp, c.radius);
+			TVector p2 = (rng.Next() % 8 == 0) ? p1 + c.disp * rng.Uniform(0.5f, 2.0f) :
+												 p1 + rng.Point(3.0f);
+			c.x.push_back(p1.x);
+			c.y.push_back(p1.y);
+			c.z.push_back(p1.z);
+			c.max_x.push_back(p2.x);
+			c.max_y.push_back(p2.y);
+			c.max_z.push_back(p2.z);
+		}
+	}
+
+	static void Run(const TBatchCase& c, const TBenchData&, TBatchOutput& out)
+	{
+		float times[VERIFY_MAX_BLOCK];
+		EnterEdgeCylinderBatch(	c.center, c.disp, &c.x[0], &c.y[0], &c.z[0], &c.max_x[0],
+								&c.max_y[0], &c.max_z[0], c.radius, c.num, c.t_max, times);
+		KeepTimes(c, times, out);
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Results of verifying a batch test
+-----------------------------------------------------------------------------------*/
+
+struct TVerifyResult
+{
+	const char *name;
+	int blocks;
+	long long hits;				// Hits found by the scalar tests
+	int mismatches;				// Blocks where the SIMD tests gave something else
+};
+
+/*-----------------------------------------------------------------------------------
+Run a batch test over generated blocks with SIMD off and then on and compare
+what they give back, which must be the same bit for bit.  The first blocks that
+differ are printed.
+-----------------------------------------------------------------------------------*/
+
+template <class TKernel>
+static TVerifyResult Verify(TBenchData& data, int num_blocks, unsigned int seed)
+{
+	TRandom rng(seed);
+	TBatchCase c;
+	TBatchOutput scalar, simd;
+
+	TVerifyResult result;
+	result.name = TKernel::Name();
+	result.blocks = num_blocks;
+	result.hits = 0;
+	result.mismatches = 0;
+
+	for (int k = 0; k < num_blocks; k++)
+	{
+		TKernel::Generate(rng, c, data);
+
+		EnableSimd(false);
+		TKernel::Run(c, data, scalar);
+		EnableSimd(true);
+		TKernel::Run(c, data, simd);
+
+		result.hits += scalar.num_hits;
+		if (scalar == simd)
+			continue;
+
+		if (result.mismatches++ < VERIFY_PRINTED)
+		{
+			fprintf(stderr,	"%s block %d (%d objects): %d hits, min time %.9g, wall %d scalar; "
+							"%d hits, min time %.9g, wall %d SIMD\n",
+							result.name, k, c.num, scalar.num_hits, scalar.min_time,
+							scalar.min_wall, simd.num_hits, simd.min_time, simd.min_wall);
+		}
+	}
+
+	return result;
+}
+
+/*-----------------------------------------------------------------------------------
+Verify the batch tests chosen, returning the number of them that failed (or 1 if
+none of them has the name asked for)
+-----------------------------------------------------------------------------------*/
+
+static int VerifyBatches(TBenchData& data, const char *only, int num_blocks, unsigned int seed)
+{
+	if (!EnableSimd(true))
+	{
+		fprintf(stderr, "No SIMD support, the batch tests only have their scalar loops\n");
+		return 0;
+	}
+
+	typedef TVerifyResult (*TVerifyFunc)(TBenchData&, int, unsigned int);
+	struct TEntry
+	{
+		const char *name;
+		TVerifyFunc verify;
+	};
+
+	TEntry kernels[] =
+	{
+		{ KBallBallBatch::Name(),			Verify<KBallBallBatch> },
+		{ KBoxBoxBatch::Name(),				Verify<KBoxBoxBatch> },
+		{ KBallWallBatch::Name(),			Verify<KBallWallBatch> },
+		{ KEnterSphereBatch::Name(),		Verify<KEnterSphereBatch> },
+		{ KEnterEdgeCylinderBatch::Name(),	Verify<KEnterEdgeCylinderBatch> },
+	};
+	int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+	int num_run = 0, failed = 0;
+	for (int k = 0; k < num_kernels; k++)
+	{
+		if (only != NULL && strcmp(only, kernels[k].name) != 0)
+			continue;
+
+		TVerifyResult r = kernels[k].verify(data, num_blocks, seed + k);
+		printf(	"%s: %d blocks, %lld hits, %d mismatches\n", r.name, r.blocks, r.hits,
+				r.mismatches);
+		fflush(stdout);
+
+		num_run++;
+		if (r.mismatches > 0)
+			failed++;
+	}
+
+	EnableSimd(true);
+
+	if (num_run == 0)
+	{
+		fprintf(stderr, "No batch test named %s\n", only);
+		return 1;
+	}
+
+	return failed;
+}
+
+/*-----------------------------------------------------------------------------------
+Write a result as a CSV row or a JSON line
+-----------------------------------------------------------------------------------*/
+
+static void PrintResult(const TResult& r, bool json)
+{
+	double calls_per_sec = 1e9 / r.ns_per_call;
+
+	if (json)
+	{
+		printf(	"{\"kernel\":\"%s\",\"cases\":%d,\"calls\":%lld,\"ns_per_call\":%.3f,"
+				"\"min_ns_per_call\":%.3f,\"calls_per_sec\":%.0f,\"hit_rate\":%.4f}\n",
+				r.name, r.cases, r.calls, r.ns_per_call, r.min_ns_per_call, calls_per_sec,
+				r.hit_rate);
+	}
+	else
+	{
+		printf(	"%s,%d,%lld,%.3f,%.3f,%.0f,%.4f\n", r.name, r.cases, r.calls, r.ns_per_call,
+				r.min_ns_per_call, calls_per_sec, r.hit_rate);
+	}
+
+	fflush(stdout);
+}
+
+/*-----------------------------------------------------------------------------------
+Print how the options are used
+-----------------------------------------------------------------------------------*/
+
+static void PrintUsage()
+{
+	fprintf(stderr,	"usage: geomath_bench [-kernel name] [-cases n] [-ms n] [-runs n] "
+					"[-seed n] [-json] [-verify]\n");
+}
+
+/*-----------------------------------------------------------------------------------
+Run the kernels chosen
+-----------------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	const char *only = NULL;
+	int num_cases = BENCH_CASES;
+	int run_ms = BENCH_RUN_MS;
+	int runs = BENCH_RUNS;
+	unsigned int seed = BENCH_SEED;
+	bool json = false;
+	bool verify = false;
+
+	for (int k = 1; k < argc; k++)
+	{
+		bool has_value = (k + 1 < argc);
+
+		if (strcmp(argv[k], "-kernel") == 0 && has_value)
+			only = argv[++k];
+		else if (strcmp(argv[k], "-cases") == 0 && has_value)
+			num_cases = atoi(argv[++k]);
+		else if (strcmp(argv[k], "-ms") == 0 && has_value)
+			run_ms = atoi(argv[++k]);
+		else if (strcmp(argv[k], "-runs") == 0 && has_value)
+			runs = atoi(argv[++k]);
+		else if (strcmp(argv[k], "-seed") == 0 && has_value)
+			seed = (unsigned int)strtoul(argv[++k], NULL, 10);
+		else if (strcmp(argv[k], "-json") == 0)
+			json = true;
+		else if (strcmp(argv[k], "-verify") == 0)
+			verify = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (num_cases < NUM_CASE_KINDS || run_ms <= 0 || runs <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	TBenchData data;
+	MakeWalls(data, seed);
+
+	if (verify)
+		return (VerifyBatches(data, only, num_cases, seed) == 0) ? 0 : 1;
+
+	typedef TResult (*TBenchFunc)(TBenchData&, int, int, int, unsigned int);
+	struct TEntry
+	{
+		const char *name;
+		TBenchFunc bench;
+	};
+
+	TEntry kernels[] =
+	{
+		{ KBallPlane::Name(),		Bench<KBallPlane> },
+		{ KBallBall::Name(),		Bench<KBallBall> },
+		{ KBoxPlane::Name(),		Bench<KBoxPlane> },
+		{ KBoxBox::Name(),			Bench<KBoxBox> },
+		{ KBallTriangle::Name(),	Bench<KBallTriangle> },
+		{ KBallEdge::Name(),		Bench<KBallEdge> },
+		{ KBallVertex::Name(),		Bench<KBallVertex> },
+		{ KBallOnWall::Name(),		Bench<KBallOnWall> },
+		{ KBoxOnWall::Name(),		Bench<KBoxOnWall> },
+	};
+	int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+	if (!json)
+		printf("kernel,cases,calls,ns_per_call,min_ns_per_call,calls_per_sec,hit_rate\n");
+
+	int num_run = 0;
+	for (int k = 0; k < num_kernels; k++)
+	{
+		if (only != NULL && strcmp(only, kernels[k].name) != 0)
+			continue;
+
+		PrintResult(kernels[k].bench(data, num_cases, run_ms, runs, seed + k), json);
+		num_run++;
+	}
+
+	if (num_run == 0)
+	{
+		fprintf(stderr, "No kernel named %s\n", only);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,724 @@
+/*-----------------------------------------------------------------------------------
+File:			geoMathSimd.cpp
+Authors:		Steve Costa
+Description:	Batched versions of the geometric tests which test one object
+				against a block of objects held as arrays of their components.
+				On x86-64 the blocks are processed SIMD_WIDTH at a time with AVX2
+				when the processor supports it, otherwise (and for the objects
+				left over) the scalar tests are used.  Both paths perform the
+				same float operations in the same order so their results are
+				bit-identical.  Contracting them into fused multiply-adds would
+				change the rounding, so only AVX2 (not FMA) code is generated.
+-----------------------------------------------------------------------------------*/
+
+#include "geoMath.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+	#define GEOMATH_AVX2
+	#define GEOMATH_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+	#define GEOMATH_AVX2
+	#define GEOMATH_TARGET_AVX2
+	#include <intrin.h>
+#endif
+
+#ifdef GEOMATH_AVX2
+	#include <immintrin.h>
+#endif
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define SIMD_WIDTH			8			// Floats in an AVX register
+
+/*-----------------------------------------------------------------------------------
+Check whether the processor and operating system support AVX2
+-----------------------------------------------------------------------------------*/
+
+static bool HasAVX2()
+{
+#if defined(GEOMATH_AVX2) && defined(__GNUC__)
+	return __builtin_cpu_supports("avx2") != 0;
+#elif defined(GEOMATH_AVX2)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The OS must save the YMM registers (OSXSAVE and XCR0 bits 1 and 2)
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+static bool simd_enabled = HasAVX2();
+
+/*-----------------------------------------------------------------------------------
+Allow the batch tests to use SIMD instructions.  They can only be turned on if
+the processor supports them.  Returns whether they are in use.
+-----------------------------------------------------------------------------------*/
+
+bool geomath::EnableSimd(bool enable)
+{
+	simd_enabled = enable && HasAVX2();
+	return simd_enabled;
+}
+
+bool geomath::IsSimdEnabled()
+{
+	return simd_enabled;
+}
+
+/*-----------------------------------------------------------------------------------
+Keep a collision time if it is between 0 and t_max (which rules out NaN)
+-----------------------------------------------------------------------------------*/
+
+static inline void KeepHit(float time, int index, float t_max, int *hits, float *times,
+						   int& num_hits, float& min_time)
+{
+	if (!(time >= 0.0f && time <= t_max))
+		return;
+
+	hits[num_hits] = index;
+	times[num_hits] = time;
+	num_hits++;
+
+	if (time < min_time)
+		min_time = time;
+}
+
+#ifdef GEOMATH_AVX2
+
+/*-----------------------------------------------------------------------------------
+Keep the times of the lanes set in valid, lane 0 being object k of the block
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static inline void KeepLanes(__m256 t, __m256 valid, int k, float t_max, int *hits,
+							 float *times, int& num_hits, float& min_time)
+{
+	int mask = _mm256_movemask_ps(valid);
+	if (mask == 0)
+		return;
+
+	float lane_times[SIMD_WIDTH];
+	_mm256_storeu_ps(lane_times, t);
+
+	for (int lane = 0; lane < SIMD_WIDTH; lane++)
+	{
+		if (mask & (1 << lane))
+			KeepHit(lane_times[lane], k + lane, t_max, hits, times, num_hits, min_time);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+AVX2 version of the ball test for the first num - (num % SIMD_WIDTH) balls.  Each
+step mirrors a line of IntersectBallBall, the branches becoming lane masks.
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static int IntersectBallBallAVX2(	const TVector& center, float radius, const TVector& disp,
+									const float *x, const float *y, const float *z,
+									const float *radii, const float *vx, const float *vy,
+									const float *vz, float dt, int num, float t_max,
+									int *hits, float *times, float& min_time)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 t_hi = _mm256_set1_ps(t_max);
+
+	__m256 cx = _mm256_set1_ps(center.x);
+	__m256 cy = _mm256_set1_ps(center.y);
+	__m256 cz = _mm256_set1_ps(center.z);
+	__m256 dx1 = _mm256_set1_ps(disp.x);
+	__m256 dy1 = _mm256_set1_ps(disp.y);
+	__m256 dz1 = _mm256_set1_ps(disp.z);
+	__m256 rad = _mm256_set1_ps(radius);
+	__m256 step = _mm256_set1_ps(dt);
+
+	int num_hits = 0;
+	int num_blocks = num - (num % SIMD_WIDTH);
+
+	for (int k = 0; k < num_blocks; k += SIMD_WIDTH)
+	{
+		__m256 r = _mm256_add_ps(rad, _mm256_loadu_ps(radii + k));
+
+		// Vector between centres
+		__m256 ex = _mm256_sub_ps(cx, _mm256_loadu_ps(x + k));
+		__m256 ey = _mm256_sub_ps(cy, _mm256_loadu_ps(y + k));
+		__m256 ez = _mm256_sub_ps(cz, _mm256_loadu_ps(z + k));
+
+		// Relative displacement
+		__m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vx + k), step), dx1);
+		__m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vy + k), step), dy1);
+		__m256 dz = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vz + k), step), dz1);
+
+		// Normalized displacement, zero where there is no movement
+		__m256 mag_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+													_mm256_mul_ps(dy, dy)),
+									  _mm256_mul_ps(dz, dz));
+		__m256 moving = _mm256_cmp_ps(mag_sq, zero, _CMP_GT_OQ);
+		__m256 flipped = _mm256_div_ps(one, _mm256_sqrt_ps(mag_sq));
+		__m256 dnx = _mm256_and_ps(moving, _mm256_mul_ps(dx, flipped));
+		__m256 dny = _mm256_and_ps(moving, _mm256_mul_ps(dy, flipped));
+		__m256 dnz = _mm256_and_ps(moving, _mm256_mul_ps(dz, flipped));
+		__m256 dm = _mm256_sqrt_ps(mag_sq);
+
+		__m256 e_dn = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, dnx),
+												  _mm256_mul_ps(ey, dny)),
+									_mm256_mul_ps(ez, dnz));
+		__m256 e_e = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex),
+												 _mm256_mul_ps(ey, ey)),
+								   _mm256_mul_ps(ez, ez));
+
+		// Discriminant
+		__m256 eq1 = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(e_dn, e_dn), _mm256_mul_ps(r, r)),
+								   e_e);
+
+		__m256 t = _mm256_div_ps(_mm256_sub_ps(e_dn, _mm256_sqrt_ps(eq1)), dm);
+
+		// Early rejects of the scalar test (dm > r, eq1 < 0) and the time window.
+		// NaN fails the ordered compares just as it does in KeepHit.
+		__m256 valid = _mm256_andnot_ps(_mm256_cmp_ps(dm, r, _CMP_GT_OQ),
+										_mm256_cmp_ps(eq1, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, t_hi, _CMP_LE_OQ));
+
+		KeepLanes(t, valid, k, t_max, hits, times, num_hits, min_time);
+	}
+
+	return num_hits;
+}
+
+/*-----------------------------------------------------------------------------------
+Narrow the interval [t_enter, t_exit] to the times the boxes overlap along one
+axis, given the gaps between their faces and the relative displacement d along
+it.  This is one axis of IntersectBoxBox with every branch replaced by a blend,
+lanes which IntersectBoxBox would have returned from are set in rejected.
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static inline void SlabAVX2(__m256 min1, __m256 max1, __m256 min2, __m256 max2, __m256 d,
+							__m256& t_enter, __m256& t_exit, __m256& rejected)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	// Lanes not moving along the axis must already overlap on it
+	__m256 still = _mm256_cmp_ps(d, zero, _CMP_EQ_OQ);
+	__m256 apart = _mm256_or_ps(_mm256_cmp_ps(min1, max2, _CMP_GE_OQ),
+								_mm256_cmp_ps(max1, min2, _CMP_LE_OQ));
+	rejected = _mm256_or_ps(rejected, _mm256_and_ps(still, apart));
+
+	// Times of start and end of the overlap, in order
+	__m256 d_flipped = _mm256_div_ps(one, d);
+	__m256 enter = _mm256_mul_ps(_mm256_sub_ps(min1, max2), d_flipped);
+	__m256 exit = _mm256_mul_ps(_mm256_sub_ps(max1, min2), d_flipped);
+	__m256 swap = _mm256_cmp_ps(enter, exit, _CMP_GT_OQ);
+	__m256 lo = _mm256_blendv_ps(enter, exit, swap);
+	__m256 hi = _mm256_blendv_ps(exit, enter, swap);
+
+	// Shorten the interval of the moving lanes
+	__m256 later = _mm256_andnot_ps(still, _mm256_cmp_ps(lo, t_enter, _CMP_GT_OQ));
+	__m256 sooner = _mm256_andnot_ps(still, _mm256_cmp_ps(hi, t_exit, _CMP_LT_OQ));
+	t_enter = _mm256_blendv_ps(t_enter, lo, later);
+	t_exit = _mm256_blendv_ps(t_exit, hi, sooner);
+
+	__m256 empty = _mm256_andnot_ps(still, _mm256_cmp_ps(t_enter, t_exit, _CMP_GT_OQ));
+	rejected = _mm256_or_ps(rejected, empty);
+}
+
+/*-----------------------------------------------------------------------------------
+AVX2 version of the box test for the first num - (num % SIMD_WIDTH) boxes.  A lane
+rejected by one axis keeps being computed by the others but is never kept.
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static int IntersectBoxBoxAVX2(	const TVector& box_min, const TVector& box_max,
+								const TVector& disp, const float *min_x, const float *min_y,
+								const float *min_z, const float *max_x, const float *max_y,
+								const float *max_z, const float *vx, const float *vy,
+								const float *vz, float dt, int num, float t_max,
+								int *hits, float *times, float& min_time)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	__m256 min1x = _mm256_set1_ps(box_min.x);
+	__m256 min1y = _mm256_set1_ps(box_min.y);
+	__m256 min1z = _mm256_set1_ps(box_min.z);
+	__m256 max1x = _mm256_set1_ps(box_max.x);
+	__m256 max1y = _mm256_set1_ps(box_max.y);
+	__m256 max1z = _mm256_set1_ps(box_max.z);
+	__m256 dx1 = _mm256_set1_ps(disp.x);
+	__m256 dy1 = _mm256_set1_ps(disp.y);
+	__m256 dz1 = _mm256_set1_ps(disp.z);
+	__m256 step = _mm256_set1_ps(dt);
+
+	int num_hits = 0;
+	int num_blocks = num - (num % SIMD_WIDTH);
+
+	for (int k = 0; k < num_blocks; k += SIMD_WIDTH)
+	{
+		// Box 1 is stationary and box 2 moves by the relative displacement
+		__m256 dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vx + k), step), dx1);
+		__m256 dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vy + k), step), dy1);
+		__m256 dz = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(vz + k), step), dz1);
+
+		__m256 t_enter = zero;
+		__m256 t_exit = one;
+		__m256 rejected = zero;
+
+		SlabAVX2(min1x, max1x, _mm256_loadu_ps(min_x + k), _mm256_loadu_ps(max_x + k), dx,
+				 t_enter, t_exit, rejected);
+		SlabAVX2(min1y, max1y, _mm256_loadu_ps(min_y + k), _mm256_loadu_ps(max_y + k), dy,
+				 t_enter, t_exit, rejected);
+		SlabAVX2(min1z, max1z, _mm256_loadu_ps(min_z + k), _mm256_loadu_ps(max_z + k), dz,
+				 t_enter, t_exit, rejected);
+
+		// Only a collision which starts after time 0 counts
+		__m256 valid = _mm256_andnot_ps(rejected, _mm256_cmp_ps(t_enter, zero, _CMP_GT_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t_enter, _mm256_set1_ps(t_max), _CMP_LE_OQ));
+
+		KeepLanes(t_enter, valid, k, t_max, hits, times, num_hits, min_time);
+	}
+
+	return num_hits;
+}
+
+/*-----------------------------------------------------------------------------------
+AVX2 version of the wall test for the first num - (num % SIMD_WIDTH) walls.  The
+direction and speed of the ball are the same for every wall so they are passed
+in, the rest mirrors IsBallOnWall followed by IntersectBallPlane.
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static int IntersectBallWallAVX2(	const TVector& center, float radius, const TVector& dir,
+									float speed, const geomath::TWallArrays& walls, int num,
+									float t_max, int *hits, float *times, float& min_time)
+{
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 cx = _mm256_set1_ps(center.x);
+	__m256 cy = _mm256_set1_ps(center.y);
+	__m256 cz = _mm256_set1_ps(center.z);
+	__m256 dx = _mm256_set1_ps(dir.x);
+	__m256 dy = _mm256_set1_ps(dir.y);
+	__m256 dz = _mm256_set1_ps(dir.z);
+	__m256 rad = _mm256_set1_ps(radius);
+	__m256 dm = _mm256_set1_ps(speed);
+
+	int num_hits = 0;
+	int num_blocks = num - (num % SIMD_WIDTH);
+
+	for (int k = 0; k < num_blocks; k += SIMD_WIDTH)
+	{
+		// Local coordinates of the centre on the wall
+		__m256 x = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(cx, _mm256_loadu_ps(walls.to_x[0] + k)),
+						_mm256_mul_ps(cy, _mm256_loadu_ps(walls.to_x[1] + k))),
+						_mm256_mul_ps(cz, _mm256_loadu_ps(walls.to_x[2] + k))),
+					_mm256_loadu_ps(walls.to_x[3] + k));
+		__m256 y = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(cx, _mm256_loadu_ps(walls.to_y[0] + k)),
+						_mm256_mul_ps(cy, _mm256_loadu_ps(walls.to_y[1] + k))),
+						_mm256_mul_ps(cz, _mm256_loadu_ps(walls.to_y[2] + k))),
+					_mm256_loadu_ps(walls.to_y[3] + k));
+
+		__m256 on_wall = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(x, _mm256_loadu_ps(walls.min_x + k), _CMP_GE_OQ),
+						  _mm256_cmp_ps(x, _mm256_loadu_ps(walls.max_x + k), _CMP_LE_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(y, _mm256_loadu_ps(walls.min_y + k), _CMP_GE_OQ),
+						  _mm256_cmp_ps(y, _mm256_loadu_ps(walls.max_y + k), _CMP_LE_OQ)));
+
+		__m256 nx = _mm256_loadu_ps(walls.nx + k);
+		__m256 ny = _mm256_loadu_ps(walls.ny + k);
+		__m256 nz = _mm256_loadu_ps(walls.nz + k);
+
+		// The ball must be travelling towards the plane
+		__m256 denominator = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, nx),
+														 _mm256_mul_ps(dy, ny)),
+										   _mm256_mul_ps(dz, nz));
+		__m256 towards = _mm256_cmp_ps(denominator, zero, _CMP_NGE_UQ);
+
+		__m256 c_n = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, nx), _mm256_mul_ps(cy, ny)),
+								   _mm256_mul_ps(cz, nz));
+		__m256 plane = _mm256_loadu_ps(walls.distance + k);
+		__m256 t = _mm256_add_ps(_mm256_sub_ps(plane, c_n), rad);
+		t = _mm256_div_ps(_mm256_div_ps(t, denominator), dm);
+
+		// Balls already overlapping the plane in front of it hit at time 0 (NaN is kept)
+		__m256 front = _mm256_cmp_ps(c_n, plane, _CMP_GE_OQ);
+		t = _mm256_blendv_ps(t, _mm256_max_ps(zero, t), front);
+
+		__m256 valid = _mm256_and_ps(on_wall, towards);
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(t_max), _CMP_LE_OQ));
+
+		KeepLanes(t, valid, k, t_max, hits, times, num_hits, min_time);
+	}
+
+	return num_hits;
+}
+
+/*-----------------------------------------------------------------------------------
+Dot product of the vectors held in three registers each, summed in the same
+order as TVector's operator *
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static inline __m256 DotAVX2(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)),
+						 _mm256_mul_ps(az, bz));
+}
+
+/*-----------------------------------------------------------------------------------
+Earlier root of the quadratic a*t^2 + 2*b*t + c = 0 as EnterSphere and
+EnterEdgeCylinder work it out, (-b - sqrt(b*b - a*c)) / a.  Lanes without a
+root are set in rejected.
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static inline __m256 EnterRootAVX2(__m256 a, __m256 b, __m256 c, __m256& rejected)
+{
+	__m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+	rejected = _mm256_or_ps(rejected, _mm256_cmp_ps(disc, _mm256_setzero_ps(), _CMP_LT_OQ));
+
+	__m256 neg_b = _mm256_xor_ps(b, _mm256_set1_ps(-0.0f));
+	return _mm256_div_ps(_mm256_sub_ps(neg_b, _mm256_sqrt_ps(disc)), a);
+}
+
+/*-----------------------------------------------------------------------------------
+AVX2 version of EnterSphere for the first num - (num % SIMD_WIDTH) vertices, the
+early outs becoming lane masks
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static void EnterSphereAVX2(const TVector& point, const TVector& velocity, const float *x,
+							const float *y, const float *z, float r, int num, float t_left,
+							float *times)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 none = _mm256_set1_ps(-1.0f);
+
+	__m256 px = _mm256_set1_ps(point.x);
+	__m256 py = _mm256_set1_ps(point.y);
+	__m256 pz = _mm256_set1_ps(point.z);
+	__m256 vx = _mm256_set1_ps(velocity.x);
+	__m256 vy = _mm256_set1_ps(velocity.y);
+	__m256 vz = _mm256_set1_ps(velocity.z);
+	__m256 a = _mm256_set1_ps(velocity * velocity);
+	__m256 rr = _mm256_set1_ps(r * r);
+	__m256 t_max = _mm256_set1_ps(t_left);
+
+	int num_blocks = num - (num % SIMD_WIDTH);
+
+	for (int k = 0; k < num_blocks; k += SIMD_WIDTH)
+	{
+		__m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(x + k));
+		__m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(y + k));
+		__m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(z + k));
+
+		__m256 b = DotAVX2(vx, vy, vz, dx, dy, dz);
+		__m256 c = _mm256_sub_ps(DotAVX2(dx, dy, dz, dx, dy, dz), rr);
+
+		// Moving away or missing the sphere
+		__m256 rejected = _mm256_cmp_ps(b, zero, _CMP_GE_OQ);
+		__m256 t = EnterRootAVX2(a, b, c, rejected);
+
+		rejected = _mm256_or_ps(rejected, _mm256_or_ps(_mm256_cmp_ps(t, zero, _CMP_LT_OQ),
+													   _mm256_cmp_ps(t, t_max, _CMP_GT_OQ)));
+
+		_mm256_storeu_ps(times + k, _mm256_blendv_ps(t, none, rejected));
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+AVX2 version of EnterEdgeCylinder for the first num - (num % SIMD_WIDTH) edges,
+the early outs becoming lane masks
+-----------------------------------------------------------------------------------*/
+
+GEOMATH_TARGET_AVX2
+static void EnterEdgeCylinderAVX2(	const TVector& point, const TVector& velocity,
+									const float *x1, const float *y1, const float *z1,
+									const float *x2, const float *y2, const float *z2,
+									float r, int num, float t_left, float *times)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 none = _mm256_set1_ps(-1.0f);
+
+	__m256 px = _mm256_set1_ps(point.x);
+	__m256 py = _mm256_set1_ps(point.y);
+	__m256 pz = _mm256_set1_ps(point.z);
+	__m256 vx = _mm256_set1_ps(velocity.x);
+	__m256 vy = _mm256_set1_ps(velocity.y);
+	__m256 vz = _mm256_set1_ps(velocity.z);
+	__m256 rr = _mm256_set1_ps(r * r);
+	__m256 t_max = _mm256_set1_ps(t_left);
+
+	int num_blocks = num - (num % SIMD_WIDTH);
+
+	for (int k = 0; k < num_blocks; k += SIMD_WIDTH)
+	{
+		__m256 p1x = _mm256_loadu_ps(x1 + k);
+		__m256 p1y = _mm256_loadu_ps(y1 + k);
+		__m256 p1z = _mm256_loadu_ps(z1 + k);
+
+		__m256 lx = _mm256_sub_ps(_mm256_loadu_ps(x2 + k), p1x);
+		__m256 ly = _mm256_sub_ps(_mm256_loadu_ps(y2 + k), p1y);
+		__m256 lz = _mm256_sub_ps(_mm256_loadu_ps(z2 + k), p1z);
+		__m256 inv_len2 = _mm256_div_ps(one, DotAVX2(lx, ly, lz, lx, ly, lz));
+
+		// Remove the parts of the point and velocity along the edge
+		__m256 dx = _mm256_sub_ps(px, p1x);
+		__m256 dy = _mm256_sub_ps(py, p1y);
+		__m256 dz = _mm256_sub_ps(pz, p1z);
+
+		__m256 s = _mm256_mul_ps(DotAVX2(dx, dy, dz, lx, ly, lz), inv_len2);
+		__m256 dpx = _mm256_sub_ps(dx, _mm256_mul_ps(s, lx));
+		__m256 dpy = _mm256_sub_ps(dy, _mm256_mul_ps(s, ly));
+		__m256 dpz = _mm256_sub_ps(dz, _mm256_mul_ps(s, lz));
+
+		s = _mm256_mul_ps(DotAVX2(vx, vy, vz, lx, ly, lz), inv_len2);
+		__m256 vpx = _mm256_sub_ps(vx, _mm256_mul_ps(s, lx));
+		__m256 vpy = _mm256_sub_ps(vy, _mm256_mul_ps(s, ly));
+		__m256 vpz = _mm256_sub_ps(vz, _mm256_mul_ps(s, lz));
+
+		__m256 a = DotAVX2(vpx, vpy, vpz, vpx, vpy, vpz);
+		__m256 b = DotAVX2(vpx, vpy, vpz, dpx, dpy, dpz);
+		__m256 c = _mm256_sub_ps(DotAVX2(dpx, dpy, dpz, dpx, dpy, dpz), rr);
+
+		// Moving away, parallel to the edge or already within the cylinder
+		__m256 rejected = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(a, zero, _CMP_EQ_OQ),
+													_mm256_cmp_ps(b, zero, _CMP_GE_OQ)),
+									   _mm256_cmp_ps(c, zero, _CMP_LE_OQ));
+		__m256 t = EnterRootAVX2(a, b, c, rejected);
+		rejected = _mm256_or_ps(rejected, _mm256_cmp_ps(t, t_max, _CMP_GT_OQ));
+
+		// Only the part of the cylinder between the end points
+		__m256 qx = _mm256_add_ps(dx, _mm256_mul_ps(vx, t));
+		__m256 qy = _mm256_add_ps(dy, _mm256_mul_ps(vy, t));
+		__m256 qz = _mm256_add_ps(dz, _mm256_mul_ps(vz, t));
+		__m256 along = _mm256_mul_ps(DotAVX2(qx, qy, qz, lx, ly, lz), inv_len2);
+
+		rejected = _mm256_or_ps(rejected, _mm256_or_ps(_mm256_cmp_ps(along, zero, _CMP_LT_OQ),
+													   _mm256_cmp_ps(along, one, _CMP_GT_OQ)));
+
+		_mm256_storeu_ps(times + k, _mm256_blendv_ps(t, none, rejected));
+	}
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------------
+Test one ball against a block of num balls for collisions, see IntersectBallBall.
+The block is given as arrays of the ball components (eg. from CSimStore), the
+velocities are scaled by dt while disp is the displacement of the single ball.
+
+The collisions between 0 and t_max are written in ball order to hits (the index
+of the ball within the block) and times, and the number of them is returned.
+min_time is lowered to the earliest of them.  A caller reducing to the earliest
+collision passes its earliest time so far plus its simultaneous window (ZERO) as
+t_max, so only the collisions which can still be among the earliest come back.
+-----------------------------------------------------------------------------------*/
+
+int geomath::IntersectBallBallBatch(const TVector& center, float radius, const TVector& disp,
+									const float *x, const float *y, const float *z,
+									const float *radii, const float *vx, const float *vy,
+									const float *vz, float dt, int num, float t_max,
+									int *hits, float *times, float& min_time)
+{
+	int num_hits = 0;
+	int k = 0;
+
+#ifdef GEOMATH_AVX2
+	if (simd_enabled)
+	{
+		num_hits = IntersectBallBallAVX2(center, radius, disp, x, y, z, radii, vx, vy, vz,
+										 dt, num, t_max, hits, times, min_time);
+		k = num - (num % SIMD_WIDTH);
+	}
+#endif
+
+	for (; k < num; k++)
+	{
+		float time = IntersectBallBall(	center, radius, disp,
+										TVector(x[k], y[k], z[k]), radii[k],
+										TVector(vx[k], vy[k], vz[k]) * dt);
+
+		KeepHit(time, k, t_max, hits, times, num_hits, min_time);
+	}
+
+	return num_hits;
+}
+
+/*-----------------------------------------------------------------------------------
+Test one box against a block of num boxes for collisions, see IntersectBoxBox.
+The block is given as arrays of the box components, the hits are returned as for
+IntersectBallBallBatch.
+-----------------------------------------------------------------------------------*/
+
+int geomath::IntersectBoxBoxBatch(	const TVector& box_min, const TVector& box_max,
+									const TVector& disp, const float *min_x, const float *min_y,
+									const float *min_z, const float *max_x, const float *max_y,
+									const float *max_z, const float *vx, const float *vy,
+									const float *vz, float dt, int num, float t_max,
+									int *hits, float *times, float& min_time)
+{
+	int num_hits = 0;
+	int k = 0;
+
+#ifdef GEOMATH_AVX2
+	if (simd_enabled)
+	{
+		num_hits = IntersectBoxBoxAVX2(	box_min, box_max, disp, min_x, min_y, min_z,
+										max_x, max_y, max_z, vx, vy, vz, dt, num, t_max,
+										hits, times, min_time);
+		k = num - (num % SIMD_WIDTH);
+	}
+#endif
+
+	for (; k < num; k++)
+	{
+		float time = IntersectBoxBox(	box_min, box_max, disp,
+										TVector(min_x[k], min_y[k], min_z[k]),
+										TVector(max_x[k], max_y[k], max_z[k]),
+										TVector(vx[k], vy[k], vz[k]) * dt);
+
+		KeepHit(time, k, t_max, hits, times, num_hits, min_time);
+	}
+
+	return num_hits;
+}
+
+/*-----------------------------------------------------------------------------------
+Test one ball against a block of num walls for collisions, see IsBallOnWall and
+IntersectBallPlane.  The direction and speed of the ball are only worked out
+once for all of the walls.  A ball that has sunk into a wall, rounding or another
+object having pushed it in, hits it at time 0 as long as its centre is still in
+front of it.  The hits are returned as for IntersectBallBallBatch, min_wall is set
+to the wall of the earliest one if it lowered min_time and to -1 otherwise.
+-----------------------------------------------------------------------------------*/
+
+int geomath::IntersectBallWallBatch(const TVector& center, float radius, const TVector& disp,
+									const TWallArrays& walls, int num, float t_max,
+									int *hits, float *times, float& min_time, int& min_wall)
+{
+	TVector dir = Normalized(disp);
+	float speed = Magnitude(disp);
+	float earliest = min_time;
+
+	int num_hits = 0;
+	int k = 0;
+
+#ifdef GEOMATH_AVX2
+	if (simd_enabled)
+	{
+		num_hits = IntersectBallWallAVX2(center, radius, dir, speed, walls, num, t_max,
+										 hits, times, min_time);
+		k = num - (num % SIMD_WIDTH);
+	}
+#endif
+
+	for (; k < num; k++)
+	{
+		float x = center.x * walls.to_x[0][k] + center.y * walls.to_x[1][k] +
+				  center.z * walls.to_x[2][k] + walls.to_x[3][k];
+		float y = center.x * walls.to_y[0][k] + center.y * walls.to_y[1][k] +
+				  center.z * walls.to_y[2][k] + walls.to_y[3][k];
+
+		if (!(x >= walls.min_x[k] && x <= walls.max_x[k] &&
+			  y >= walls.min_y[k] && y <= walls.max_y[k]))
+			continue;
+
+		float denominator = dir.x * walls.nx[k] + dir.y * walls.ny[k] + dir.z * walls.nz[k];
+		if (denominator >= 0.0f)
+			continue;
+
+		float c_n = center.x * walls.nx[k] + center.y * walls.ny[k] + center.z * walls.nz[k];
+		float t = (walls.distance[k] - c_n + radius) / denominator;
+
+		// A ball that has sunk into the plane but still has its centre in front of
+		// it hits it straight away
+		if (t < 0.0f && c_n >= walls.distance[k])
+			t = 0.0f;
+
+		KeepHit(t / speed, k, t_max, hits, times, num_hits, min_time);
+	}
+
+	// Find the wall of the earliest hit, if it lowered min_time
+	min_wall = -1;
+	for (int j = 0; j < num_hits && min_time < earliest; j++)
+	{
+		if (times[j] == min_time)
+		{
+			min_wall = hits[j];
+			break;
+		}
+	}
+
+	return num_hits;
+}
+
+/*-----------------------------------------------------------------------------------
+Time a point moving by velocity enters the sphere of radius r around each of a
+block of num vertices, see EnterSphere.  The time of each is written to times,
+-1 when it is not entered within t_left.
+-----------------------------------------------------------------------------------*/
+
+void geomath::EnterSphereBatch(	const TVector& point, const TVector& velocity, const float *x,
+								const float *y, const float *z, float r, int num, float t_left,
+								float *times)
+{
+	int k = 0;
+
+#ifdef GEOMATH_AVX2
+	if (simd_enabled)
+	{
+		EnterSphereAVX2(point, velocity, x, y, z, r, num, t_left, times);
+		k = num - (num % SIMD_WIDTH);
+	}
+#endif
+
+	for (; k < num; k++)
+		times[k] = EnterSphere(point, velocity, TVector(x[k], y[k], z[k]), r, t_left);
+}
+
+/*-----------------------------------------------------------------------------------
+Time a point moving by velocity enters the cylinder of radius r around each of a
+block of num edges between its end points, see EnterEdgeCylinder.  The edges run
+from (x1, y1, z1) to (x2, y2, z2), the time of each is written to times, -1 when
+it is not entered within t_left.
+-----------------------------------------------------------------------------------*/
+
+void geomath::EnterEdgeCylinderBatch(	const TVector& point, const TVector& velocity,
+										const float *x1, const float *y1, const float *z1,
+										const float *x2, const float *y2, const float *z2,
+										float r, int num, float t_left, float *times)
+{
+	int k = 0;
+
+#ifdef GEOMATH_AVX2
+	if (simd_enabled)
+	{
+		EnterEdgeCylinderAVX2(	point, velocity, x1, y1, z1, x2, y2, z2, r, num, t_left,
+								times);
+		k = num - (num % SIMD_WIDTH);
+	}
+#endif
+
+	for (; k < num; k++)
+	{
+		times[k] = EnterEdgeCylinder(	point, velocity, TVector(x1[k], y1[k], z1[k]),
+										TVector(x2[k], y2[k], z2[k]), r, t_left);
+	}
+}
@@ -0,0 +1,430 @@
+/*-----------------------------------------------------------------------------------
+File:			headless.cpp
+Authors:		Steve Costa
+Description:	Run the simulation without a window.  A map is loaded, stepped
+				for a number of frames at a fixed time step and the speed of
+				the steps is reported along with the time taken by each phase.
+
+Usage:			headless <map file> [options]
+
+				-frames n		Frames to step (default HEADLESS_FRAMES)
+				-dt s			Seconds per frame (default HEADLESS_DT)
+				-broadphase n	One of the BROADPHASE_ modes
+				-events			Use the event driven scheduler
+				-cache			Skip pairs that stay apart with the pair cache
+				-nosleep		Do not put objects to sleep
+				-budget us		Microseconds allowed for the tests of a frame
+				-csv			Print the results as a CSV header and row, for
+								scaling curves over maps of different sizes
+				-stats file		Write the counters and timings of every frame
+				-json			Write the stats as JSON lines instead of CSV
+				-trace file		Write a timeline of the phases of each frame, for
+								chrome://tracing or ui.perfetto.dev
+				-perf			Read the hardware counters (Linux perf_event_open)
+								around each phase and geomath call
+				-check			Fail if a ball or box drops below the lowest wall of
+								the map, that is through the floor
+-----------------------------------------------------------------------------------*/
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+using namespace std;
+
+#include "scene.h"
+#include "collisions.h"
+#include "statsLog.h"
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define HEADLESS_FRAMES		1000		// Frames stepped by default
+#define HEADLESS_DT			0.02f		// Seconds per frame, as the game's FRAME_INTERVAL
+
+/*-----------------------------------------------------------------------------------
+Time taken by one phase of the steps
+-----------------------------------------------------------------------------------*/
+
+struct TPhaseTime
+{
+	const char *name;
+	double total_us;			// Summed over every frame
+	double max_us;				// Slowest frame
+
+	void Add(double us)
+	{
+		total_us += us;
+		if (us > max_us)
+			max_us = us;
+	}
+};
+
+typedef chrono::steady_clock TClock;
+
+static double MicrosecondsSince(const TClock::time_point& start)
+{
+	return chrono::duration<double, micro>(TClock::now() - start).count();
+}
+
+/*-----------------------------------------------------------------------------------
+Apply gravity to the objects that are awake, as the game does before each step.
+-----------------------------------------------------------------------------------*/
+
+static void ApplyGravity(CScene& scene, const CCollisions& collide)
+{
+	TRACE_SCOPE("ApplyGravity");
+
+	for (int i = 0; i < scene.num_balls; i++)
+	{
+		if (!collide.IsBallAsleep(i))
+			scene.sim.AccelerateBall(i);
+	}
+
+	for (int i = 0; i < scene.num_boxes; i++)
+	{
+		if (!collide.IsBoxAsleep(i))
+			scene.sim.AccelerateBox(i);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Height of the lowest corner of any wall, the floor of the map
+-----------------------------------------------------------------------------------*/
+
+static float LowestWall(const CScene& scene)
+{
+	float lowest = FLT_MAX;
+
+	for (int w = 0; w < scene.num_walls; w++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			TVector corner = scene.p_walls[w].GetVertex(j) * scene.p_walls[w].trans;
+			lowest = MIN(lowest, corner.y);
+		}
+	}
+
+	return lowest;
+}
+
+/*-----------------------------------------------------------------------------------
+Find a ball whose centre or a box whose top has dropped below the floor, which
+the walls should never let happen.  Returns false and prints the object if one
+has.
+-----------------------------------------------------------------------------------*/
+
+static bool CheckAboveFloor(const CScene& scene, float floor, int frame)
+{
+	for (int i = 0; i < scene.num_balls; i++)
+	{
+		if (scene.sim.GetBallCenter(i).y < floor)
+		{
+			fprintf(stderr, "Ball %d is below the floor at frame %d (y %.3f)\n", i, frame,
+					scene.sim.GetBallCenter(i).y);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < scene.num_boxes; i++)
+	{
+		if (scene.sim.GetBoxMax(i).y < floor)
+		{
+			fprintf(stderr, "Box %d is below the floor at frame %d (y %.3f)\n", i, frame,
+					scene.sim.GetBoxMax(i).y);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Print a row of the hardware counter table: the counts summed over every call and
+the instructions per cycle.  Counters that could not be opened are shown as n/a.
+-----------------------------------------------------------------------------------*/
+
+static void PrintPerfRow(const char *name, const TPerfCount& count, const CPerfCounters& perf)
+{
+	printf("%-24s %10lld", name, count.calls);
+
+	for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+	{
+		if (perf.IsCounting(k))
+			printf(" %14llu", count.value[k]);
+		else
+			printf(" %14s", "n/a");
+	}
+
+	if (perf.IsCounting(PERF_CYCLES) && perf.IsCounting(PERF_INSTRUCTIONS) &&
+		count.value[PERF_CYCLES] > 0)
+	{
+		printf(" %6.2f\n", (double)count.value[PERF_INSTRUCTIONS] / count.value[PERF_CYCLES]);
+	}
+	else
+		printf(" %6s\n", "n/a");
+}
+
+/*-----------------------------------------------------------------------------------
+Print how the options are used
+-----------------------------------------------------------------------------------*/
+
+static void PrintUsage()
+{
+	fprintf(stderr,	"usage: headless <map file> [-frames n] [-dt s] [-broadphase n] "
+					"[-events] [-cache] [-nosleep] [-budget us] [-csv]\n"
+					"       [-stats file] [-json] [-trace file] [-perf] [-check]\n");
+}
+
+/*-----------------------------------------------------------------------------------
+Load the map, step it and report the timings
+-----------------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const char *map_name = argv[1];
+	int frames = HEADLESS_FRAMES;
+	float dt = HEADLESS_DT;
+	int broadphase = -1;
+	bool events = false, cache = false, sleeping = true, csv = false, use_perf = false;
+	bool check = false;
+	int budget_us = 0;
+	const char *stats_name = NULL;
+	const char *trace_name = NULL;
+	int stats_format = STATS_CSV;
+
+	for (int k = 2; k < argc; k++)
+	{
+		bool has_value = (k + 1 < argc);
+
+		if (strcmp(argv[k], "-frames") == 0 && has_value)
+			frames = atoi(argv[++k]);
+		else if (strcmp(argv[k], "-dt") == 0 && has_value)
+			dt = (float)atof(argv[++k]);
+		else if (strcmp(argv[k], "-broadphase") == 0 && has_value)
+			broadphase = atoi(argv[++k]);
+		else if (strcmp(argv[k], "-budget") == 0 && has_value)
+			budget_us = atoi(argv[++k]);
+		else if (strcmp(argv[k], "-stats") == 0 && has_value)
+			stats_name = argv[++k];
+		else if (strcmp(argv[k], "-trace") == 0 && has_value)
+			trace_name = argv[++k];
+		else if (strcmp(argv[k], "-json") == 0)
+			stats_format = STATS_JSON;
+		else if (strcmp(argv[k], "-events") == 0)
+			events = true;
+		else if (strcmp(argv[k], "-cache") == 0)
+			cache = true;
+		else if (strcmp(argv[k], "-nosleep") == 0)
+			sleeping = false;
+		else if (strcmp(argv[k], "-csv") == 0)
+			csv = true;
+		else if (strcmp(argv[k], "-perf") == 0)
+			use_perf = true;
+		else if (strcmp(argv[k], "-check") == 0)
+			check = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (frames <= 0 || dt <= 0.0f || budget_us < 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Load the map
+	CScene scene;
+	TClock::time_point start = TClock::now();
+
+	int result = scene.Load(map_name);
+	if (result < 0)
+	{
+		fprintf(stderr, "Failed to load %s (error %d)\n", map_name, result);
+		return 1;
+	}
+
+	double load_us = MicrosecondsSince(start);
+
+	CCollisions *p_collide = new CCollisions(scene);
+
+	if (broadphase >= 0)
+		p_collide->SetBroadphase(broadphase);
+
+	p_collide->SetEventDriven(events);
+	p_collide->SetPairCache(cache);
+	p_collide->SetSleeping(sleeping);
+
+	CStatsLog stats_log;
+	if (stats_name != NULL && !stats_log.Open(stats_name, stats_format))
+	{
+		fprintf(stderr, "Failed to open %s\n", stats_name);
+		delete p_collide;
+		scene.ShutDown();
+		return 1;
+	}
+
+	// The counters only count this thread, which runs every test
+	CPerfCounters perf;
+	if (use_perf)
+	{
+		if (!perf.Open())
+		{
+			fprintf(stderr, "Failed to open the hardware counters (%s)\n", strerror(perf.GetError()));
+			delete p_collide;
+			scene.ShutDown();
+			return 1;
+		}
+
+		p_collide->SetPerfCounters(&perf);
+	}
+
+	TPerfCount perf_gravity, perf_collisions;
+	perf_gravity.Clear();
+	perf_collisions.Clear();
+	CPerfCounters *p_perf = use_perf ? &perf : NULL;
+
+	if (trace_name != NULL)
+		CTrace::Start();
+
+	// Step the frames
+	TPhaseTime gravity = { "gravity", 0.0, 0.0 };
+	TPhaseTime collisions = { "collisions", 0.0, 0.0 };
+	long long iterations = 0;
+	int num_corrected = 0;
+	float floor = LowestWall(scene);
+	bool passed = true;
+
+	TClock::time_point run_start = TClock::now();
+
+	for (int f = 0; f < frames; f++)
+	{
+		TRACE_SCOPE("Frame");
+
+		start = TClock::now();
+		{
+			CPerfScope perf_scope(p_perf, perf_gravity);
+			ApplyGravity(scene, *p_collide);
+		}
+		gravity.Add(MicrosecondsSince(start));
+
+		start = TClock::now();
+		{
+			CPerfScope perf_scope(p_perf, perf_collisions);
+			p_collide->Test(dt, budget_us);
+		}
+		collisions.Add(MicrosecondsSince(start));
+
+		stats_log.Write(p_collide->GetFrameStats());
+
+		iterations += p_collide->GetFrameStats().iterations;
+		if (p_collide->GetFrameStats().corrections > 0)
+			num_corrected++;
+
+		if (check && !CheckAboveFloor(scene, floor, f))
+		{
+			passed = false;
+			break;
+		}
+	}
+
+	double run_us = MicrosecondsSince(run_start);
+
+	if (trace_name != NULL)
+	{
+		CTrace::Stop();
+		if (!CTrace::Write(trace_name))
+			fprintf(stderr, "Failed to write %s\n", trace_name);
+	}
+
+	if (!passed)
+	{
+		delete p_collide;
+		scene.ShutDown();
+		return 1;
+	}
+
+	// Report
+	if (csv)
+	{
+		printf("map,objects,frames,steps_per_sec,collisions_mean_us,collisions_max_us,"
+				"iterations_per_frame\n");
+		printf("%s,%d,%d,%.1f,%.3f,%.3f,%.2f\n", map_name,
+				scene.num_balls + scene.num_boxes + scene.num_meshes, frames,
+				frames / (run_us * 1e-6), collisions.total_us / frames, collisions.max_us,
+				(double)iterations / frames);
+
+		delete p_collide;
+		scene.ShutDown();
+
+		return 0;
+	}
+
+	printf("map          %s\n", map_name);
+	printf("objects      %d walls, %d balls, %d boxes, %d meshes\n",
+			scene.num_walls, scene.num_balls, scene.num_boxes, scene.num_meshes);
+	printf("frames       %d at dt %g s\n", frames, dt);
+	printf("load         %.3f ms\n", load_us * 0.001);
+	printf("run          %.3f ms, %.1f steps/sec\n", run_us * 0.001, frames / (run_us * 1e-6));
+
+	printf("\n%-12s %12s %12s %12s\n", "phase", "total ms", "mean us", "max us");
+
+	TPhaseTime *phases[] = { &gravity, &collisions };
+	for (int k = 0; k < 2; k++)
+	{
+		printf("%-12s %12.3f %12.3f %12.3f\n", phases[k]->name, phases[k]->total_us * 0.001,
+				phases[k]->total_us / frames, phases[k]->max_us);
+	}
+
+	printf("\niterations   %.2f per frame\n", (double)iterations / frames);
+	printf("over budget  %d frames, %d with overlaps corrected\n",
+			p_collide->GetNumOverBudget(), num_corrected);
+
+	// Counters of each phase and of each kind of geomath call, summed over the run
+	if (use_perf)
+	{
+		printf("\n%-24s %10s", "counters", "calls");
+		for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+			printf(" %14s", CPerfCounters::Name(k));
+		printf(" %6s\n", "IPC");
+
+		PrintPerfRow("gravity", perf_gravity, perf);
+		PrintPerfRow("collisions", perf_collisions, perf);
+
+		char name[64];
+		for (int k = 0; k < NUM_PHASES; k++)
+		{
+			if (p_collide->GetPhaseCount(k).calls == 0)
+				continue;
+
+			sprintf(name, "  %s", CStatsLog::PhaseName(k));
+			PrintPerfRow(name, p_collide->GetPhaseCount(k), perf);
+		}
+
+		for (int k = 0; k < NUM_GEOMATH_KINDS; k++)
+		{
+			if (p_collide->GetGeomathCount(k).calls == 0)
+				continue;
+
+			sprintf(name, "geomath %s", CStatsLog::GeomathName(k));
+			PrintPerfRow(name, p_collide->GetGeomathCount(k), perf);
+		}
+	}
+
+	delete p_collide;
+	scene.ShutDown();
+
+	return 0;
+}
@@ -8,6 +8,8 @@ Description:	This is a generic windows shell allowing for OpenGL programming
 #include "main.h"							// Header file for this class
 #include "game.h"							// Game header file
 
+#include <cstring>
+
 /*-----------------------------------------------------------------------------------
 Declare static variables of the CWindow class.
 -----------------------------------------------------------------------------------*/
@@ -211,6 +213,17 @@ int main(int argc, char* argv[])
 	CGame		*p_game;					// Game object pointer
 	HINSTANCE hinstance = GetModuleHandle(NULL);
 
+	// Record a timeline of the loading and the frames with -trace <file>
+	const char *trace_name = NULL;
+	for (int k = 1; k + 1 < argc; k++)
+	{
+		if (strcmp(argv[k], "-trace") == 0)
+			trace_name = argv[k + 1];
+	}
+
+	if (trace_name != NULL)
+		CTrace::Start();
+
 	p_window = new CWin();					// Allocate memory for new window
 	p_window->Init(WindowProc, hinstance);	// Initialise window
 
@@ -238,5 +251,11 @@ int main(int argc, char* argv[])
 	delete(p_game);
 	p_game = NULL;
 
+	if (trace_name != NULL)
+	{
+		CTrace::Stop();
+		CTrace::Write(trace_name);
+	}
+
 	return 0;
 }
\ No newline at end of file
@@ -149,6 +149,24 @@ public:
 		TVector translation(m[12], m[13], m[14]);
 		return translation;
 	}
+
+	// Return the inverse of a matrix made up of only a rotation and a translation.
+	// The rotation is transposed and the translation rotated back and negated.
+	TMatrix GetRigidInverse() const
+	{
+		TMatrix inv;
+
+		inv.m[0] = m[0];	inv.m[1] = m[4];	inv.m[2] = m[8];	inv.m[3] = 0.0f;
+		inv.m[4] = m[1];	inv.m[5] = m[5];	inv.m[6] = m[9];	inv.m[7] = 0.0f;
+		inv.m[8] = m[2];	inv.m[9] = m[6];	inv.m[10] = m[10];	inv.m[11] = 0.0f;
+
+		inv.m[12] = -(m[12] * m[0] + m[13] * m[1] + m[14] * m[2]);
+		inv.m[13] = -(m[12] * m[4] + m[13] * m[5] + m[14] * m[6]);
+		inv.m[14] = -(m[12] * m[8] + m[13] * m[9] + m[14] * m[10]);
+		inv.m[15] = 1.0f;
+
+		return inv;
+	}
 	
 };
 
@@ -0,0 +1,167 @@
+/*-----------------------------------------------------------------------------------
+File:			pairCache.cpp
+Authors:		Steve Costa
+Description:	Cache of the results of the narrow phase for pairs of objects,
+				kept from one test (and one frame) to the next.
+-----------------------------------------------------------------------------------*/
+
+#include "pairCache.h"
+
+#include <assert.h>
+#include <cstddef>
+
+/*-----------------------------------------------------------------------------------
+Initialise an empty cache
+-----------------------------------------------------------------------------------*/
+
+CPairCache::CPairCache()
+{
+	frame = 0;
+	Clear();
+}
+
+/*-----------------------------------------------------------------------------------
+Remove every entry and shrink the table back to its smallest size
+-----------------------------------------------------------------------------------*/
+
+void CPairCache::Clear()
+{
+	TEntry empty;
+	empty.key = 0;
+
+	table.assign(PAIR_CACHE_MIN_SIZE, empty);
+	table_mask = PAIR_CACHE_MIN_SIZE - 1;
+	num_entries = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Move on to the next frame.  Every PAIR_CACHE_MAX_AGE frames the entries which
+were not used in that time are dropped, so pairs that have moved apart in the
+broadphase do not keep the table growing.
+-----------------------------------------------------------------------------------*/
+
+void CPairCache::NextFrame()
+{
+	frame++;
+
+	if (frame % PAIR_CACHE_MAX_AGE == 0)
+		Rebuild();
+}
+
+/*-----------------------------------------------------------------------------------
+Pack the collision type and the object ids into the key of a pair.  The type is
+never 0 so the key of a pair is never that of an empty slot.
+-----------------------------------------------------------------------------------*/
+
+unsigned long long CPairCache::Key(int type, int id1, int id2)
+{
+	assert(type > 0 && type < 256);
+	assert(id1 >= 0 && id1 < (1 << 28) && id2 >= 0 && id2 < (1 << 28));
+
+	return	((unsigned long long)type << 56) | ((unsigned long long)id1 << 28) |
+			(unsigned long long)id2;
+}
+
+/*-----------------------------------------------------------------------------------
+Hash a key into the table (Fibonacci hashing)
+-----------------------------------------------------------------------------------*/
+
+unsigned int CPairCache::Hash(unsigned long long key) const
+{
+	return (unsigned int)((key * 11400714819323198485ull) >> 32) & table_mask;
+}
+
+/*-----------------------------------------------------------------------------------
+Look up the entry of a pair
+-----------------------------------------------------------------------------------*/
+
+CPairCache::TEntry* CPairCache::Find(int type, int id1, int id2)
+{
+	unsigned long long key = Key(type, id1, id2);
+
+	for (unsigned int slot = Hash(key); table[slot].key != 0; slot = (slot + 1) & table_mask)
+	{
+		if (table[slot].key == key)
+		{
+			table[slot].frame = frame;
+			return &table[slot];
+		}
+	}
+
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+Look up the entry of a pair, adding an entry which has not been tested (no gap
+and no collision) if it is not there.  The table is kept at most half full so
+the probe sequences stay short.  Entries returned earlier may move when the
+table is rebuilt.
+-----------------------------------------------------------------------------------*/
+
+CPairCache::TEntry* CPairCache::Insert(int type, int id1, int id2)
+{
+	TEntry *p_entry = Find(type, id1, id2);
+	if (p_entry != NULL)
+		return p_entry;
+
+	if (2 * (num_entries + 1) > (int)table.size())
+		Rebuild();
+
+	unsigned long long key = Key(type, id1, id2);
+	unsigned int slot = Hash(key);
+
+	while (table[slot].key != 0)
+		slot = (slot + 1) & table_mask;
+
+	p_entry = &table[slot];
+	p_entry->key = key;
+	p_entry->gap = 0.0f;
+	p_entry->travel1 = 0.0;
+	p_entry->travel2 = 0.0;
+	p_entry->frame = frame;
+	num_entries++;
+
+	return p_entry;
+}
+
+/*-----------------------------------------------------------------------------------
+Rehash the entries used in the last PAIR_CACHE_MAX_AGE frames into a table with
+at least four slots for each of them, which leaves room to grow before the next
+rebuild is needed.
+-----------------------------------------------------------------------------------*/
+
+void CPairCache::Rebuild()
+{
+	vector<TEntry> old_table;
+	old_table.swap(table);
+
+	int num_live = 0;
+	for (unsigned int k = 0; k < old_table.size(); k++)
+	{
+		if (old_table[k].key != 0 && frame - old_table[k].frame <= PAIR_CACHE_MAX_AGE)
+			num_live++;
+	}
+
+	unsigned int size = PAIR_CACHE_MIN_SIZE;
+	while (size < 4 * (unsigned int)num_live)
+		size *= 2;
+
+	TEntry empty;
+	empty.key = 0;
+
+	table.assign(size, empty);
+	table_mask = size - 1;
+	num_entries = num_live;
+
+	for (unsigned int k = 0; k < old_table.size(); k++)
+	{
+		if (old_table[k].key == 0 || frame - old_table[k].frame > PAIR_CACHE_MAX_AGE)
+			continue;
+
+		unsigned int slot = Hash(old_table[k].key);
+		while (table[slot].key != 0)
+			slot = (slot + 1) & table_mask;
+
+		table[slot] = old_table[k];
+	}
+}
@@ -0,0 +1,80 @@
+/*-----------------------------------------------------------------------------------
+File:			pairCache.h
+Authors:		Steve Costa
+Description:	Header file defining the pair cache, which remembers what the
+				narrow phase found for a pair of objects so that pairs which
+				stay apart can be skipped on the following tests.
+-----------------------------------------------------------------------------------*/
+
+#ifndef PAIR_CACHE_H
+#define PAIR_CACHE_H
+
+#include <vector>
+using namespace std;
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define PAIR_CACHE_MIN_SIZE		1024		// Smallest table size (a power of 2)
+#define PAIR_CACHE_MAX_AGE		8			// Frames an unused entry is kept for
+
+/*-----------------------------------------------------------------------------------
+Hash table of the pairs tested recently, keyed by the collision type and the ids
+of the two objects.  Each entry holds the separation of the pair when it was last
+tested along with the distance each object had travelled at the time, so the
+separation left can be bounded later on from how far the objects have moved
+since without looking at the objects again.
+
+The table uses open addressing with linear probing.  Entries are never removed
+one at a time, the table is rebuilt without the entries that have not been used
+for PAIR_CACHE_MAX_AGE frames instead.
+-----------------------------------------------------------------------------------*/
+
+class CPairCache
+{
+	// ATTRIBUTES
+public:
+
+	struct TEntry
+	{
+		unsigned long long key;		// 0 for an empty slot
+		float gap;					// Lower bound on the separation when tested
+		double travel1;				// Distance travelled by each object by then
+		double travel2;
+		int frame;					// Frame the entry was last used in
+	};
+
+private:
+
+	vector<TEntry> table;			// Size is a power of 2
+	unsigned int table_mask;
+	int num_entries;				// Slots in use
+	int frame;						// Current frame
+
+	// METHODS
+public:
+
+	CPairCache();
+
+	void Clear();					// Forget every pair
+	void NextFrame();				// Age the entries, dropping those unused
+
+	// Entry of a pair, or NULL if the pair is not in the cache
+	TEntry* Find(int type, int id1, int id2);
+
+	// Entry of a pair, added if the pair is not in the cache yet
+	TEntry* Insert(int type, int id1, int id2);
+
+	int Size() const { return num_entries; }
+
+	// Key of a pair, never 0
+	static unsigned long long Key(int type, int id1, int id2);
+
+private:
+
+	unsigned int Hash(unsigned long long key) const;
+	void Rebuild();					// Move the entries still in use to a new table
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*-----------------------------------------------------------------------------------
+File:			perfCounters.cpp
+Authors:		Steve Costa
+Description:	Hardware performance counters of the calling thread, opened with
+				perf_event_open on Linux.
+-----------------------------------------------------------------------------------*/
+
+#include "perfCounters.h"
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*-----------------------------------------------------------------------------------
+Names of the counters, in the order of their constants
+-----------------------------------------------------------------------------------*/
+
+static const char *counter_names[NUM_PERF_COUNTERS] =
+{
+	"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"
+};
+
+/*-----------------------------------------------------------------------------------
+Zero the counts
+-----------------------------------------------------------------------------------*/
+
+void TPerfCount::Clear()
+{
+	for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+		value[k] = 0;
+	calls = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Initialise with no counters open
+-----------------------------------------------------------------------------------*/
+
+CPerfCounters::CPerfCounters()
+{
+	for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+	{
+		fds[k] = -1;
+		p_pages[k] = NULL;
+	}
+
+	num_open = 0;
+	error = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Close the counters
+-----------------------------------------------------------------------------------*/
+
+CPerfCounters::~CPerfCounters()
+{
+	Close();
+}
+
+/*-----------------------------------------------------------------------------------
+Name of a counter
+-----------------------------------------------------------------------------------*/
+
+const char* CPerfCounters::Name(int counter)
+{
+	return counter_names[counter];
+}
+
+#ifdef __linux__
+
+/*-----------------------------------------------------------------------------------
+Open each counter for the calling thread on any CPU, counting in user space only
+so no more than the default perf_event_paranoid setting is needed.  The first
+page of each counter is mapped so it can be read with rdpmc.
+-----------------------------------------------------------------------------------*/
+
+bool CPerfCounters::Open()
+{
+	Close();
+
+	static const unsigned int types[NUM_PERF_COUNTERS] =
+	{
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE,
+		PERF_TYPE_HARDWARE
+	};
+
+	static const unsigned long long configs[NUM_PERF_COUNTERS] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[k];
+		attr.config = configs[k];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		fds[k] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if (fds[k] < 0)
+		{
+			if (error == 0)
+				error = errno;
+			continue;
+		}
+
+		num_open++;
+
+		void *p_page = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fds[k], 0);
+		p_pages[k] = (p_page == MAP_FAILED) ? NULL : p_page;
+	}
+
+	return num_open > 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Close the counters that are open
+-----------------------------------------------------------------------------------*/
+
+void CPerfCounters::Close()
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+	{
+		if (p_pages[k] != NULL)
+			munmap(p_pages[k], page_size);
+		if (fds[k] >= 0)
+			close(fds[k]);
+
+		fds[k] = -1;
+		p_pages[k] = NULL;
+	}
+
+	num_open = 0;
+	error = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Read a counter.  The page of the counter gives the hardware counter it is on and
+the count to add to it, and is updated by the kernel under a sequence lock when
+the thread is switched in or out, so it is read again if the lock moved.  The
+hardware counter is pmc_width bits wide and sign extended.  When rdpmc can not
+be used the count is read from the file.
+-----------------------------------------------------------------------------------*/
+
+unsigned long long CPerfCounters::ReadCounter(int counter)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	volatile struct perf_event_mmap_page *p_page =
+		(volatile struct perf_event_mmap_page*)p_pages[counter];
+
+	if (p_page != NULL && p_page->cap_user_rdpmc)
+	{
+		unsigned int seq, index;
+		long long count;
+
+		do
+		{
+			seq = p_page->lock;
+			__asm__ __volatile__("" ::: "memory");
+
+			index = p_page->index;
+			count = p_page->offset;
+
+			if (index != 0)
+			{
+				unsigned int low, high;
+				__asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high) : "c" (index - 1));
+
+				unsigned int shift = 64 - p_page->pmc_width;
+				long long pmc = (long long)(((unsigned long long)high << 32) | low);
+				count += (long long)((unsigned long long)pmc << shift) >> shift;
+			}
+
+			__asm__ __volatile__("" ::: "memory");
+		} while (p_page->lock != seq);
+
+		if (index != 0)
+			return (unsigned long long)count;
+	}
+#endif
+
+	unsigned long long value = 0;
+	if (read(fds[counter], &value, sizeof(value)) != (ssize_t)sizeof(value))
+		return 0;
+
+	return value;
+}
+
+#else
+
+/*-----------------------------------------------------------------------------------
+Without perf_event_open there are no counters to open
+-----------------------------------------------------------------------------------*/
+
+bool CPerfCounters::Open()
+{
+	error = ENOSYS;
+	return false;
+}
+
+void CPerfCounters::Close()
+{
+}
+
+unsigned long long CPerfCounters::ReadCounter(int counter)
+{
+	return 0;
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------------
+Read every counter, those that are not open read as 0
+-----------------------------------------------------------------------------------*/
+
+void CPerfCounters::Read(unsigned long long *values)
+{
+	for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+		values[k] = (fds[k] >= 0) ? ReadCounter(k) : 0;
+}
@@ -0,0 +1,117 @@
+/*-----------------------------------------------------------------------------------
+File:			perfCounters.h
+Authors:		Steve Costa
+Description:	Header file defining the hardware performance counters, read
+				around the phases of the collision tests and the geomath
+				kernels to see the cache and branch misses of each loop.
+-----------------------------------------------------------------------------------*/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstddef>
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define PERF_CYCLES				0
+#define PERF_INSTRUCTIONS		1
+#define PERF_L1D_MISSES			2			// Level 1 data cache read misses
+#define PERF_LLC_MISSES			3			// Last level cache misses
+#define PERF_BRANCH_MISSES		4			// Mispredicted branches
+#define NUM_PERF_COUNTERS		5
+
+/*-----------------------------------------------------------------------------------
+Counts added up over every scope of a phase or kernel
+-----------------------------------------------------------------------------------*/
+
+struct TPerfCount
+{
+	unsigned long long value[NUM_PERF_COUNTERS];
+	long long calls;					// Scopes counted
+
+	void Clear();
+};
+
+/*-----------------------------------------------------------------------------------
+The counters of the calling thread, in user space only, opened with Linux's
+perf_event_open.  Each counter is opened on its own so a CPU that lacks one of
+them still gives the others.  Where the kernel allows it the counters are read
+with rdpmc from the page the kernel maps for each of them, which costs tens of
+cycles, so they can be read around a single kernel call.  Otherwise each is
+read with a system call.
+
+Elsewhere than Linux no counter can be opened.
+-----------------------------------------------------------------------------------*/
+
+class CPerfCounters
+{
+	// ATTRIBUTES
+private:
+
+	int fds[NUM_PERF_COUNTERS];			// -1 for a counter that is not open
+	void *p_pages[NUM_PERF_COUNTERS];	// Page mapped for each counter, NULL for none
+	int num_open;
+	int error;							// errno of the first counter that failed
+
+	// METHODS
+public:
+
+	CPerfCounters();
+	~CPerfCounters();
+
+	bool Open();						// False if none of the counters could be opened
+	void Close();
+
+	bool IsOpen() const { return num_open > 0; }
+	bool IsCounting(int counter) const { return fds[counter] >= 0; }
+	int GetError() const { return error; }
+
+	void Read(unsigned long long *values);	// Value of each counter, 0 for those not open
+
+	static const char* Name(int counter);
+
+private:
+
+	unsigned long long ReadCounter(int counter);
+};
+
+/*-----------------------------------------------------------------------------------
+Adds the counts from its creation to the end of its scope to a total, nothing is
+read when there are no counters
+-----------------------------------------------------------------------------------*/
+
+class CPerfScope
+{
+	// ATTRIBUTES
+private:
+
+	CPerfCounters *p_perf;
+	TPerfCount& total;
+	unsigned long long start[NUM_PERF_COUNTERS];
+
+	// METHODS
+public:
+
+	CPerfScope(CPerfCounters *p_perf, TPerfCount& total) : p_perf(p_perf), total(total)
+	{
+		if (p_perf != NULL)
+			p_perf->Read(start);
+	}
+
+	~CPerfScope()
+	{
+		if (p_perf == NULL)
+			return;
+
+		unsigned long long end[NUM_PERF_COUNTERS];
+		p_perf->Read(end);
+
+		for (int k = 0; k < NUM_PERF_COUNTERS; k++)
+			total.value[k] += end[k] - start[k];
+		total.calls++;
+	}
+};
+
+#endif
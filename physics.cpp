@@ -111,4 +111,40 @@ void physics::MObjMObjEffects2(	TVector& init_vel1, const TVector& center1,
 	TVector new_v2_t = (resp1_t + resp2_t - (resp2_t - resp1_t)) * 0.5f;
 	init_vel1 = new_v1_n + new_v1_t;
 	init_vel2 = new_v2_n + new_v2_t;		
-}
\ No newline at end of file
+}
+
+/*-----------------------------------------------------------------------------------
+Given two moving objects calculate the speed at which they close in on each other
+along the line joining their centres (negative if they are moving apart).
+-----------------------------------------------------------------------------------*/
+
+float physics::ApproachSpeed(	const TVector& vel1, const TVector& center1,
+								const TVector& vel2, const TVector& center2)
+{
+	TVector n_axis = center2 - center1;
+	n_axis.Normalize();
+
+	return (vel1 - vel2) * n_axis;
+}
+
+/*-----------------------------------------------------------------------------------
+Given two objects resting against each other we calculate the resultant velocity
+vectors.  The collision is perfectly inelastic along the axis of collision, both
+objects are left moving at their average speed along it so they stay in contact
+instead of bouncing apart.  The tangential motion is not changed.
+-----------------------------------------------------------------------------------*/
+
+void physics::MObjMObjRestingEffects(	TVector& init_vel1, const TVector& center1,
+										TVector& init_vel2, const TVector& center2)
+{
+	// Calculate axis of collision
+	TVector n_axis = center2 - center1;
+	n_axis.Normalize();
+
+	// Half the speed at which the objects approach each other is taken from
+	// each of them
+	float half = ((init_vel1 - init_vel2) * n_axis) * 0.5f;
+
+	init_vel1 -= half * n_axis;
+	init_vel2 += half * n_axis;
+}
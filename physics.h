@@ -26,6 +26,12 @@ namespace physics
 
 	void MObjMObjEffects2(	TVector& init_vel1, const TVector& center1,
 							TVector& init_vel2, const TVector& center2);
+
+	float ApproachSpeed(const TVector& vel1, const TVector& center1,
+						const TVector& vel2, const TVector& center2);
+
+	void MObjMObjRestingEffects(TVector& init_vel1, const TVector& center1,
+								TVector& init_vel2, const TVector& center2);
 }
 
 #endif
\ No newline at end of file
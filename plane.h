@@ -66,6 +66,13 @@ public:
 	TMatrix trans;			// Transformation matrix from local to global coords
 	int texture;			// ID specifying global texture to choose
 	int color;				// ID specifying global colour to choose
+
+	// World space frame of the wall, computed once the wall is positioned
+	TVector world_point;	// point1 in global coords
+	float distance;			// Distance from the plane to the origin along the normal
+	TMatrix inv_trans;		// Transformation matrix from global to local coords
+	float min_x, max_x;		// Extents of the wall in local coords
+	float min_y, max_y;
 		
 	// METHODS
 public:
@@ -97,6 +104,35 @@ public:
 		// Store colour and texture indices
 		texture = tex;
 		color = col;
+
+		UpdateFrame();
+	}
+
+	// Cache the world space frame of the wall so collision tests do not have
+	// to transform the wall on every test
+	void UpdateFrame()
+	{
+		normal.Normalize();
+
+		world_point = point1 * trans;
+		distance = world_point * normal;
+		inv_trans = trans.GetRigidInverse();
+
+		min_x = point1.x < point2.x ? point1.x : point2.x;
+		max_x = point1.x < point2.x ? point2.x : point1.x;
+		min_y = point1.y < point2.y ? point1.y : point2.y;
+		max_y = point1.y < point2.y ? point2.y : point1.y;
+	}
+
+	// Check if a point projected along the normal falls within the wall.  Only
+	// the x and y local coordinates of the point are needed for this.
+	bool IsPointOnWall(const TVector& point) const
+	{
+		const float *m = inv_trans.m;
+		float x = point.x * m[0] + point.y * m[4] + point.z * m[8] + m[12];
+		float y = point.x * m[1] + point.y * m[5] + point.z * m[9] + m[13];
+
+		return (x >= min_x && x <= max_x && y >= min_y && y <= max_y);
 	}
 
 	// Function which returns each of the vertex coordinates of the
@@ -0,0 +1,428 @@
+/*-----------------------------------------------------------------------------------
+File:			scene.cpp
+Authors:		Steve Costa
+Description:	Load the world description from a text file and dynamically
+				create all of the world objects.
+-----------------------------------------------------------------------------------*/
+
+#include "scene.h"
+
+/*-----------------------------------------------------------------------------------
+The map is read with the secure versions of the C library functions, which only
+the Microsoft library has.  Elsewhere the plain versions do the same job as no
+strings are read with sscanf.
+-----------------------------------------------------------------------------------*/
+
+#ifndef _MSC_VER
+
+#define sscanf_s	sscanf
+#define strtok_s	strtok_r
+
+static int fopen_s(FILE **p_file, const char *file_name, const char *mode)
+{
+	*p_file = fopen(file_name, mode);
+	return (*p_file == NULL) ? -1 : 0;
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------------
+Initialise an empty scene.
+-----------------------------------------------------------------------------------*/
+
+CScene::CScene()
+{
+	// Set pointers to null
+	p_balls = NULL;
+	p_walls = NULL;
+	p_boxes = NULL;
+	p_meshes = NULL;
+
+	num_walls = 0;
+	num_balls = 0;
+	num_boxes = 0;
+	num_meshes = 0;
+}
+
+/*-----------------------------------------------------------------------------------
+Read lines from a file ignoring empty lines and comments.  Returns false if the
+end of the file is reached first.
+-----------------------------------------------------------------------------------*/
+
+bool CScene::ReadString(char *string, FILE *file)
+{
+	do
+	{
+		if (fgets(string, 512, file) == NULL)
+		{
+			string[0] = '\0';
+			return false;
+		}
+	} while ((string[0] == '#') || (string[0] == '\n'));
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+This method will read a map configuration file and set the scene object attributes
+accordingly.
+
+Errors:		-3500 = Failed to open file
+			-3501 = Wrong file type
+			-3502 = Data read error
+			-3503 = Memory allocation error
+			-3504 = Mesh is not closed or not convex
+-----------------------------------------------------------------------------------*/
+
+int CScene::Load(const char *file_name)
+{
+	FILE *map_file;				// Input file stream variable
+	char line[512];				// Holds line of text
+	char *p_token;				// Point to first character of a token
+	char *p_next_token;
+	TVector temp[4];			// Temporary storage of geometric object vertices
+	float temp_rad;				// Temporary radius variable
+	int temp_rot;
+	float temp_theta;			// Temporary rotation flag and rotation amount
+	int temp_col, temp_tex;	// Temp color and texture indices
+	int temp_num[2];			// # of vertices and faces of a mesh
+	vector<int> temp_indices;	// Vertex indices of a mesh face
+
+	// Check to see if the dynamic arrays must free memory first
+	 if (p_balls != NULL)
+		delete [] p_balls;
+
+	if (p_walls != NULL)
+		delete [] p_walls;
+
+	if (p_boxes != NULL)
+		delete [] p_boxes;
+
+	if (p_meshes != NULL)
+		delete [] p_meshes;
+	
+	// Open the file
+	if (fopen_s(&map_file, file_name, "r") != 0 || map_file == NULL)
+		return (-3500);							// Failed to open file
+
+	// # OF WALLS
+	ReadString(line, map_file);					// Read line
+	if (sscanf_s(line, "numwalls = %d", &num_walls) == EOF)
+		return (-3502);							// Data read error
+	
+	// Knowing the number of walls we can allocate enough memory for
+	// storing them
+	try {
+		p_walls = new TWall[num_walls];
+	} catch (const bad_alloc&) {
+		return (-3503);							// Memory allocation error
+	}
+
+	// The following section should contain 2 lines for each of the
+	// wall variables for min, max, and rotation type with rotation angle
+	for (int t = 0; t < num_walls; t++)				// Each wall
+	{
+	
+		ReadString(line, map_file);			// Read next line
+		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+		for (int j = 0; j < 2; j++)				// Each vertex coordinate
+		{
+			// Store the x, y coordinates in two separate vectors
+			if (sscanf_s(p_token, " %f", &temp[j][0]) == EOF)
+				return (-3502);				// Data read error
+
+			// Get the next value
+			p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+			// Store the x, y coordinates in two separate vectors
+			if (sscanf_s(p_token, " %f", &temp[j][1]) == EOF)
+				return (-3502);				// Data read error
+
+			// Get the next value
+			p_token = strtok_s(NULL, " ,\t", &p_next_token);
+		} // End for
+
+		// Get the colour and texture indices
+		if (sscanf_s(p_token, " %d", &temp_col) == EOF)
+				return (-3502);				// Data read error
+
+		// Get the next value
+		p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+		if (sscanf_s(p_token, " %d", &temp_tex) == EOF)
+				return (-3502);				// Data read error
+
+		ReadString(line, map_file);			// Read next line
+		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+		// Read the translation vector
+		for (int j = 0; j < 3; j++)
+		{
+			// Store the x, y, z coordinates
+			if (sscanf_s(p_token, " %f", &temp[2][j]) == EOF)
+				return (-3502);				// Data read error
+
+			// Get the next value
+			p_token = strtok_s(NULL, " ,\t", &p_next_token);
+		}
+
+		// Store the rotation flag coordinates
+		if (sscanf_s(p_token, " %d", &temp_rot) == EOF)
+			return (-3502);				// Data read error
+
+		// Get the next value
+		p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+		// Store the rotation value
+		if (sscanf_s(p_token, " %f", &temp_theta) == EOF)
+			return (-3502);				// Data read error
+
+		// We can now initialize the wall
+		temp[0][2] = 0.0f;	temp[1][2] = 0.0f;	// coordinates can be referenced with . or []
+		p_walls[t] = TWall(	temp[0], temp[1], temp[2], temp_theta, 
+							temp_rot, temp_col, temp_tex);
+
+	} // End for
+
+
+	// # OF BALLS
+	ReadString(line, map_file);					// Read line
+	if (sscanf_s(line, "numballs = %d", &num_balls) == EOF)
+		return (-3502);							// Data read error
+	
+	// Knowing the number of walls we can allocate enough memory for
+	// storing them
+	try {
+		p_balls = new TBall[num_balls];
+		sim.InitBalls(num_balls);
+	} catch (const bad_alloc&) {
+		return (-3503);							// Memory allocation error
+	}
+	
+	// The following section should contain 1 line containing attributes for each ball
+	for (int t = 0; t < num_balls; t++)				// Each ball
+	{
+		ReadString(line, map_file);			// Read next line
+		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+		for (int i = 0; i < 7; i++)					// Each attributs
+		{
+			if (i < 3) {						// Read centre
+				if (sscanf_s(p_token, " %f", &temp[0][i]) == EOF)
+					return (-3502);				// Data read error
+			}
+			else if (i >= 3 && i < 4) {			// Read radius
+				if (sscanf_s(p_token, " %f", &temp_rad) == EOF)
+					return (-3502);				// Data read error
+			}
+			else {								// Read velocity
+				if (sscanf_s(p_token, " %f", &temp[1][i-4]) == EOF)
+					return (-3502);				// Data read error
+			}
+			
+			// Get the next value
+			p_token = strtok_s(NULL, " ,\t", &p_next_token);
+		}
+
+		// Get the colour and texture indices
+		if (sscanf_s(p_token, " %d", &temp_col) == EOF)
+				return (-3502);				// Data read error
+
+		// Get the next value
+		p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+		if (sscanf_s(p_token, " %d", &temp_tex) == EOF)
+				return (-3502);				// Data read error
+			
+		// Initialize the ball, falling under gravity
+		sim.SetBallCenter(t, temp[0]);
+		sim.SetBallRadius(t, temp_rad);
+		sim.SetBallVel(t, temp[1]);
+		sim.SetBallAccel(t, TVector(0.0f, -0.49f, 0.0f));
+		p_balls[t] = TBall(temp[1], temp_col, temp_tex);
+
+	} // End for
+
+
+	// # OF BOXES
+	ReadString(line, map_file);					// Read line
+	if (sscanf_s(line, "numboxes = %d", &num_boxes) == EOF)
+		return (-3502);							// Data read error
+	
+	// Knowing the number of walls we can allocate enough memory for
+	// storing them
+	try {
+		p_boxes = new TBox[num_boxes];
+		sim.InitBoxes(num_boxes);
+	} catch (const bad_alloc&) {
+		return (-3503);							// Memory allocation error
+	}
+	
+	// The following section should contain 1 line containing attributes for each box
+	for (int t = 0; t < num_boxes; t++)				// Each ball
+	{
+		ReadString(line, map_file);			// Read next line
+		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+		for (int i = 0; i < 9; i++)					// Each attribute
+		{
+			if (i < 3) {						// Read min
+				if (sscanf_s(p_token, " %f", &temp[0][i]) == EOF)
+					return (-3502);				// Data read error
+			}
+			else if (i >= 3 && i < 6) {			// Read max
+				if (sscanf_s(p_token, " %f", &temp[1][i-3]) == EOF)
+					return (-3502);				// Data read error
+			}
+			else {								// Read velocity
+				if (sscanf_s(p_token, " %f", &temp[2][i-6]) == EOF)
+					return (-3502);				// Data read error
+			}
+			
+			// Get the next value
+			p_token = strtok_s(NULL, " ,\t", &p_next_token);
+		}
+
+		// Get the colour and texture indices
+		if (sscanf_s(p_token, " %d", &temp_col) == EOF)
+				return (-3502);				// Data read error
+
+		// Get the next value
+		p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+		if (sscanf_s(p_token, " %d", &temp_tex) == EOF)
+				return (-3502);				// Data read error
+			
+		// Initialize the box, falling under gravity
+		sim.SetBoxMin(t, temp[0]);
+		sim.SetBoxMax(t, temp[1]);
+		sim.SetBoxVel(t, temp[2]);
+		sim.SetBoxAccel(t, TVector(0.0f, -0.49f, 0.0f));
+		p_boxes[t] = TBox(temp_col, temp_tex);
+				
+	} // End for
+
+
+	// # OF MESHES, maps made before meshes were added end after the boxes
+	num_meshes = 0;
+	if (ReadString(line, map_file))
+	{
+		if (sscanf_s(line, "nummeshes = %d", &num_meshes) == EOF)
+			return (-3502);							// Data read error
+	}
+
+	// Knowing the number of meshes we can allocate enough memory for
+	// storing them
+	try {
+		p_meshes = new TConvexMesh[num_meshes];
+	} catch (const bad_alloc&) {
+		return (-3503);							// Memory allocation error
+	}
+
+	// Each mesh has 1 line with the number of vertices, number of faces, colour
+	// and texture, followed by 1 line for each vertex and 1 line for each face
+	for (int t = 0; t < num_meshes; t++)			// Each mesh
+	{
+		ReadString(line, map_file);			// Read next line
+		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+		for (int i = 0; i < 2; i++)				// # of vertices and faces
+		{
+			if (sscanf_s(p_token, " %d", &temp_num[i]) == EOF)
+				return (-3502);				// Data read error
+
+			// Get the next value
+			p_token = strtok_s(NULL, " ,\t", &p_next_token);
+		}
+
+		// Get the colour and texture indices
+		if (sscanf_s(p_token, " %d", &p_meshes[t].color) == EOF)
+				return (-3502);				// Data read error
+
+		// Get the next value
+		p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+		if (sscanf_s(p_token, " %d", &p_meshes[t].texture) == EOF)
+				return (-3502);				// Data read error
+
+		for (int v = 0; v < temp_num[0]; v++)		// Each vertex
+		{
+			ReadString(line, map_file);			// Read next line
+			p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+			for (int j = 0; j < 3; j++)
+			{
+				// Store the x, y, z coordinates
+				if (sscanf_s(p_token, " %f", &temp[0][j]) == EOF)
+					return (-3502);				// Data read error
+
+				// Get the next value
+				p_token = strtok_s(NULL, " ,\t", &p_next_token);
+			}
+
+			p_meshes[t].vertices.push_back(temp[0]);
+		}
+
+		for (int f = 0; f < temp_num[1]; f++)		// Each face
+		{
+			int count;
+
+			ReadString(line, map_file);			// Read next line
+			p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
+
+			// The number of vertices followed by their indices
+			if (sscanf_s(p_token, " %d", &count) == EOF)
+				return (-3502);				// Data read error
+
+			temp_indices.resize(count > 0 ? count : 0);
+			for (int j = 0; j < count; j++)
+			{
+				// Get the next value
+				p_token = strtok_s(NULL, " ,\t", &p_next_token);
+
+				if (sscanf_s(p_token, " %d", &temp_indices[j]) == EOF)
+					return (-3502);				// Data read error
+			}
+
+			if (count > 0)
+				p_meshes[t].AddFace(&temp_indices[0], count);
+		}
+
+		// Work out the planes and edges of the mesh
+		if (!p_meshes[t].Build())
+			return (-3504);					// Invalid mesh
+
+	} // End for
+	
+	// All information has been extracted, close the file
+	fclose(map_file);
+
+	return 1;
+}
+
+/*-----------------------------------------------------------------------------------
+Release the memory held by the objects of the scene.
+-----------------------------------------------------------------------------------*/
+
+void CScene::ShutDown()
+{
+	if (p_balls != NULL)
+		delete [] p_balls;
+
+	if (p_walls != NULL)
+		delete [] p_walls;
+
+	if (p_boxes != NULL)
+		delete [] p_boxes;
+
+	if (p_meshes != NULL)
+		delete [] p_meshes;
+
+	p_balls = NULL;
+	p_walls = NULL;
+	p_boxes = NULL;
+	p_meshes = NULL;
+
+	sim.ShutDown();
+}
@@ -0,0 +1,56 @@
+/*-----------------------------------------------------------------------------------
+File:			scene.h
+Authors:		Steve Costa
+Description:	Header file defining the scene, the objects of the world loaded
+				from a map file without anything needed to draw them.
+-----------------------------------------------------------------------------------*/
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstdio>					// Header for data streaming
+#include <cstring>					// Header for string handling
+#include <new>						// Header for dynamic memory allocation
+using namespace std;
+
+#include "plane.h"					// Plane type class
+#include "sphere.h"					// Sphere type class
+#include "aabb.h"					// Bounding Box type class
+#include "convexMesh.h"				// Convex mesh type class
+#include "simStore.h"				// Simulation state of the balls and boxes
+
+/*-----------------------------------------------------------------------------------
+Class holding the walls, balls, boxes and meshes of a map.  This is all the
+collision tests need, so it is kept apart from the drawing done by CWorld and
+can be used where there is no window or graphics library.
+-----------------------------------------------------------------------------------*/
+
+class CScene
+{
+	// ATTRIBUTES
+public:
+
+	int num_walls;					// Number of walls
+	int num_balls;					// Number of balls
+	int num_boxes;					// Number of boxes
+	int num_meshes;					// Number of convex meshes
+	
+	TWall *p_walls;					// Declare walls
+	TBall *p_balls;					// Drawing attributes of the balls
+	TBox *p_boxes;					// Drawing attributes of the boxes
+	TConvexMesh *p_meshes;			// Declare convex meshes
+
+	CSimStore sim;					// Positions, velocities, radii and bounds of the balls and boxes
+
+	// METHODS
+public:
+
+	CScene();
+	int Load(const char *file_name);	// Load world configuration from file
+	void ShutDown();					// Release all alocated memory
+
+private:
+	bool ReadString(char *string, FILE *file);	// Read a string, ignore empty lines and comments
+};
+
+#endif
@@ -0,0 +1,593 @@
+/*-----------------------------------------------------------------------------------
+File:			sceneGen.cpp
+Authors:		Steve Costa
+Description:	Write map files of any size for the scaling benchmarks.  The
+				scenes are built from a layout and a number of moving objects
+				(balls and boxes), and are written in the format read by
+				CScene::Load.
+
+Usage:			scene_gen <layout> <count> [-seed n] [-o file]
+
+				gas				Balls flying about in a closed room
+				pit				Balls packed into a pit falling onto each other
+				towers			Towers of stacked boxes knocked by a few balls
+				tunnel			Small fast balls fired at rows of thin slabs
+				maze			Balls wandering a maze of many rooms
+-----------------------------------------------------------------------------------*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define GEN_MIN_COUNT		10			// Fewest moving objects in a scene
+#define GEN_MAX_COUNT		1000000		// Most moving objects in a scene
+#define GEN_SEED			12345
+
+#define GAS_VOLUME			8.0f		// Room volume for each ball of the gas
+#define GAS_RADIUS			0.3f
+#define GAS_SPEED			10.0f		// Fastest ball of the gas
+
+#define PIT_RADIUS			0.3f
+#define PIT_SPACING			0.65f		// Distance between the balls packed in the pit
+
+#define TOWER_HEIGHT		10			// Boxes in each tower
+#define TOWER_SIZE			1.0f		// Edge of each box
+#define TOWER_SPACING		3.0f		// Distance between the towers
+#define TOWER_BALLS			20			// Boxes for each ball thrown
+#define TOWER_HEADROOM		3.0f		// Space above the towers for the balls and boxes thrown
+
+#define TUNNEL_RADIUS		0.1f
+#define TUNNEL_SPEED		200.0f		// Fastest ball, 4 units a frame at 50 frames a second
+#define TUNNEL_SLABS		5			// Balls for each slab
+#define TUNNEL_THICKNESS	0.1f		// Slabs are thinner than a ball moves in a frame
+
+#define MAZE_CELL			10.0f		// Edge of each room of the maze
+#define MAZE_BALLS			10			// Balls in each room
+#define MAZE_RADIUS			0.4f
+
+#define ROOM_HEIGHT			5.0f		// Height of the walls of a room
+
+#define HALF_PI				1.570796f
+
+/*-----------------------------------------------------------------------------------
+Objects of the map as they are written to the file
+-----------------------------------------------------------------------------------*/
+
+struct TWallDef
+{
+	float x_min, y_min, x_max, y_max;		// Extents on the x-y plane before it is placed
+	float tx, ty, tz;						// Translation
+	int rot;								// Axis of the rotation, 0 for none
+	float theta;
+	int color, texture;
+};
+
+struct TBallDef
+{
+	float x, y, z, radius;
+	float vx, vy, vz;
+	int color;
+};
+
+struct TBoxDef
+{
+	float min_x, min_y, min_z, max_x, max_y, max_z;
+	float vx, vy, vz;
+	int color;
+};
+
+struct TMap
+{
+	vector<TWallDef> walls;
+	vector<TBallDef> balls;
+	vector<TBoxDef> boxes;
+};
+
+/*-----------------------------------------------------------------------------------
+Small generator (xorshift) so a seed gives the same map on every platform
+-----------------------------------------------------------------------------------*/
+
+struct TRandom
+{
+	unsigned int state;
+
+	explicit TRandom(unsigned int seed) : state(seed ? seed : 1) {}
+
+	unsigned int Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// Uniform in [lo, hi)
+	float Uniform(float lo, float hi)
+	{
+		return lo + (hi - lo) * (float)(Next() >> 8) * (1.0f / 16777216.0f);
+	}
+};
+
+/*-----------------------------------------------------------------------------------
+Add a wall.  A wall is only solid from the side its normal faces, so walls that
+can be hit from both sides are added twice back to back.
+-----------------------------------------------------------------------------------*/
+
+static void AddWall(TMap& map, float width, float height, float tx, float ty, float tz,
+					int rot, float theta, int color, int texture)
+{
+	TWallDef w;
+	w.x_min = 0.0f;
+	w.y_min = -height;
+	w.x_max = width;
+	w.y_max = 0.0f;
+	w.tx = tx;
+	w.ty = ty;
+	w.tz = tz;
+	w.rot = rot;
+	w.theta = theta;
+	w.color = color;
+	w.texture = texture;
+
+	map.walls.push_back(w);
+}
+
+// Wall along x at z from x0 to x1, facing +z and/or -z
+static void AddWallX(TMap& map, float x0, float x1, float z, float y, bool front, bool back)
+{
+	if (front)
+		AddWall(map, x1 - x0, ROOM_HEIGHT, x0, y + ROOM_HEIGHT, z, 0, 0.0f, 11, -1);
+
+	if (back)
+		AddWall(map, x1 - x0, ROOM_HEIGHT, x1, y + ROOM_HEIGHT, z, 2, PI, 11, -1);
+}
+
+// Wall along z at x from z0 to z1, facing +x and/or -x
+static void AddWallZ(TMap& map, float z0, float z1, float x, float y, bool front, bool back)
+{
+	if (front)
+		AddWall(map, z1 - z0, ROOM_HEIGHT, x, y + ROOM_HEIGHT, z1, 2, HALF_PI, 11, -1);
+
+	if (back)
+		AddWall(map, z1 - z0, ROOM_HEIGHT, x, y + ROOM_HEIGHT, z0, 2, -HALF_PI, 11, -1);
+}
+
+/*-----------------------------------------------------------------------------------
+Add a room covering x0 to x1 and z0 to z1: a floor, four walls facing in and
+optionally a ceiling at the given height.  The walls are raised to the height
+of the ceiling so nothing can get over them.
+-----------------------------------------------------------------------------------*/
+
+static void AddRoom(TMap& map, float x0, float x1, float z0, float z1, float ceiling)
+{
+	float w = x1 - x0, d = z1 - z0;
+	float h = MAX(ceiling, ROOM_HEIGHT);
+
+	// Floor
+	AddWall(map, w, d, x0, 0.0f, z0, 1, -HALF_PI, -1, 6);
+
+	AddWall(map, w, h, x0, h, z0, 0, 0.0f, 11, -1);			// Far
+	AddWall(map, w, h, x1, h, z1, 2, PI, 11, -1);			// Near
+	AddWall(map, d, h, x0, h, z1, 2, HALF_PI, 11, -1);		// Left
+	AddWall(map, d, h, x1, h, z0, 2, -HALF_PI, 11, -1);		// Right
+
+	if (ceiling > 0.0f)
+	{
+		TWallDef c;
+		c.x_min = 0.0f;
+		c.y_min = 0.0f;
+		c.x_max = w;
+		c.y_max = d;
+		c.tx = x0;
+		c.ty = ceiling;
+		c.tz = z0;
+		c.rot = 1;
+		c.theta = HALF_PI;
+		c.color = 12;
+		c.texture = -1;
+
+		map.walls.push_back(c);
+	}
+}
+
+static void AddBall(TMap& map, float x, float y, float z, float radius,
+					float vx, float vy, float vz, int color)
+{
+	TBallDef b = { x, y, z, radius, vx, vy, vz, color };
+	map.balls.push_back(b);
+}
+
+static void AddBox(	TMap& map, float x0, float y0, float z0, float x1, float y1, float z1,
+					float vx, float vy, float vz, int color)
+{
+	TBoxDef b = { x0, y0, z0, x1, y1, z1, vx, vy, vz, color };
+	map.boxes.push_back(b);
+}
+
+/*-----------------------------------------------------------------------------------
+Uniform ball gas.  The room grows with the count so the density stays the same,
+each ball is placed at a point of a jittered lattice so none overlap.
+-----------------------------------------------------------------------------------*/
+
+static void GenerateGas(TMap& map, int count, TRandom& rng)
+{
+	int per_side = (int)ceil(pow((double)count, 1.0 / 3.0));
+	float spacing = pow(GAS_VOLUME, 1.0f / 3.0f);
+	float side = per_side * spacing;
+
+	AddRoom(map, 0.0f, side, 0.0f, side, side);
+
+	float jitter = 0.5f * spacing - GAS_RADIUS - 0.01f;
+
+	for (int i = 0; i < count; i++)
+	{
+		int ix = i % per_side;
+		int iy = (i / per_side) % per_side;
+		int iz = i / (per_side * per_side);
+
+		float speed = rng.Uniform(0.0f, GAS_SPEED);
+		float vx = rng.Uniform(-1.0f, 1.0f), vy = rng.Uniform(-1.0f, 1.0f), vz = rng.Uniform(-1.0f, 1.0f);
+		float mag = sqrt(vx * vx + vy * vy + vz * vz) + 1e-6f;
+
+		AddBall(map,	(ix + 0.5f) * spacing + rng.Uniform(-jitter, jitter),
+						(iy + 0.5f) * spacing + rng.Uniform(-jitter, jitter),
+						(iz + 0.5f) * spacing + rng.Uniform(-jitter, jitter),
+						GAS_RADIUS, vx * speed / mag, vy * speed / mag, vz * speed / mag,
+						rng.Next() % 10);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Dense ball pit.  The balls start at rest packed almost touching in a block as
+deep as it is wide and fall into the pit together.
+-----------------------------------------------------------------------------------*/
+
+static void GeneratePit(TMap& map, int count, TRandom& rng)
+{
+	int per_side = (int)ceil(pow((double)count, 1.0 / 3.0));
+	float side = per_side * PIT_SPACING;
+
+	AddRoom(map, 0.0f, side, 0.0f, side, 0.0f);
+
+	for (int i = 0; i < count; i++)
+	{
+		int ix = i % per_side;
+		int iz = (i / per_side) % per_side;
+		int iy = i / (per_side * per_side);
+
+		// Every other layer is shifted a little so the pile does not stay stacked
+		float shift = (iy & 1) ? 0.02f : 0.0f;
+
+		AddBall(map,	(ix + 0.5f) * PIT_SPACING + shift,
+						(iy + 0.5f) * PIT_SPACING + 0.01f,
+						(iz + 0.5f) * PIT_SPACING + shift,
+						PIT_RADIUS, 0.0f, 0.0f, 0.0f, rng.Next() % 10);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Stacked box towers.  The towers stand on a square grid with a small gap between
+the boxes of each, and one ball in TOWER_BALLS is thrown at a tower from the
+side.  The room has a ceiling above the towers so the balls, and the boxes they
+knock off, can not be thrown out of it.
+-----------------------------------------------------------------------------------*/
+
+static void GenerateTowers(TMap& map, int count, TRandom& rng)
+{
+	int num_balls = MAX(1, count / TOWER_BALLS);
+	int num_boxes = count - num_balls;
+	int num_towers = (num_boxes + TOWER_HEIGHT - 1) / TOWER_HEIGHT;
+	int per_side = (int)ceil(sqrt((double)num_towers));
+	float side = (per_side + 1) * TOWER_SPACING;
+	float top = TOWER_HEIGHT * (TOWER_SIZE + 0.01f) + 0.01f;
+
+	AddRoom(map, 0.0f, side, 0.0f, side, top + TOWER_HEADROOM);
+
+	for (int i = 0; i < num_boxes; i++)
+	{
+		int tower = i / TOWER_HEIGHT;
+		int level = i % TOWER_HEIGHT;
+		float x = (tower % per_side + 1) * TOWER_SPACING - 0.5f * TOWER_SIZE;
+		float z = (tower / per_side + 1) * TOWER_SPACING - 0.5f * TOWER_SIZE;
+		float y = level * (TOWER_SIZE + 0.01f) + 0.01f;
+
+		AddBox(map, x, y, z, x + TOWER_SIZE, y + TOWER_SIZE, z + TOWER_SIZE,
+				0.0f, 0.0f, 0.0f, tower % 10);
+	}
+
+	// Each ball flies along a row of towers at a random height
+	for (int i = 0; i < num_balls; i++)
+	{
+		int row = rng.Next() % per_side;
+		float z = (row + 1) * TOWER_SPACING + rng.Uniform(-0.3f, 0.3f);
+		float y = rng.Uniform(1.0f, TOWER_HEIGHT * TOWER_SIZE);
+
+		AddBall(map, 0.5f * TOWER_SPACING, y, z, 0.5f, rng.Uniform(10.0f, 30.0f), 0.0f, 0.0f, 7);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Tunneling stress.  Small balls are fired down the length of a hall at speeds
+that take them several times their size in a frame, through rows of slabs
+thinner than that standing across the hall with gaps between them.
+-----------------------------------------------------------------------------------*/
+
+static void GenerateTunnel(TMap& map, int count, TRandom& rng)
+{
+	int num_slabs = MAX(1, count / TUNNEL_SLABS);
+	int num_balls = count - num_slabs;
+	int num_rows = (int)ceil(sqrt((double)num_slabs));
+	int per_row = (num_slabs + num_rows - 1) / num_rows;
+	float width = per_row * 2.0f;
+	float length = (num_rows + 2) * 4.0f;
+
+	AddRoom(map, 0.0f, length, 0.0f, width, 0.0f);
+
+	// Each slab is 1 wide with a gap of 1 to the next, the rows are staggered
+	for (int i = 0; i < num_slabs; i++)
+	{
+		int row = i / per_row;
+		float x = (row + 2) * 4.0f;
+		float z = (i % per_row) * 2.0f + ((row & 1) ? 1.0f : 0.0f);
+
+		AddBox(map, x, 0.01f, z, x + TUNNEL_THICKNESS, ROOM_HEIGHT - 0.5f, MIN(z + 1.0f, width),
+				0.0f, 0.0f, 0.0f, 9);
+	}
+
+	// The balls start in a block at the near end of the hall
+	int per_side = (int)ceil(sqrt((double)num_balls / 4.0));
+	float spacing = MIN(0.3f, width / MAX(per_side, 1));
+
+	for (int i = 0; i < num_balls; i++)
+	{
+		int iz = i % per_side;
+		int iy = (i / per_side) % 4;
+		int ix = i / (per_side * 4);
+
+		AddBall(map,	0.3f + (ix % 20) * 0.3f, 0.5f + iy * 1.0f, 0.2f + iz * spacing,
+						TUNNEL_RADIUS, rng.Uniform(0.5f, 1.0f) * TUNNEL_SPEED,
+						rng.Uniform(-2.0f, 2.0f), rng.Uniform(-20.0f, 20.0f), 0);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Maze of many rooms.  The rooms are cells of a square grid joined by a random
+spanning tree (depth first), a wall with a door in it is put between joined
+rooms and a solid wall between the others.  The walls inside the maze are two
+sided.  MAZE_BALLS balls roll about in each room.
+-----------------------------------------------------------------------------------*/
+
+static void GenerateMaze(TMap& map, int count, TRandom& rng)
+{
+	int num_rooms = MAX(1, count / MAZE_BALLS);
+	int n = (int)ceil(sqrt((double)num_rooms));
+	float side = n * MAZE_CELL;
+
+	AddRoom(map, 0.0f, side, 0.0f, side, 0.0f);
+
+	// open_x[c] joins cell c to the cell at +x, open_z[c] to the cell at +z
+	vector<char> open_x(n * n, 0), open_z(n * n, 0), visited(n * n, 0);
+	vector<int> stack;
+	stack.push_back(0);
+	visited[0] = 1;
+
+	while (!stack.empty())
+	{
+		int c = stack.back();
+		int cx = c % n, cz = c / n;
+
+		int next[4], num_next = 0;
+		if (cx > 0 && !visited[c - 1]) next[num_next++] = c - 1;
+		if (cx < n - 1 && !visited[c + 1]) next[num_next++] = c + 1;
+		if (cz > 0 && !visited[c - n]) next[num_next++] = c - n;
+		if (cz < n - 1 && !visited[c + n]) next[num_next++] = c + n;
+
+		if (num_next == 0)
+		{
+			stack.pop_back();
+			continue;
+		}
+
+		int d = next[rng.Next() % num_next];
+		if (d == c + 1) open_x[c] = 1;
+		else if (d == c - 1) open_x[d] = 1;
+		else if (d == c + n) open_z[c] = 1;
+		else open_z[d] = 1;
+
+		visited[d] = 1;
+		stack.push_back(d);
+	}
+
+	// A door is the middle fifth of the wall
+	float door0 = 0.4f * MAZE_CELL, door1 = 0.6f * MAZE_CELL;
+
+	for (int c = 0; c < n * n; c++)
+	{
+		float x0 = (c % n) * MAZE_CELL, z0 = (c / n) * MAZE_CELL;
+
+		if (c % n < n - 1)
+		{
+			float x = x0 + MAZE_CELL;
+			if (open_x[c])
+			{
+				AddWallZ(map, z0, z0 + door0, x, 0.0f, true, true);
+				AddWallZ(map, z0 + door1, z0 + MAZE_CELL, x, 0.0f, true, true);
+			}
+			else
+				AddWallZ(map, z0, z0 + MAZE_CELL, x, 0.0f, true, true);
+		}
+
+		if (c / n < n - 1)
+		{
+			float z = z0 + MAZE_CELL;
+			if (open_z[c])
+			{
+				AddWallX(map, x0, x0 + door0, z, 0.0f, true, true);
+				AddWallX(map, x0 + door1, x0 + MAZE_CELL, z, 0.0f, true, true);
+			}
+			else
+				AddWallX(map, x0, x0 + MAZE_CELL, z, 0.0f, true, true);
+		}
+	}
+
+	// Balls on a grid in each room, rolling in random directions
+	int per_row = (int)ceil(sqrt((double)MAZE_BALLS));
+	float spacing = (MAZE_CELL - 2.0f) / per_row;
+
+	for (int i = 0; i < count; i++)
+	{
+		int c = (i / MAZE_BALLS) % (n * n);
+		int k = i % MAZE_BALLS + MAZE_BALLS * (i / (MAZE_BALLS * n * n));
+		float x = (c % n) * MAZE_CELL + 1.0f + (k % per_row + 0.5f) * spacing;
+		float z = (c / n) * MAZE_CELL + 1.0f + ((k / per_row) % per_row + 0.5f) * spacing;
+		float y = MAZE_RADIUS + 0.01f + (k / (per_row * per_row)) * 2.0f * (MAZE_RADIUS + 0.01f);
+
+		float angle = rng.Uniform(0.0f, PI2);
+		float speed = rng.Uniform(1.0f, 8.0f);
+
+		AddBall(map, x, y, z, MAZE_RADIUS, speed * cos(angle), 0.0f, speed * sin(angle),
+				rng.Next() % 10);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Write the map with the same sections and comments as the hand made maps
+-----------------------------------------------------------------------------------*/
+
+static void WriteMap(FILE *file, const TMap& map, const char *layout, int count, unsigned int seed)
+{
+	fprintf(file,	"#----------------------------------------------------------------------------------------\n"
+					"# Generated by scene_gen: layout %s, %d objects, seed %u\n"
+					"#----------------------------------------------------------------------------------------\n\n",
+					layout, count, seed);
+
+	fprintf(file,	"#x-min\t\ty-min\t\tx-max\t\ty-max\t\tcolor\t\ttexture\n"
+					"#x-trans\ty-trans\t\tz-trans\t\trot-type\ttheta\n\n");
+	fprintf(file, "numwalls = %d\n\n", (int)map.walls.size());
+
+	for (unsigned int i = 0; i < map.walls.size(); i++)
+	{
+		const TWallDef& w = map.walls[i];
+		fprintf(file, "%.4f\t%.4f\t%.4f\t%.4f\t%d\t%d\n", w.x_min, w.y_min, w.x_max, w.y_max,
+				w.color, w.texture);
+		fprintf(file, "%.4f\t%.4f\t%.4f\t%d\t%.6f\n", w.tx, w.ty, w.tz, w.rot, w.theta);
+	}
+
+	fprintf(file,	"\n#centre-x\tcentre-y\tcentre-z\tradius\t\tvelocity-x\tvelocity-y\tvelocity-z\t"
+					"color\t\ttexture\n\n");
+	fprintf(file, "numballs = %d\n\n", (int)map.balls.size());
+
+	for (unsigned int i = 0; i < map.balls.size(); i++)
+	{
+		const TBallDef& b = map.balls[i];
+		fprintf(file, "%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%d\t-1\n", b.x, b.y, b.z,
+				b.radius, b.vx, b.vy, b.vz, b.color);
+	}
+
+	fprintf(file,	"\n#min-x\t\tmin-y\t\tmin-z\t\tmax-x\t\tmax-y\t\tmax-z\t\tvelocity-x\tvelocity-y\t"
+					"velocity-z\tcolor\t\ttexture\n\n");
+	fprintf(file, "numboxes = %d\n\n", (int)map.boxes.size());
+
+	for (unsigned int i = 0; i < map.boxes.size(); i++)
+	{
+		const TBoxDef& b = map.boxes[i];
+		fprintf(file, "%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\t%d\t-1\n",
+				b.min_x, b.min_y, b.min_z, b.max_x, b.max_y, b.max_z, b.vx, b.vy, b.vz, b.color);
+	}
+
+	fprintf(file, "\nnummeshes = 0\n");
+}
+
+/*-----------------------------------------------------------------------------------
+Print how the options are used
+-----------------------------------------------------------------------------------*/
+
+static void PrintUsage()
+{
+	fprintf(stderr,	"usage: scene_gen <gas|pit|towers|tunnel|maze> <count> [-seed n] [-o file]\n"
+					"       count is the number of balls and boxes, %d to %d\n",
+					GEN_MIN_COUNT, GEN_MAX_COUNT);
+}
+
+/*-----------------------------------------------------------------------------------
+Build the scene and write it to the file or the standard output
+-----------------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const char *layout = argv[1];
+	int count = atoi(argv[2]);
+	unsigned int seed = GEN_SEED;
+	const char *out_name = NULL;
+
+	for (int k = 3; k < argc; k++)
+	{
+		if (strcmp(argv[k], "-seed") == 0 && k + 1 < argc)
+			seed = (unsigned int)strtoul(argv[++k], NULL, 10);
+		else if (strcmp(argv[k], "-o") == 0 && k + 1 < argc)
+			out_name = argv[++k];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (count < GEN_MIN_COUNT || count > GEN_MAX_COUNT)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	TMap map;
+	TRandom rng(seed);
+
+	if (strcmp(layout, "gas") == 0)
+		GenerateGas(map, count, rng);
+	else if (strcmp(layout, "pit") == 0)
+		GeneratePit(map, count, rng);
+	else if (strcmp(layout, "towers") == 0)
+		GenerateTowers(map, count, rng);
+	else if (strcmp(layout, "tunnel") == 0)
+		GenerateTunnel(map, count, rng);
+	else if (strcmp(layout, "maze") == 0)
+		GenerateMaze(map, count, rng);
+	else
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	FILE *file = stdout;
+	if (out_name != NULL)
+	{
+		file = fopen(out_name, "w");
+		if (file == NULL)
+		{
+			fprintf(stderr, "Failed to open %s\n", out_name);
+			return 1;
+		}
+	}
+
+	WriteMap(file, map, layout, count, seed);
+
+	if (file != stdout)
+		fclose(file);
+
+	return 0;
+}
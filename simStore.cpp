@@ -0,0 +1,142 @@
+/*-----------------------------------------------------------------------------------
+File:			simStore.cpp
+Authors:		Steve Costa
+Description:	Structure of arrays holding the simulation state of the balls and
+				boxes.  The arrays of each kind are carved out of one allocation,
+				each one starting on a SIM_ALIGNMENT byte boundary.
+-----------------------------------------------------------------------------------*/
+
+#include "simStore.h"
+
+#include <cstring>
+
+/*-----------------------------------------------------------------------------------
+Round a number of elements up to a whole number of SIM_LANES
+-----------------------------------------------------------------------------------*/
+
+static int PaddedCount(int num)
+{
+	return ((num + SIM_LANES - 1) / SIM_LANES) * SIM_LANES;
+}
+
+/*-----------------------------------------------------------------------------------
+Allocate num_arrays zeroed arrays of stride floats, the first one aligned to
+SIM_ALIGNMENT bytes.  Since SIM_ALIGNMENT is a multiple of the size of SIM_LANES
+floats, padding every array keeps the next one aligned.  The allocation to free
+is returned in memory.
+-----------------------------------------------------------------------------------*/
+
+static float *AllocArrays(int num_arrays, int stride, char *&memory)
+{
+	size_t size = num_arrays * stride * sizeof(float) + SIM_ALIGNMENT;
+
+	memory = new char[size];
+	memset(memory, 0, size);
+
+	// Skip ahead to the first aligned address
+	size_t offset = (size_t)memory % SIM_ALIGNMENT;
+	return (float*)(memory + (offset ? SIM_ALIGNMENT - offset : 0));
+}
+
+/*-----------------------------------------------------------------------------------
+Initialise state variables
+-----------------------------------------------------------------------------------*/
+
+CSimStore::CSimStore()
+{
+	num_balls = 0;
+	num_boxes = 0;
+	p_ball_memory = NULL;
+	p_box_memory = NULL;
+
+	p_ball_x = p_ball_y = p_ball_z = NULL;
+	p_ball_vx = p_ball_vy = p_ball_vz = NULL;
+	p_ball_ax = p_ball_ay = p_ball_az = NULL;
+	p_ball_radius = NULL;
+
+	p_box_min_x = p_box_min_y = p_box_min_z = NULL;
+	p_box_max_x = p_box_max_y = p_box_max_z = NULL;
+	p_box_vx = p_box_vy = p_box_vz = NULL;
+	p_box_ax = p_box_ay = p_box_az = NULL;
+}
+
+CSimStore::~CSimStore()
+{
+	ShutDown();
+}
+
+/*-----------------------------------------------------------------------------------
+Allocate the arrays for the given number of balls, all zero until the loader
+sets them
+-----------------------------------------------------------------------------------*/
+
+void CSimStore::InitBalls(int nballs)
+{
+	if (p_ball_memory != NULL)
+		delete [] p_ball_memory;
+	p_ball_memory = NULL;
+	num_balls = 0;
+
+	int stride = PaddedCount(nballs);
+	float *p = AllocArrays(10, stride, p_ball_memory);
+	num_balls = nballs;
+
+	p_ball_x = p;		p += stride;
+	p_ball_y = p;		p += stride;
+	p_ball_z = p;		p += stride;
+	p_ball_vx = p;		p += stride;
+	p_ball_vy = p;		p += stride;
+	p_ball_vz = p;		p += stride;
+	p_ball_ax = p;		p += stride;
+	p_ball_ay = p;		p += stride;
+	p_ball_az = p;		p += stride;
+	p_ball_radius = p;
+}
+
+/*-----------------------------------------------------------------------------------
+Allocate the arrays for the given number of boxes, all zero until the loader
+sets them
+-----------------------------------------------------------------------------------*/
+
+void CSimStore::InitBoxes(int nboxes)
+{
+	if (p_box_memory != NULL)
+		delete [] p_box_memory;
+	p_box_memory = NULL;
+	num_boxes = 0;
+
+	int stride = PaddedCount(nboxes);
+	float *p = AllocArrays(12, stride, p_box_memory);
+	num_boxes = nboxes;
+
+	p_box_min_x = p;	p += stride;
+	p_box_min_y = p;	p += stride;
+	p_box_min_z = p;	p += stride;
+	p_box_max_x = p;	p += stride;
+	p_box_max_y = p;	p += stride;
+	p_box_max_z = p;	p += stride;
+	p_box_vx = p;		p += stride;
+	p_box_vy = p;		p += stride;
+	p_box_vz = p;		p += stride;
+	p_box_ax = p;		p += stride;
+	p_box_ay = p;		p += stride;
+	p_box_az = p;
+}
+
+/*-----------------------------------------------------------------------------------
+Release the arrays
+-----------------------------------------------------------------------------------*/
+
+void CSimStore::ShutDown()
+{
+	if (p_ball_memory != NULL)
+		delete [] p_ball_memory;
+
+	if (p_box_memory != NULL)
+		delete [] p_box_memory;
+
+	p_ball_memory = NULL;
+	p_box_memory = NULL;
+	num_balls = 0;
+	num_boxes = 0;
+}
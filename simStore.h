@@ -0,0 +1,138 @@
+/*-----------------------------------------------------------------------------------
+File:			simStore.h
+Authors:		Steve Costa
+Description:	Header file defining the simulation store.  The state of the balls
+				and boxes that moves them and that the collision tests read
+				(positions, velocities, accelerations, radii and bounds) is kept
+				here as one contiguous array per component.  The ball and box
+				objects only carry what is needed to draw them.
+-----------------------------------------------------------------------------------*/
+
+#ifndef SIM_STORE_H
+#define SIM_STORE_H
+
+#include "vector.h"
+using namespace vec;
+
+#include "aabb.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define SIM_ALIGNMENT		32			// Byte alignment of each array
+#define SIM_LANES			8			// Arrays are padded to a multiple of this
+
+/*-----------------------------------------------------------------------------------
+Structure of arrays holding the simulation state of the balls and boxes.  This is
+the only copy of that state: the map loader fills it, the game and the headless
+driver change the velocities through it, the collision tests move the objects in
+it and the world draws them from it.  The ball and box objects of CScene are the
+cold side table of what only drawing needs (rotation, axis, colour, texture).
+
+The arrays of the balls share one allocation and those of the boxes another, so
+the loader can size each kind as it reaches it in the map.  Each array is aligned
+to SIM_ALIGNMENT bytes and padded to a multiple of SIM_LANES elements, the
+padding is zeroed.
+-----------------------------------------------------------------------------------*/
+
+class CSimStore
+{
+	// ATTRIBUTES
+public:
+
+	int num_balls;					// Number of balls
+	int num_boxes;					// Number of boxes
+
+	float *p_ball_x;				// Ball centres
+	float *p_ball_y;
+	float *p_ball_z;
+	float *p_ball_vx;				// Ball velocities
+	float *p_ball_vy;
+	float *p_ball_vz;
+	float *p_ball_ax;				// Ball accelerations
+	float *p_ball_ay;
+	float *p_ball_az;
+	float *p_ball_radius;			// Ball radii
+
+	float *p_box_min_x;				// Box min corners
+	float *p_box_min_y;
+	float *p_box_min_z;
+	float *p_box_max_x;				// Box max corners
+	float *p_box_max_y;
+	float *p_box_max_z;
+	float *p_box_vx;				// Box velocities
+	float *p_box_vy;
+	float *p_box_vz;
+	float *p_box_ax;				// Box accelerations
+	float *p_box_ay;
+	float *p_box_az;
+
+private:
+
+	char *p_ball_memory;			// Single allocation holding the ball arrays
+	char *p_box_memory;				// Single allocation holding the box arrays
+
+	// METHODS
+public:
+
+	CSimStore();
+	~CSimStore();
+
+	// Allocate zeroed arrays for the balls or the boxes, throws bad_alloc
+	void InitBalls(int nballs);
+	void InitBoxes(int nboxes);
+	void ShutDown();
+
+	// Ball access
+	TVector GetBallCenter(int i) const { return TVector(p_ball_x[i], p_ball_y[i], p_ball_z[i]); }
+	TVector GetBallVel(int i) const { return TVector(p_ball_vx[i], p_ball_vy[i], p_ball_vz[i]); }
+	TVector GetBallAccel(int i) const { return TVector(p_ball_ax[i], p_ball_ay[i], p_ball_az[i]); }
+	float GetBallRadius(int i) const { return p_ball_radius[i]; }
+
+	void SetBallCenter(int i, const TVector& c) { p_ball_x[i] = c.x; p_ball_y[i] = c.y; p_ball_z[i] = c.z; }
+	void SetBallVel(int i, const TVector& v) { p_ball_vx[i] = v.x; p_ball_vy[i] = v.y; p_ball_vz[i] = v.z; }
+	void SetBallAccel(int i, const TVector& a) { p_ball_ax[i] = a.x; p_ball_ay[i] = a.y; p_ball_az[i] = a.z; }
+	void SetBallRadius(int i, float r) { p_ball_radius[i] = r; }
+
+	void MoveBall(int i, const TVector& disp)
+	{
+		p_ball_x[i] += disp.x;	p_ball_y[i] += disp.y;	p_ball_z[i] += disp.z;
+	}
+
+	void AccelerateBall(int i)
+	{
+		p_ball_vx[i] += p_ball_ax[i];	p_ball_vy[i] += p_ball_ay[i];	p_ball_vz[i] += p_ball_az[i];
+	}
+
+	// Box access
+	TVector GetBoxMin(int i) const { return TVector(p_box_min_x[i], p_box_min_y[i], p_box_min_z[i]); }
+	TVector GetBoxMax(int i) const { return TVector(p_box_max_x[i], p_box_max_y[i], p_box_max_z[i]); }
+	TVector GetBoxVel(int i) const { return TVector(p_box_vx[i], p_box_vy[i], p_box_vz[i]); }
+	TVector GetBoxAccel(int i) const { return TVector(p_box_ax[i], p_box_ay[i], p_box_az[i]); }
+	TAABB GetBoxBounds(int i) const { return TAABB(GetBoxMin(i), GetBoxMax(i)); }
+
+	void SetBoxMin(int i, const TVector& m) { p_box_min_x[i] = m.x; p_box_min_y[i] = m.y; p_box_min_z[i] = m.z; }
+	void SetBoxMax(int i, const TVector& m) { p_box_max_x[i] = m.x; p_box_max_y[i] = m.y; p_box_max_z[i] = m.z; }
+	void SetBoxVel(int i, const TVector& v) { p_box_vx[i] = v.x; p_box_vy[i] = v.y; p_box_vz[i] = v.z; }
+	void SetBoxAccel(int i, const TVector& a) { p_box_ax[i] = a.x; p_box_ay[i] = a.y; p_box_az[i] = a.z; }
+
+	void MoveBox(int i, const TVector& disp)
+	{
+		p_box_max_x[i] += disp.x;	p_box_max_y[i] += disp.y;	p_box_max_z[i] += disp.z;
+		p_box_min_x[i] += disp.x;	p_box_min_y[i] += disp.y;	p_box_min_z[i] += disp.z;
+	}
+
+	void AccelerateBox(int i)
+	{
+		p_box_vx[i] += p_box_ax[i];	p_box_vy[i] += p_box_ay[i];	p_box_vz[i] += p_box_az[i];
+	}
+
+private:
+
+	// Prevent copying, the arrays are owned by the store
+	CSimStore(const CSimStore&);
+	CSimStore& operator = (const CSimStore&);
+};
+
+#endif
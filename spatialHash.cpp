@@ -0,0 +1,262 @@
+/*-----------------------------------------------------------------------------------
+File:			spatialHash.cpp
+Authors:		Steve Costa
+Description:	Uniform hash grid broadphase.  Every object is recorded in each
+				cell its swept bounds cover.  The records are bucketed on a hash
+				of the cell coordinates with a counting sort so that the build
+				is a handful of linear passes, each of which only writes data
+				belonging to one object or one record.
+-----------------------------------------------------------------------------------*/
+
+#include "spatialHash.h"
+
+#include <algorithm>
+
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+Initialise state variables
+-----------------------------------------------------------------------------------*/
+
+CSpatialHash::CSpatialHash()
+{
+	num_objects = 0;
+	p_bounds = NULL;
+	table_mask = 0;
+
+	SetCellSize(GRID_CELL_SIZE);
+}
+
+/*-----------------------------------------------------------------------------------
+Set the edge length of the grid cells.  Cells should be a little larger than the
+typical swept object so most objects only land in a few cells.
+-----------------------------------------------------------------------------------*/
+
+void CSpatialHash::SetCellSize(float size)
+{
+	assert(size > 0.0f);
+
+	cell_size = size;
+	inv_cell_size = 1.0f / size;
+}
+
+/*-----------------------------------------------------------------------------------
+Return the coordinates of the cell containing the point.  Coordinates are clamped
+so that objects flying off to infinity can not overflow the integer conversion.
+-----------------------------------------------------------------------------------*/
+
+CSpatialHash::TCell CSpatialHash::GetCell(const TVector& point) const
+{
+	const float limit = 1000000.0f;
+
+	TCell cell;
+	cell.x = (int)floor(MAX(-limit, MIN(limit, point.x * inv_cell_size)));
+	cell.y = (int)floor(MAX(-limit, MIN(limit, point.y * inv_cell_size)));
+	cell.z = (int)floor(MAX(-limit, MIN(limit, point.z * inv_cell_size)));
+
+	return cell;
+}
+
+/*-----------------------------------------------------------------------------------
+Hash cell coordinates into the bucket table
+-----------------------------------------------------------------------------------*/
+
+unsigned int CSpatialHash::Hash(const TCell& cell) const
+{
+	unsigned int h =	((unsigned int)cell.x * 73856093u) ^
+						((unsigned int)cell.y * 19349663u) ^
+						((unsigned int)cell.z * 83492791u);
+
+	return h & table_mask;
+}
+
+/*-----------------------------------------------------------------------------------
+Number of cells covered by the bounds of an object
+-----------------------------------------------------------------------------------*/
+
+long long CSpatialHash::CellCount(int id) const
+{
+	return	(long long)(cell_max[id].x - cell_min[id].x + 1) *
+			(long long)(cell_max[id].y - cell_min[id].y + 1) *
+			(long long)(cell_max[id].z - cell_min[id].z + 1);
+}
+
+/*-----------------------------------------------------------------------------------
+Bucket the objects by the cells their bounds cover.  The build works as follows:
+	1. Find the cell range of every object.
+	2. Prefix sum the cell counts to give each object its own block of records.
+	3. Fill in each object's records.
+	4. Counting sort the records on the hash of their cell.
+Steps 1 and 3 do not share any state between objects so they can be split
+across threads.  Objects covering a huge number of cells (very fast movers) are
+kept out of the grid and tested directly against everything instead.
+-----------------------------------------------------------------------------------*/
+
+void CSpatialHash::Build(const TAABB *bounds, int num)
+{
+	num_objects = num;
+	p_bounds = bounds;
+
+	cell_min.resize(num_objects);
+	cell_max.resize(num_objects);
+	first_record.resize(num_objects + 1);
+	oversized.clear();
+
+	// Cell range of every object
+	for (int i = 0; i < num_objects; i++)
+	{
+		cell_min[i] = GetCell(p_bounds[i].minv);
+		cell_max[i] = GetCell(p_bounds[i].maxv);
+	}
+
+	// Give each object a block of records
+	first_record[0] = 0;
+	for (int i = 0; i < num_objects; i++)
+	{
+		int count = 0;
+		if (IsOversized(i))
+			oversized.push_back(i);
+		else
+			count = (int)CellCount(i);
+
+		first_record[i + 1] = first_record[i] + count;
+	}
+
+	int num_records = first_record[num_objects];
+	unsorted.resize(num_records);
+
+	// Fill in the records of every object
+	for (int i = 0; i < num_objects; i++)
+	{
+		if (first_record[i + 1] == first_record[i])
+			continue;
+
+		int k = first_record[i];
+		TRecord rec;
+		rec.id = i;
+
+		for (rec.cell.z = cell_min[i].z; rec.cell.z <= cell_max[i].z; rec.cell.z++)
+			for (rec.cell.y = cell_min[i].y; rec.cell.y <= cell_max[i].y; rec.cell.y++)
+				for (rec.cell.x = cell_min[i].x; rec.cell.x <= cell_max[i].x; rec.cell.x++)
+					unsorted[k++] = rec;
+	}
+
+	// Size the table to keep buckets short
+	unsigned int table_size = 64;
+	while (table_size < (unsigned int)num_records * 2)
+		table_size <<= 1;
+	table_mask = table_size - 1;
+
+	// Counting sort of the records into their buckets
+	bucket_start.assign(table_size + 1, 0);
+	for (int k = 0; k < num_records; k++)
+		bucket_start[Hash(unsorted[k].cell) + 1]++;
+
+	for (unsigned int h = 0; h < table_size; h++)
+		bucket_start[h + 1] += bucket_start[h];
+
+	records.resize(num_records);
+	vector<int> fill(bucket_start.begin(), bucket_start.end() - 1);
+	for (int k = 0; k < num_records; k++)
+		records[fill[Hash(unsorted[k].cell)]++] = unsorted[k];
+}
+
+/*-----------------------------------------------------------------------------------
+Append the objects in [first, last) whose bounds overlap those of object id.  If
+ordered is set only objects with a greater id are reported.
+
+Two objects sharing several cells would be found once per cell.  To report a
+pair exactly once it is only accepted in the first cell both objects cover,
+which is the cell at the larger of their two min cell coordinates.
+-----------------------------------------------------------------------------------*/
+
+void CSpatialHash::Query(int id, int first, int last, bool ordered, vector<TPair>& pairs) const
+{
+	const TAABB& b1 = p_bounds[id];
+	TPair pair;
+	pair.object1 = id;
+
+	// Oversized objects are not in the grid so test them against everything
+	if (IsOversized(id))
+	{
+		for (int other = first; other < last; other++)
+		{
+			if (other == id || (ordered && other < id)) continue;
+
+			if (Overlaps(b1, p_bounds[other])) {
+				pair.object2 = other;
+				pairs.push_back(pair);
+			}
+		}
+		return;
+	}
+
+	for (unsigned int k = 0; k < oversized.size(); k++)
+	{
+		int other = oversized[k];
+		if (other < first || other >= last || (ordered && other < id)) continue;
+
+		if (Overlaps(b1, p_bounds[other])) {
+			pair.object2 = other;
+			pairs.push_back(pair);
+		}
+	}
+
+	// Visit the buckets of every cell the object covers
+	TCell c;
+	for (c.z = cell_min[id].z; c.z <= cell_max[id].z; c.z++)
+		for (c.y = cell_min[id].y; c.y <= cell_max[id].y; c.y++)
+			for (c.x = cell_min[id].x; c.x <= cell_max[id].x; c.x++)
+			{
+				unsigned int h = Hash(c);
+
+				for (int k = bucket_start[h]; k < bucket_start[h + 1]; k++)
+				{
+					const TRecord& rec = records[k];
+					int other = rec.id;
+
+					// Different cell with the same hash
+					if (rec.cell.x != c.x || rec.cell.y != c.y || rec.cell.z != c.z) continue;
+
+					if (other < first || other >= last || other == id) continue;
+					if (ordered && other < id) continue;
+
+					// Only report the pair in the first shared cell
+					if (MAX(cell_min[id].x, cell_min[other].x) != c.x ||
+						MAX(cell_min[id].y, cell_min[other].y) != c.y ||
+						MAX(cell_min[id].z, cell_min[other].z) != c.z) continue;
+
+					if (Overlaps(b1, p_bounds[other])) {
+						pair.object2 = other;
+						pairs.push_back(pair);
+					}
+				}
+			}
+}
+
+/*-----------------------------------------------------------------------------------
+Find all the overlapping pairs between two ranges of objects.  Each query is
+independent of the others so the loop can be split across threads, with each
+thread appending to its own list before the lists are merged and sorted.
+-----------------------------------------------------------------------------------*/
+
+int CSpatialHash::FindPairs(int first1, int last1, int first2, int last2,
+							vector<TPair>& pairs) const
+{
+	bool same_range = (first1 == first2) && (last1 == last2);
+
+	pairs.clear();
+
+	for (int id = first1; id < last1; id++)
+		Query(id, first2, last2, same_range, pairs);
+
+	for (unsigned int k = 0; k < pairs.size(); k++)
+	{
+		pairs[k].object1 -= first1;
+		pairs[k].object2 -= first2;
+	}
+
+	sort(pairs.begin(), pairs.end());
+
+	return (int)pairs.size();
+}
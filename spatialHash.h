@@ -0,0 +1,88 @@
+/*-----------------------------------------------------------------------------------
+File:			spatialHash.h
+Authors:		Steve Costa
+Description:	Header file defining a uniform hash grid broadphase.  Objects
+				are bucketed by the grid cells their swept bounds cover and
+				only objects sharing a cell are reported as candidate pairs.
+-----------------------------------------------------------------------------------*/
+
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <vector>
+using namespace std;
+
+#include "broadphase.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define GRID_CELL_SIZE		2.0f		// Default edge length of a grid cell
+#define GRID_MAX_CELLS		512			// Objects covering more cells are kept apart
+
+class CSpatialHash
+{
+	// ATTRIBUTES
+public:
+
+	// Cell coordinates of an object (or a range of them)
+	struct TCell
+	{
+		int x, y, z;
+	};
+
+	// An object stored in one grid cell
+	struct TRecord
+	{
+		TCell cell;					// Cell the record belongs to
+		int id;						// Object id
+	};
+
+private:
+
+	float cell_size;				// Edge length of a cell
+	float inv_cell_size;
+
+	int num_objects;				// Number of objects in the grid
+	const TAABB *p_bounds;			// Bounds of the objects (owned by caller)
+
+	vector<TCell> cell_min;			// First cell covered by each object
+	vector<TCell> cell_max;			// Last cell covered by each object
+	vector<int> first_record;		// Offset of each object's records (num_objects + 1)
+	vector<int> oversized;			// Objects covering more than GRID_MAX_CELLS cells
+
+	vector<TRecord> records;		// Records sorted by bucket
+	vector<TRecord> unsorted;		// Records in object order before bucketing
+	vector<int> bucket_start;		// Offset of each bucket in records (table_size + 1)
+	unsigned int table_mask;		// table_size - 1, table_size is a power of 2
+
+	// METHODS
+public:
+
+	CSpatialHash();
+
+	void SetCellSize(float size);
+	float GetCellSize() const { return cell_size; }
+
+	// Bucket num objects by their bounds, bounds must stay valid until the next build
+	void Build(const TAABB *bounds, int num);
+
+	// Find overlapping pairs with object1 in [first1, last1) and object2 in
+	// [first2, last2).  When both ranges are the same only object1 < object2 is
+	// reported.  Pairs are returned relative to the start of each range.
+	int FindPairs(int first1, int last1, int first2, int last2, vector<TPair>& pairs) const;
+
+	// Append the objects in [first, last) overlapping object id.  The grid is
+	// not modified so separate objects can be queried from separate threads.
+	void Query(int id, int first, int last, bool ordered, vector<TPair>& pairs) const;
+
+private:
+
+	TCell GetCell(const TVector& point) const;
+	unsigned int Hash(const TCell& cell) const;
+	long long CellCount(int id) const;
+	bool IsOversized(int id) const { return CellCount(id) > GRID_MAX_CELLS; }
+};
+
+#endif
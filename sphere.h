@@ -37,22 +37,20 @@ public:
 };
 
 /*-----------------------------------------------------------------------------------
-As a derivation of the TSphere class this contains other attributes that will
-be required for collision detection and physics calculations
+The attributes of a ball that are only needed to draw it.  Its centre, radius,
+velocity and acceleration are kept in the simulation store (CSimStore) and are
+passed in where the rotation depends on them.
 -----------------------------------------------------------------------------------*/
-class TBall : public TSphere
+class TBall
 {
 	// ATTRIBUTES
 public:
-	TVector vel;				// Velocity of ball
-	TVector accel;				// Acceleration of ball
 	TMatrix rot;				// Rotation matrix for ball spinning
 	TVector axis;				// Axis of rotation for the ball
 	int texture;				// ID specifying global texture to choose
 	int color;					// ID specifying global colour to choose
 		
 private:
-	float circumference;
 	float spin_angle;			// Keep track of the current rotation of the ball
 			
 	// METHODS
@@ -60,16 +58,16 @@ public:
 
 	TBall() {}					// Common constructor
 
-	// Initialization constructor
-	TBall(const TVector& c, float r, const TVector& v, int col, int tex);
+	// Initialization constructor, the axis is set from the initial velocity
+	TBall(const TVector& v, int col, int tex);
 
-	// Once the player turns, the axis of rotation for the ball must
-	// turn also
-	void Turn(float theta);
+	// Once the player turns, the velocity of the ball and its axis of
+	// rotation must turn also
+	void Turn(float theta, TVector& vel);
 	
 	// Given the velocity of the ball, its radius and the axis of
 	// rotation this method will rotate the ball accordingly
-	void Rotate(float dt);
+	void Rotate(const TVector& vel, float radius, float dt);
 };
 
 #endif
\ No newline at end of file
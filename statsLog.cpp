@@ -0,0 +1,207 @@
+/*-----------------------------------------------------------------------------------
+File:			statsLog.cpp
+Authors:		Steve Costa
+Description:	Log of the frame stats of the collision tests as CSV or JSON
+				lines.
+-----------------------------------------------------------------------------------*/
+
+#include "statsLog.h"
+
+#include <assert.h>
+
+/*-----------------------------------------------------------------------------------
+The log is opened with the secure fopen_s, which only the Microsoft library has.
+-----------------------------------------------------------------------------------*/
+
+#ifndef _MSC_VER
+
+static int fopen_s(FILE **p_file, const char *file_name, const char *mode)
+{
+	*p_file = fopen(file_name, mode);
+	return (*p_file == NULL) ? -1 : 0;
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------------
+Names of the counters, in the order of their constants
+-----------------------------------------------------------------------------------*/
+
+static const char *collision_names[NUM_COLLISION_TYPES] =
+{
+	"none", "ball_ball", "ball_wall", "box_wall", "box_box", "ball_box", "ball_mesh"
+};
+
+static const char *geomath_names[NUM_GEOMATH_KINDS] =
+{
+	"ball_ball", "ball_ball_batch", "ball_wall_batch", "box_wall", "box_box",
+	"box_box_batch", "ball_box", "ball_mesh", "overlap"
+};
+
+static const char *phase_names[NUM_PHASES] =
+{
+	"broadphase", "ball_ball", "ball_wall", "box_wall", "box_box", "box_ball",
+	"ball_mesh", "retest", "advance", "response", "overlaps", "sleep"
+};
+
+/*-----------------------------------------------------------------------------------
+Names of a collision type, a geomath test and a phase
+-----------------------------------------------------------------------------------*/
+
+const char* CStatsLog::CollisionName(int coll_id)
+{
+	assert(coll_id >= 0 && coll_id < NUM_COLLISION_TYPES);
+	return collision_names[coll_id];
+}
+
+const char* CStatsLog::GeomathName(int kind)
+{
+	assert(kind >= 0 && kind < NUM_GEOMATH_KINDS);
+	return geomath_names[kind];
+}
+
+const char* CStatsLog::PhaseName(int phase)
+{
+	assert(phase >= 0 && phase < NUM_PHASES);
+	return phase_names[phase];
+}
+
+/*-----------------------------------------------------------------------------------
+Initialise a log with no file
+-----------------------------------------------------------------------------------*/
+
+CStatsLog::CStatsLog()
+{
+	p_file = NULL;
+	format = STATS_CSV;
+}
+
+/*-----------------------------------------------------------------------------------
+Close the file
+-----------------------------------------------------------------------------------*/
+
+CStatsLog::~CStatsLog()
+{
+	Close();
+}
+
+/*-----------------------------------------------------------------------------------
+Create the file of the log, replacing any file of that name.  A CSV log starts
+with its header.  Returns false if the file could not be created.
+-----------------------------------------------------------------------------------*/
+
+bool CStatsLog::Open(const char *file_name, int format)
+{
+	assert(format == STATS_CSV || format == STATS_JSON);
+
+	Close();
+
+	if (fopen_s(&p_file, file_name, "w") != 0 || p_file == NULL)
+	{
+		p_file = NULL;
+		return false;
+	}
+
+	this->format = format;
+
+	if (format == STATS_CSV)
+		WriteHeader();
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------------
+Close the file, if one is open
+-----------------------------------------------------------------------------------*/
+
+void CStatsLog::Close()
+{
+	if (p_file != NULL)
+	{
+		fclose(p_file);
+		p_file = NULL;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Write the column names of the CSV, each counter kept by collision type, geomath
+test or phase gets a column for each with the name as a suffix
+-----------------------------------------------------------------------------------*/
+
+void CStatsLog::WriteHeader()
+{
+	fprintf(p_file, "frame,iterations,collisions,max_simultaneous,resting_contacts,"
+					"over_budget,t_exact,corrections,frame_us");
+
+	for (int k = 1; k < NUM_COLLISION_TYPES; k++)
+		fprintf(p_file, ",pairs_%s", collision_names[k]);
+
+	for (int k = 1; k < NUM_COLLISION_TYPES; k++)
+		fprintf(p_file, ",responses_%s", collision_names[k]);
+
+	for (int k = 0; k < NUM_GEOMATH_KINDS; k++)
+		fprintf(p_file, ",geomath_%s", geomath_names[k]);
+
+	for (int k = 0; k < NUM_PHASES; k++)
+		fprintf(p_file, ",us_%s", phase_names[k]);
+
+	fprintf(p_file, "\n");
+}
+
+/*-----------------------------------------------------------------------------------
+Write the stats of a frame as a row of the CSV or a line of JSON.  The counters
+kept by collision type, geomath test or phase are nested objects in the JSON.
+-----------------------------------------------------------------------------------*/
+
+void CStatsLog::Write(const CCollisions::TFrameStats& stats)
+{
+	if (p_file == NULL)
+		return;
+
+	if (format == STATS_CSV)
+	{
+		fprintf(p_file, "%d,%d,%d,%d,%d,%d,%.4f,%d,%.2f", stats.frame, stats.iterations,
+				stats.collisions, stats.max_simultaneous, stats.resting_contacts,
+				stats.over_budget ? 1 : 0, stats.t_exact, stats.corrections, stats.frame_us);
+
+		for (int k = 1; k < NUM_COLLISION_TYPES; k++)
+			fprintf(p_file, ",%d", stats.pairs[k]);
+
+		for (int k = 1; k < NUM_COLLISION_TYPES; k++)
+			fprintf(p_file, ",%d", stats.responses[k]);
+
+		for (int k = 0; k < NUM_GEOMATH_KINDS; k++)
+			fprintf(p_file, ",%d", stats.geomath[k]);
+
+		for (int k = 0; k < NUM_PHASES; k++)
+			fprintf(p_file, ",%.2f", stats.phase_us[k]);
+
+		fprintf(p_file, "\n");
+		return;
+	}
+
+	fprintf(p_file, "{\"frame\":%d,\"iterations\":%d,\"collisions\":%d,\"max_simultaneous\":%d,"
+					"\"resting_contacts\":%d,\"over_budget\":%s,\"t_exact\":%.4f,"
+					"\"corrections\":%d,\"frame_us\":%.2f", stats.frame, stats.iterations,
+					stats.collisions, stats.max_simultaneous, stats.resting_contacts,
+					stats.over_budget ? "true" : "false", stats.t_exact, stats.corrections,
+					stats.frame_us);
+
+	fprintf(p_file, ",\"pairs\":{");
+	for (int k = 1; k < NUM_COLLISION_TYPES; k++)
+		fprintf(p_file, "%s\"%s\":%d", k > 1 ? "," : "", collision_names[k], stats.pairs[k]);
+
+	fprintf(p_file, "},\"responses\":{");
+	for (int k = 1; k < NUM_COLLISION_TYPES; k++)
+		fprintf(p_file, "%s\"%s\":%d", k > 1 ? "," : "", collision_names[k], stats.responses[k]);
+
+	fprintf(p_file, "},\"geomath\":{");
+	for (int k = 0; k < NUM_GEOMATH_KINDS; k++)
+		fprintf(p_file, "%s\"%s\":%d", k > 0 ? "," : "", geomath_names[k], stats.geomath[k]);
+
+	fprintf(p_file, "},\"phase_us\":{");
+	for (int k = 0; k < NUM_PHASES; k++)
+		fprintf(p_file, "%s\"%s\":%.2f", k > 0 ? "," : "", phase_names[k], stats.phase_us[k]);
+
+	fprintf(p_file, "}}\n");
+}
@@ -0,0 +1,59 @@
+/*-----------------------------------------------------------------------------------
+File:			statsLog.h
+Authors:		Steve Costa
+Description:	Header file defining the stats log, which writes the frame stats
+				of the collision tests to a file one frame at a time.
+-----------------------------------------------------------------------------------*/
+
+#ifndef STATS_LOG_H
+#define STATS_LOG_H
+
+#include <cstdio>
+
+#include "collisions.h"
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define STATS_CSV				0			// A header line then one row per frame
+#define STATS_JSON				1			// One JSON object per line (JSON lines)
+
+/*-----------------------------------------------------------------------------------
+Writes the counters and timings of each frame (CCollisions::TFrameStats) so the
+frames that cost far more than the others can be picked out and the work that
+made them slow seen.  The columns of the CSV and the keys of the JSON are named
+after the PHASE_, GEOMATH_ and collision type constants.
+-----------------------------------------------------------------------------------*/
+
+class CStatsLog
+{
+	// ATTRIBUTES
+private:
+
+	FILE *p_file;
+	int format;						// STATS_CSV or STATS_JSON
+
+	// METHODS
+public:
+
+	CStatsLog();
+	~CStatsLog();
+
+	bool Open(const char *file_name, int format);	// Start a new log
+	void Write(const CCollisions::TFrameStats& stats);
+	void Close();
+
+	bool IsOpen() const { return p_file != NULL; }
+
+	// Names used for the counters of each collision type, geomath test and phase
+	static const char* CollisionName(int coll_id);
+	static const char* GeomathName(int kind);
+	static const char* PhaseName(int phase);
+
+private:
+
+	void WriteHeader();				// Column names of the CSV
+};
+
+#endif
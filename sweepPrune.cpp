@@ -0,0 +1,134 @@
+/*-----------------------------------------------------------------------------------
+File:			sweepPrune.cpp
+Authors:		Steve Costa
+Description:	Sweep and prune broadphase.  The objects are kept sorted on the
+				minimum x value of their swept bounds, the list is then swept
+				once and only the objects whose x intervals overlap are tested
+				against each other on the y and z axes.
+-----------------------------------------------------------------------------------*/
+
+#include "sweepPrune.h"
+
+#include <algorithm>
+
+#include "coreUtil.h"
+
+/*-----------------------------------------------------------------------------------
+Initialise state variables
+-----------------------------------------------------------------------------------*/
+
+CSweepAndPrune::CSweepAndPrune()
+{
+	num_objects = 0;
+	p_bounds = NULL;
+	p_order = NULL;
+}
+
+/*-----------------------------------------------------------------------------------
+Allocate the bounds and the sort order for the number of objects given.  The
+order starts out as the identity and is kept between calls to FindPairs.
+-----------------------------------------------------------------------------------*/
+
+void CSweepAndPrune::Init(int num)
+{
+	if (p_bounds != NULL)
+		delete [] p_bounds;
+
+	if (p_order != NULL)
+		delete [] p_order;
+
+	num_objects = num;
+	p_bounds = new TAABB[num_objects];
+	p_order = new int[num_objects];
+
+	for (int i = 0; i < num_objects; i++)
+		p_order[i] = i;
+
+	pairs.clear();
+}
+
+/*-----------------------------------------------------------------------------------
+Store the swept bounds of an object, these must be updated for every object
+before FindPairs is called.
+-----------------------------------------------------------------------------------*/
+
+void CSweepAndPrune::Update(int id, const TAABB& bounds)
+{
+	assert(id >= 0 && id < num_objects);
+
+	p_bounds[id] = bounds;
+}
+
+/*-----------------------------------------------------------------------------------
+Objects move very little between time slices so the order from the previous
+call is nearly sorted already.  An insertion sort only has to do a few swaps
+in this case which makes it close to linear.
+-----------------------------------------------------------------------------------*/
+
+void CSweepAndPrune::SortAxis()
+{
+	for (int i = 1; i < num_objects; i++)
+	{
+		int id = p_order[i];
+		float key = p_bounds[id].minv.x;
+
+		int j = i - 1;
+		while (j >= 0 && p_bounds[p_order[j]].minv.x > key)
+		{
+			p_order[j + 1] = p_order[j];
+			j--;
+		}
+		p_order[j + 1] = id;
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+Sweep along the sorted x axis.  Every object is compared only with the objects
+that start before it ends, the y and z axes are then checked to confirm the
+overlap.  The pairs are returned sorted on (object1, object2) with object1 the
+lower id, which is the same order the brute force loops visit them in.
+-----------------------------------------------------------------------------------*/
+
+int CSweepAndPrune::FindPairs()
+{
+	pairs.clear();
+
+	SortAxis();
+
+	for (int i = 0; i < num_objects; i++)
+	{
+		int id1 = p_order[i];
+		const TAABB& b1 = p_bounds[id1];
+
+		for (int j = i + 1; j < num_objects; j++)
+		{
+			int id2 = p_order[j];
+			const TAABB& b2 = p_bounds[id2];
+
+			// No object further along the axis can overlap
+			if (b2.minv.x > b1.maxv.x)
+				break;
+
+			if (Overlaps(b1, b2))
+			{
+				TPair pair;
+				pair.object1 = MIN(id1, id2);
+				pair.object2 = MAX(id1, id2);
+				pairs.push_back(pair);
+			}
+		}
+	}
+
+	sort(pairs.begin(), pairs.end());
+
+	return (int)pairs.size();
+}
+
+CSweepAndPrune::~CSweepAndPrune()
+{
+	if (p_bounds != NULL)
+		delete [] p_bounds;
+
+	if (p_order != NULL)
+		delete [] p_order;
+}
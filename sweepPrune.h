@@ -0,0 +1,44 @@
+/*-----------------------------------------------------------------------------------
+File:			sweepPrune.h
+Authors:		Steve Costa
+Description:	Header file defining the sweep and prune broadphase used to find
+				the pairs of moving objects whose swept bounds overlap.
+-----------------------------------------------------------------------------------*/
+
+#ifndef SWEEP_PRUNE_H
+#define SWEEP_PRUNE_H
+
+#include <vector>
+using namespace std;
+
+#include "broadphase.h"
+
+class CSweepAndPrune
+{
+	// ATTRIBUTES
+private:
+
+	int num_objects;				// Number of objects tracked
+	TAABB *p_bounds;				// Swept bounds of each object
+	int *p_order;					// Object ids sorted on the min x of their bounds
+
+	vector<TPair> pairs;			// Overlapping pairs found by the last sweep
+
+	// METHODS
+public:
+
+	CSweepAndPrune();
+	~CSweepAndPrune();
+
+	void Init(int num);								// Allocate storage for num objects
+	void Update(int id, const TAABB& bounds);		// Set the swept bounds of an object
+	int FindPairs();								// Sort, sweep and return # of pairs
+
+	const TPair* GetPairs() const { return pairs.empty() ? NULL : &pairs[0]; }
+
+private:
+
+	void SortAxis();				// Insertion sort of the object order along x
+};
+
+#endif
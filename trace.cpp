@@ -0,0 +1,188 @@
+/*-----------------------------------------------------------------------------------
+File:			trace.cpp
+Authors:		Steve Costa
+Description:	Timeline of scoped markers recorded by each thread, written as
+				Chrome trace event JSON.
+-----------------------------------------------------------------------------------*/
+
+#include "trace.h"
+
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+/*-----------------------------------------------------------------------------------
+Visual Studio 2013 does not have thread_local, its own keyword does the same
+for a plain pointer.  The file is opened with the secure fopen_s, which only the
+Microsoft library has.
+-----------------------------------------------------------------------------------*/
+
+#ifdef _MSC_VER
+
+#define TRACE_THREAD_LOCAL		__declspec(thread)
+
+#else
+
+#define TRACE_THREAD_LOCAL		thread_local
+
+static int fopen_s(FILE **p_file, const char *file_name, const char *mode)
+{
+	*p_file = fopen(file_name, mode);
+	return (*p_file == NULL) ? -1 : 0;
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------------
+Events of one thread.  Only the thread writes to it, the count is atomic so the
+events it covers are seen complete by the thread writing the file.
+-----------------------------------------------------------------------------------*/
+
+struct TTraceEvent
+{
+	const char *name;
+	CTrace::TClock::time_point start;
+	CTrace::TClock::time_point end;
+};
+
+struct TTraceBuffer
+{
+	TTraceEvent *p_events;				// TRACE_MAX_EVENTS of them
+	atomic<int> num_events;
+	int num_dropped;					// Events recorded once the buffer was full
+	int thread_id;						// Numbered from 1 in the order the threads start
+	TTraceBuffer *p_next;
+};
+
+static TRACE_THREAD_LOCAL TTraceBuffer *p_thread_buffer = NULL;
+
+/*-----------------------------------------------------------------------------------
+Declare static variables of the CTrace class.
+-----------------------------------------------------------------------------------*/
+
+atomic<bool> CTrace::recording(false);
+atomic<TTraceBuffer*> CTrace::p_buffers(NULL);
+atomic<int> CTrace::num_threads(0);
+CTrace::TClock::time_point CTrace::start_time;
+
+/*-----------------------------------------------------------------------------------
+Start recording.  The events of an earlier recording are forgotten, so this should
+be called while no other thread is recording.
+-----------------------------------------------------------------------------------*/
+
+void CTrace::Start()
+{
+	for (TTraceBuffer *p_buffer = p_buffers.load(); p_buffer != NULL; p_buffer = p_buffer->p_next)
+	{
+		p_buffer->num_events.store(0);
+		p_buffer->num_dropped = 0;
+	}
+
+	start_time = TClock::now();
+	recording.store(true);
+}
+
+/*-----------------------------------------------------------------------------------
+Stop recording, the scopes still open are not recorded
+-----------------------------------------------------------------------------------*/
+
+void CTrace::Stop()
+{
+	recording.store(false);
+}
+
+/*-----------------------------------------------------------------------------------
+Buffer of the calling thread, made and added to the list of buffers the first
+time the thread records
+-----------------------------------------------------------------------------------*/
+
+TTraceBuffer* CTrace::GetBuffer()
+{
+	if (p_thread_buffer != NULL)
+		return p_thread_buffer;
+
+	TTraceBuffer *p_buffer = new TTraceBuffer;
+	p_buffer->p_events = new TTraceEvent[TRACE_MAX_EVENTS];
+	p_buffer->num_events.store(0);
+	p_buffer->num_dropped = 0;
+	p_buffer->thread_id = ++num_threads;
+
+	p_buffer->p_next = p_buffers.load();
+	while (!p_buffers.compare_exchange_weak(p_buffer->p_next, p_buffer))
+		;
+
+	p_thread_buffer = p_buffer;
+	return p_buffer;
+}
+
+/*-----------------------------------------------------------------------------------
+Add an event to the buffer of this thread.  Once the buffer is full the events
+are counted but not kept.
+-----------------------------------------------------------------------------------*/
+
+void CTrace::Record(const char *name, const TClock::time_point& start,
+					const TClock::time_point& end)
+{
+	TTraceBuffer *p_buffer = GetBuffer();
+
+	int k = p_buffer->num_events.load(memory_order_relaxed);
+	if (k == TRACE_MAX_EVENTS)
+	{
+		p_buffer->num_dropped++;
+		return;
+	}
+
+	p_buffer->p_events[k].name = name;
+	p_buffer->p_events[k].start = start;
+	p_buffer->p_events[k].end = end;
+	p_buffer->num_events.store(k + 1, memory_order_release);
+}
+
+/*-----------------------------------------------------------------------------------
+Write the events as a Chrome trace: complete ("X") events with their start and
+length in microseconds from the start of the recording, and a name for each
+thread.  The names are written as they are so must not hold quotes.
+-----------------------------------------------------------------------------------*/
+
+bool CTrace::Write(const char *file_name)
+{
+	FILE *p_file;
+	if (fopen_s(&p_file, file_name, "w") != 0 || p_file == NULL)
+		return false;
+
+	fprintf(p_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool first = true;
+	for (TTraceBuffer *p_buffer = p_buffers.load(); p_buffer != NULL; p_buffer = p_buffer->p_next)
+	{
+		fprintf(p_file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+						"\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", p_buffer->thread_id,
+						p_buffer->thread_id);
+		first = false;
+
+		int num_events = p_buffer->num_events.load(memory_order_acquire);
+		for (int k = 0; k < num_events; k++)
+		{
+			const TTraceEvent& e = p_buffer->p_events[k];
+			assert(strchr(e.name, '"') == NULL);
+
+			double ts = chrono::duration<double, micro>(e.start - start_time).count();
+			double dur = chrono::duration<double, micro>(e.end - e.start).count();
+
+			fprintf(p_file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+							"\"ts\":%.3f,\"dur\":%.3f}", e.name, p_buffer->thread_id, ts, dur);
+		}
+
+		if (p_buffer->num_dropped > 0)
+		{
+			fprintf(stderr, "Trace buffer of thread %d full, %d events dropped\n",
+					p_buffer->thread_id, p_buffer->num_dropped);
+		}
+	}
+
+	fprintf(p_file, "\n]}\n");
+	fclose(p_file);
+
+	return true;
+}
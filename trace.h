@@ -0,0 +1,108 @@
+/*-----------------------------------------------------------------------------------
+File:			trace.h
+Authors:		Steve Costa
+Description:	Header file defining the trace, which records a timeline of
+				scoped markers and writes it in the Chrome trace event format
+				(for chrome://tracing or ui.perfetto.dev).
+-----------------------------------------------------------------------------------*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+
+/*-----------------------------------------------------------------------------------
+Constants
+-----------------------------------------------------------------------------------*/
+
+#define TRACE_MAX_EVENTS		(1 << 19)	// Events kept for each thread, later ones dropped
+
+struct TTraceBuffer;						// Events of one thread
+
+/*-----------------------------------------------------------------------------------
+Each thread records its events into a buffer of its own, so recording takes no
+lock and the threads never write to the same memory.  A thread's buffer is made
+the first time it records and pushed onto a list of every buffer with a
+compare and swap.  The buffers are kept until the program ends so the events
+can be written out once the threads are done.
+
+When the trace is not recording a marker only loads a flag, and defining
+NO_TRACE removes the markers altogether.
+-----------------------------------------------------------------------------------*/
+
+class CTrace
+{
+	// ATTRIBUTES
+public:
+
+	typedef std::chrono::steady_clock TClock;
+
+private:
+
+	static std::atomic<bool> recording;
+	static std::atomic<TTraceBuffer*> p_buffers;	// List of the buffers of every thread
+	static std::atomic<int> num_threads;
+	static TClock::time_point start_time;	// Times are written from here
+
+	// METHODS
+public:
+
+	static void Start();				// Forget the events so far and start recording
+	static void Stop();
+
+	static bool IsRecording() { return recording.load(std::memory_order_relaxed); }
+
+	// Add a complete event to the buffer of this thread, name must outlive the trace
+	static void Record(const char *name, const TClock::time_point& start,
+						const TClock::time_point& end);
+
+	// Write the events of every thread, call once the other threads have stopped
+	// recording
+	static bool Write(const char *file_name);
+
+private:
+
+	static TTraceBuffer* GetBuffer();	// Buffer of this thread
+};
+
+/*-----------------------------------------------------------------------------------
+Records an event from its creation to the end of its scope, if the trace was
+recording at both ends
+-----------------------------------------------------------------------------------*/
+
+class CTraceScope
+{
+	// ATTRIBUTES
+private:
+
+	const char *name;
+	bool active;						// The trace was recording when the scope began
+	CTrace::TClock::time_point start;
+
+	// METHODS
+public:
+
+	explicit CTraceScope(const char *name) : name(name), active(CTrace::IsRecording())
+	{
+		if (active)
+			start = CTrace::TClock::now();
+	}
+
+	~CTraceScope()
+	{
+		if (active && CTrace::IsRecording())
+			CTrace::Record(name, start, CTrace::TClock::now());
+	}
+};
+
+#define TRACE_CONCAT2(a, b)		a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT2(a, b)
+
+#ifdef NO_TRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name)		CTraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#endif
+
+#endif
@@ -67,13 +67,6 @@ public:
 		else return z;
 	}
 
-	// Overload assignment operator
-	TVector& operator = (const TVector& rhs)
-	{
-		x = rhs.x;  y = rhs.y;  z = rhs.z;
-		return *this;
-	}
-
 	// Overload equality operator
 	bool operator == (const TVector& rhs) const
 	{
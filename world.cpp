@@ -1,12 +1,12 @@
 /*-----------------------------------------------------------------------------------
 File:			world.cpp
 Authors:		Steve Costa
-Description:	This class defines the entire world of the simulation.  It will
-				load the world description from a text file and dynamically
-				create all of the world objects.
+Description:	This class defines the entire world of the simulation.  It loads
+				the scene through CScene and draws all of the world objects.
 -----------------------------------------------------------------------------------*/
 
 #include "world.h"						// Common macros
+#include "trace.h"						// Loading and drawing are marked on the timeline
 
 /*-----------------------------------------------------------------------------------
 Initialise world state variables.
@@ -16,9 +16,8 @@ CWorld::CWorld()
 {
 	// Set pointers to null
 	p_sphere_obj = NULL;
-	p_balls = NULL;
-	p_walls = NULL;
-	p_boxes = NULL;
+	p_prev_centers = NULL;
+	p_prev_mins = NULL;
 
 	// Initialize the colour array
 
@@ -78,24 +77,27 @@ CWorld::CWorld()
 void CWorld::Init()
 {
 	// Load textures
-	t_manager.LoadTexture("textures\\leafs.bmp", &world_textures[0], 1);
-	t_manager.LoadTexture("textures\\rinkside.bmp", &world_textures[1], 1);
-	t_manager.LoadTexture("textures\\hnic.bmp", &world_textures[2], 1);
-	t_manager.LoadTexture("textures\\cobblestone.bmp", &world_textures[3], 1);
-	t_manager.LoadTexture("textures\\cobblestone2.bmp", &world_textures[4], 1);
-	t_manager.LoadTexture("textures\\electric_big.bmp", &world_textures[5], 1);
-	t_manager.LoadTexture("textures\\checker.bmp", &world_textures[6], 1);
-	t_manager.LoadTexture("textures\\twirl.bmp", &world_textures[7], 1);
-	t_manager.LoadTexture("textures\\marble.bmp", &world_textures[8], 1);
-	t_manager.LoadTexture("textures\\electric.bmp", &world_textures[9], 1);
-	t_manager.LoadTexture("textures\\green.bmp", &world_textures[10], 1);
-
-	t_manager.LoadTexture("textures\\skybox\\front.bmp", &sky_textures[0], 1);
-	t_manager.LoadTexture("textures\\skybox\\left.bmp", &sky_textures[1], 1);
-	t_manager.LoadTexture("textures\\skybox\\right.bmp", &sky_textures[2], 1);
-	t_manager.LoadTexture("textures\\skybox\\top.bmp", &sky_textures[3], 0);
-	t_manager.LoadTexture("textures\\skybox\\back.bmp", &sky_textures[4], 1);
-	t_manager.LoadTexture("textures\\skybox\\bottom.bmp", &sky_textures[5], 0);
+	{
+		TRACE_SCOPE("CWorld::Init textures");
+		t_manager.LoadTexture("textures\\leafs.bmp", &world_textures[0], 1);
+		t_manager.LoadTexture("textures\\rinkside.bmp", &world_textures[1], 1);
+		t_manager.LoadTexture("textures\\hnic.bmp", &world_textures[2], 1);
+		t_manager.LoadTexture("textures\\cobblestone.bmp", &world_textures[3], 1);
+		t_manager.LoadTexture("textures\\cobblestone2.bmp", &world_textures[4], 1);
+		t_manager.LoadTexture("textures\\electric_big.bmp", &world_textures[5], 1);
+		t_manager.LoadTexture("textures\\checker.bmp", &world_textures[6], 1);
+		t_manager.LoadTexture("textures\\twirl.bmp", &world_textures[7], 1);
+		t_manager.LoadTexture("textures\\marble.bmp", &world_textures[8], 1);
+		t_manager.LoadTexture("textures\\electric.bmp", &world_textures[9], 1);
+		t_manager.LoadTexture("textures\\green.bmp", &world_textures[10], 1);
+
+		t_manager.LoadTexture("textures\\skybox\\front.bmp", &sky_textures[0], 1);
+		t_manager.LoadTexture("textures\\skybox\\left.bmp", &sky_textures[1], 1);
+		t_manager.LoadTexture("textures\\skybox\\right.bmp", &sky_textures[2], 1);
+		t_manager.LoadTexture("textures\\skybox\\top.bmp", &sky_textures[3], 0);
+		t_manager.LoadTexture("textures\\skybox\\back.bmp", &sky_textures[4], 1);
+		t_manager.LoadTexture("textures\\skybox\\bottom.bmp", &sky_textures[5], 0);
+	}
 	
 	// Initialize quadratic for drawing balls
 	p_sphere_obj = gluNewQuadric();
@@ -103,8 +105,16 @@ void CWorld::Init()
 	gluQuadricTexture(p_sphere_obj, GL_TRUE);
 
 	// Load world
-	if (FAILED(Load("maps\\world_map.txt")))
-		MessageBox(NULL, "Failed to load file!", "ERROR", MB_OK);
+	{
+		TRACE_SCOPE("CWorld::Init map");
+		if (FAILED(Load("maps\\world_map.txt")))
+			MessageBox(NULL, "Failed to load file!", "ERROR", MB_OK);
+	}
+
+	// Nothing has moved yet so the objects are drawn where they start
+	p_prev_centers = new TVector[num_balls];
+	p_prev_mins = new TVector[num_boxes];
+	SavePositions();
 
 	// Normal of the clipping plane
 	clip_plane[0] = -p_walls[0].normal.x; clip_plane[1] = -p_walls[0].normal.y;
@@ -112,251 +122,14 @@ void CWorld::Init()
 	
 
 	// Render display lists
-	RenderReflectiveSurface();
-	RenderBoxes();
-	RenderWalls();
-	RenderSkyBox();
-}
-
-/*-----------------------------------------------------------------------------------
-Read lines from a file ignoring empty lines and comments
------------------------------------------------------------------------------------*/
-
-void CWorld::ReadString(char *string, FILE *file)
-{
-	do
 	{
-		fgets(string, 512, file);
-	} while ((string[0] == '#') || (string[0] == '\n'));
-}
-
-/*-----------------------------------------------------------------------------------
-This method will a map configuration file and set the world object attributes
-accordingly.
-
-Errors:		-3500 = Failed to open file
-			-3501 = Wrong file type
-			-3502 = Data read error
-			-3503 = Memory allocation error
------------------------------------------------------------------------------------*/
-
-int CWorld::Load(char *file_name)
-{
-	FILE *map_file;				// Input file stream variable
-	char line[512];				// Holds line of text
-	char *p_token;				// Point to first character of a token
-	char *p_next_token;
-	TVector temp[4];			// Temporary storage of geometric object vertices
-	float temp_rad;				// Temporary radius variable
-	int temp_rot;
-	float temp_theta;			// Temporary rotation flag and rotation amount
-	int temp_col, temp_tex;	// Temp color and texture indices
-
-	// Check to see if the dynamic arrays must free memory first
-	 if (p_balls != NULL)
-		delete [] p_balls;
-
-	if (p_walls != NULL)
-		delete [] p_walls;
-
-	if (p_boxes != NULL)
-		delete [] p_boxes;
-	
-	// Open the file
-	fopen_s(&map_file, file_name, "r");
-
-	// # OF WALLS
-	ReadString(line, map_file);					// Read line
-	if (sscanf_s(line, "numwalls = %d", &num_walls) == EOF)
-		return (-3502);							// Data read error
-	
-	// Knowing the number of walls we can allocate enough memory for
-	// storing them
-	try {
-		p_walls = new TWall[num_walls];
-	} catch (bad_alloc xa) {
-		return (-3503);							// Memory allocation error
+		TRACE_SCOPE("CWorld::Init display lists");
+		RenderReflectiveSurface();
+		RenderBoxes();
+		RenderWalls();
+		RenderMeshes();
+		RenderSkyBox();
 	}
-
-	// The following section should contain 2 lines for each of the
-	// wall variables for min, max, and rotation type with rotation angle
-	for (int t = 0; t < num_walls; t++)				// Each wall
-	{
-	
-		ReadString(line, map_file);			// Read next line
-		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
-
-		for (int j = 0; j < 2; j++)				// Each vertex coordinate
-		{
-			// Store the x, y coordinates in two separate vectors
-			if (sscanf_s(p_token, " %f", &temp[j][0]) == EOF)
-				return (-3502);				// Data read error
-
-			// Get the next value
-			p_token = strtok_s(NULL, " ,\t", &p_next_token);
-
-			// Store the x, y coordinates in two separate vectors
-			if (sscanf_s(p_token, " %f", &temp[j][1]) == EOF)
-				return (-3502);				// Data read error
-
-			// Get the next value
-			p_token = strtok_s(NULL, " ,\t", &p_next_token);
-		} // End for
-
-		// Get the colour and texture indices
-		if (sscanf_s(p_token, " %d", &temp_col) == EOF)
-				return (-3502);				// Data read error
-
-		// Get the next value
-		p_token = strtok_s(NULL, " ,\t", &p_next_token);
-
-		if (sscanf_s(p_token, " %d", &temp_tex) == EOF)
-				return (-3502);				// Data read error
-
-		ReadString(line, map_file);			// Read next line
-		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
-
-		// Read the translation vector
-		for (int j = 0; j < 3; j++)
-		{
-			// Store the x, y, z coordinates
-			if (sscanf_s(p_token, " %f", &temp[2][j]) == EOF)
-				return (-3502);				// Data read error
-
-			// Get the next value
-			p_token = strtok_s(NULL, " ,\t", &p_next_token);
-		}
-
-		// Store the rotation flag coordinates
-		if (sscanf_s(p_token, " %d", &temp_rot) == EOF)
-			return (-3502);				// Data read error
-
-		// Get the next value
-		p_token = strtok_s(NULL, " ,\t", &p_next_token);
-
-		// Store the rotation value
-		if (sscanf_s(p_token, " %f", &temp_theta) == EOF)
-			return (-3502);				// Data read error
-
-		// We can now initialize the wall
-		temp[0][2] = 0.0f;	temp[1][2] = 0.0f;	// coordinates can be referenced with . or []
-		p_walls[t] = TWall(	temp[0], temp[1], temp[2], temp_theta, 
-							temp_rot, temp_col, temp_tex);
-
-	} // End for
-
-
-	// # OF BALLS
-	ReadString(line, map_file);					// Read line
-	if (sscanf_s(line, "numballs = %d", &num_balls) == EOF)
-		return (-3502);							// Data read error
-	
-	// Knowing the number of walls we can allocate enough memory for
-	// storing them
-	try {
-		p_balls = new TBall[num_balls];
-	} catch (bad_alloc xa) {
-		return (-3503);							// Memory allocation error
-	}
-	
-	// The following section should contain 1 line containing attributes for each ball
-	for (int t = 0; t < num_balls; t++)				// Each ball
-	{
-		ReadString(line, map_file);			// Read next line
-		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
-
-		for (int i = 0; i < 7; i++)					// Each attributs
-		{
-			if (i < 3) {						// Read centre
-				if (sscanf_s(p_token, " %f", &temp[0][i]) == EOF)
-					return (-3502);				// Data read error
-			}
-			else if (i >= 3 && i < 4) {			// Read radius
-				if (sscanf_s(p_token, " %f", &temp_rad) == EOF)
-					return (-3502);				// Data read error
-			}
-			else {								// Read velocity
-				if (sscanf_s(p_token, " %f", &temp[1][i-4]) == EOF)
-					return (-3502);				// Data read error
-			}
-			
-			// Get the next value
-			p_token = strtok_s(NULL, " ,\t", &p_next_token);
-		}
-
-		// Get the colour and texture indices
-		if (sscanf_s(p_token, " %d", &temp_col) == EOF)
-				return (-3502);				// Data read error
-
-		// Get the next value
-		p_token = strtok_s(NULL, " ,\t", &p_next_token);
-
-		if (sscanf_s(p_token, " %d", &temp_tex) == EOF)
-				return (-3502);				// Data read error
-			
-		// Initialize the ball
-		p_balls[t] = TBall(temp[0], temp_rad, temp[1], temp_col, temp_tex);
-
-	} // End for
-
-
-	// # OF BOXES
-	ReadString(line, map_file);					// Read line
-	if (sscanf_s(line, "numboxes = %d", &num_boxes) == EOF)
-		return (-3502);							// Data read error
-	
-	// Knowing the number of walls we can allocate enough memory for
-	// storing them
-	try {
-		p_boxes = new TBox[num_boxes];
-	} catch (bad_alloc xa) {
-		return (-3503);							// Memory allocation error
-	}
-	
-	// The following section should contain 1 line containing attributes for each box
-	for (int t = 0; t < num_boxes; t++)				// Each ball
-	{
-		ReadString(line, map_file);			// Read next line
-		p_token = strtok_s(line, " ,\t", &p_next_token);		// Read first value in the line
-
-		for (int i = 0; i < 9; i++)					// Each attribute
-		{
-			if (i < 3) {						// Read min
-				if (sscanf_s(p_token, " %f", &temp[0][i]) == EOF)
-					return (-3502);				// Data read error
-			}
-			else if (i >= 3 && i < 6) {			// Read max
-				if (sscanf_s(p_token, " %f", &temp[1][i-3]) == EOF)
-					return (-3502);				// Data read error
-			}
-			else {								// Read velocity
-				if (sscanf_s(p_token, " %f", &temp[2][i-6]) == EOF)
-					return (-3502);				// Data read error
-			}
-			
-			// Get the next value
-			p_token = strtok_s(NULL, " ,\t", &p_next_token);
-		}
-
-		// Get the colour and texture indices
-		if (sscanf_s(p_token, " %d", &temp_col) == EOF)
-				return (-3502);				// Data read error
-
-		// Get the next value
-		p_token = strtok_s(NULL, " ,\t", &p_next_token);
-
-		if (sscanf_s(p_token, " %d", &temp_tex) == EOF)
-				return (-3502);				// Data read error
-			
-		// Initialize the ball
-		p_boxes[t] = TBox(temp[0], temp[1], temp[2], temp_col, temp_tex);
-				
-	} // End for
-	
-	// All information has been extracted, close the file
-	fclose(map_file);
-
-	return 1;
 }
 
 /*-----------------------------------------------------------------------------------
@@ -418,8 +191,10 @@ Using the stencil buffer reflection effects are applied to the reflective
 surface object.
 -----------------------------------------------------------------------------------*/
 
-void CWorld::DrawReflectiveSurface(float *posl, float dt)
+void CWorld::DrawReflectiveSurface(float *posl, float dt, float alpha)
 {
+	TRACE_SCOPE("CWorld::DrawReflectiveSurface");
+
 	glColorMask(0, 0, 0, 0);						// Prevent any drawing to appear
 
 	glEnable(GL_STENCIL_TEST);						// Enable stencil buffer
@@ -443,7 +218,7 @@ void CWorld::DrawReflectiveSurface(float *posl, float dt)
 	glPushMatrix();
 		glScalef(1.0f, -1.0f, 1.0f);
 		glLightfv(GL_LIGHT0, GL_POSITION, posl);
-		DrawWorld(dt);
+		DrawWorld(dt, alpha);
 	glPopMatrix();
 
 	glDisable(GL_CLIP_PLANE0);
@@ -480,6 +255,8 @@ void CWorld::RenderBoxes()
 	for (int i = 0; i < num_boxes; i++)
 	{
 
+		TAABB bounds = sim.GetBoxBounds(i);
+
 		glNewList(l_boxes + i, GL_COMPILE);
 
 			// Apply texture
@@ -504,10 +281,10 @@ void CWorld::RenderBoxes()
 			// Begin Drawing
 			glBegin(GL_QUADS);
 				// Front Face
-				temp_point0 = p_boxes[i].GetVertex(4) - p_boxes[i].GetVertex(0);
-				temp_point1 = p_boxes[i].GetVertex(5) - p_boxes[i].GetVertex(0);
-				temp_point2 = p_boxes[i].GetVertex(7) - p_boxes[i].GetVertex(0);
-				temp_point3 = p_boxes[i].GetVertex(6) - p_boxes[i].GetVertex(0);
+				temp_point0 = bounds.GetVertex(4) - bounds.GetVertex(0);
+				temp_point1 = bounds.GetVertex(5) - bounds.GetVertex(0);
+				temp_point2 = bounds.GetVertex(7) - bounds.GetVertex(0);
+				temp_point3 = bounds.GetVertex(6) - bounds.GetVertex(0);
 
 				vector1 = temp_point1 - temp_point0;
 				vector2 = temp_point2 - temp_point1;
@@ -522,10 +299,10 @@ void CWorld::RenderBoxes()
 				glVertex3f(temp_point3.x, temp_point3.y, temp_point3.z);
 					
 				// Left Face
-				temp_point0 = p_boxes[i].GetVertex(0) - p_boxes[i].GetVertex(0);
-				temp_point1 = p_boxes[i].GetVertex(4) - p_boxes[i].GetVertex(0);
-				temp_point2 = p_boxes[i].GetVertex(6) - p_boxes[i].GetVertex(0);
-				temp_point3 = p_boxes[i].GetVertex(2) - p_boxes[i].GetVertex(0);
+				temp_point0 = bounds.GetVertex(0) - bounds.GetVertex(0);
+				temp_point1 = bounds.GetVertex(4) - bounds.GetVertex(0);
+				temp_point2 = bounds.GetVertex(6) - bounds.GetVertex(0);
+				temp_point3 = bounds.GetVertex(2) - bounds.GetVertex(0);
 
 				vector1 = temp_point1 - temp_point0;
 				vector2 = temp_point2 - temp_point1;
@@ -540,10 +317,10 @@ void CWorld::RenderBoxes()
 				glVertex3f(temp_point3.x, temp_point3.y, temp_point3.z);
 
 				// Right Face
-				temp_point0 = p_boxes[i].GetVertex(5) - p_boxes[i].GetVertex(0);
-				temp_point1 = p_boxes[i].GetVertex(1) - p_boxes[i].GetVertex(0);
-				temp_point2 = p_boxes[i].GetVertex(3) - p_boxes[i].GetVertex(0);
-				temp_point3 = p_boxes[i].GetVertex(7) - p_boxes[i].GetVertex(0);
+				temp_point0 = bounds.GetVertex(5) - bounds.GetVertex(0);
+				temp_point1 = bounds.GetVertex(1) - bounds.GetVertex(0);
+				temp_point2 = bounds.GetVertex(3) - bounds.GetVertex(0);
+				temp_point3 = bounds.GetVertex(7) - bounds.GetVertex(0);
 
 				vector1 = temp_point1 - temp_point0;
 				vector2 = temp_point2 - temp_point1;
@@ -558,10 +335,10 @@ void CWorld::RenderBoxes()
 				glVertex3f(temp_point3.x, temp_point3.y, temp_point3.z);
 
 				// Back Face
-				temp_point0 = p_boxes[i].GetVertex(2) - p_boxes[i].GetVertex(0);
-				temp_point1 = p_boxes[i].GetVertex(3) - p_boxes[i].GetVertex(0);
-				temp_point2 = p_boxes[i].GetVertex(1) - p_boxes[i].GetVertex(0);
-				temp_point3 = p_boxes[i].GetVertex(0) - p_boxes[i].GetVertex(0);
+				temp_point0 = bounds.GetVertex(2) - bounds.GetVertex(0);
+				temp_point1 = bounds.GetVertex(3) - bounds.GetVertex(0);
+				temp_point2 = bounds.GetVertex(1) - bounds.GetVertex(0);
+				temp_point3 = bounds.GetVertex(0) - bounds.GetVertex(0);
 
 				vector1 = temp_point1 - temp_point0;
 				vector2 = temp_point2 - temp_point1;
@@ -576,10 +353,10 @@ void CWorld::RenderBoxes()
 				glVertex3f(temp_point3.x, temp_point3.y, temp_point3.z);
 
 				// Top Face
-				temp_point0 = p_boxes[i].GetVertex(6) - p_boxes[i].GetVertex(0);
-				temp_point1 = p_boxes[i].GetVertex(7) - p_boxes[i].GetVertex(0);
-				temp_point2 = p_boxes[i].GetVertex(3) - p_boxes[i].GetVertex(0);
-				temp_point3 = p_boxes[i].GetVertex(2) - p_boxes[i].GetVertex(0);
+				temp_point0 = bounds.GetVertex(6) - bounds.GetVertex(0);
+				temp_point1 = bounds.GetVertex(7) - bounds.GetVertex(0);
+				temp_point2 = bounds.GetVertex(3) - bounds.GetVertex(0);
+				temp_point3 = bounds.GetVertex(2) - bounds.GetVertex(0);
 
 				vector1 = temp_point1 - temp_point0;
 				vector2 = temp_point2 - temp_point1;
@@ -671,6 +448,77 @@ void CWorld::RenderWalls()
 	glPopAttrib();
 }
 
+/*-----------------------------------------------------------------------------------
+Render the convex meshes to display lists, each face as a polygon.
+-----------------------------------------------------------------------------------*/
+
+void CWorld::RenderMeshes()
+{
+	if (num_meshes == 0)
+		return;
+
+	l_meshes = glGenLists(num_meshes);
+
+	// Save colour settings
+	glPushAttrib(GL_CURRENT_BIT);
+
+	for (int i = 0; i < num_meshes; i++)
+	{
+		glNewList(l_meshes + i, GL_COMPILE);
+
+			// Apply texture
+			int t = p_meshes[i].texture;
+			if (t >= 0 && t < MAX_TEXTURES) {
+				glEnable(GL_TEXTURE_2D);
+				glBindTexture(GL_TEXTURE_2D, world_textures[t]);
+			}
+
+			// Apply colour
+			int c = p_meshes[i].color;
+			if (c >= 0 && c < MAX_COLORS) {
+				if (c >= 11) { // Disable lights to allow transparency
+					glEnable(GL_BLEND);
+					glDisable(GL_LIGHTING);
+				}
+				glColor4f(	world_colors[c][0], world_colors[c][1],
+							world_colors[c][2], world_colors[c][3]);
+			}
+
+			// Begin Drawing
+			for (unsigned int f = 0; f < p_meshes[i].faces.size(); f++)
+			{
+				const TMeshFace& face = p_meshes[i].faces[f];
+
+				// Two directions across the face for the texture coordinates
+				TVector across1 = p_meshes[i].side_normals[face.first];
+				TVector across2 = CrossProduct(face.normal, across1);
+
+				glBegin(GL_POLYGON);
+					glNormal3f(face.normal.x, face.normal.y, face.normal.z);
+
+					for (int k = 0; k < face.count; k++)
+					{
+						TVector temp_point = p_meshes[i].GetFaceVertex(face, k);
+
+						glTexCoord2f(temp_point * across2, temp_point * across1);
+						glVertex3f(temp_point.x, temp_point.y, temp_point.z);
+					}
+				glEnd();
+			}
+
+			if (t >= 0 && t < MAX_TEXTURES) glDisable(GL_TEXTURE_2D);
+			if (c >= 11) {
+				glEnable(GL_LIGHTING);
+				glDisable(GL_BLEND);
+			}
+
+		glEndList();
+
+	} // End for
+
+	glPopAttrib();
+}
+
 /*-----------------------------------------------------------------------------------
 The sky box encapsulates the whole world in a city landscape.  It is an AABB which
 is initially empty.  This method will look at all the objects in the world
@@ -700,25 +548,35 @@ void CWorld::RenderSkyBox()
 	{
 		for (int t = 0; t < 8; t++)
 		{
-			temp_point = p_boxes[i].GetVertex(t);
+			temp_point = sim.GetBoxBounds(i).GetVertex(t);
 			skybox.Add(temp_point);
 		}
 	}
 
+	// Encompass all the meshes
+	for (int i = 0; i < num_meshes; i++)
+	{
+		skybox.Add(p_meshes[i].bounds.minv);
+		skybox.Add(p_meshes[i].bounds.maxv);
+	}
+
 	// Encompass all the balls
 	for (int i = 0; i < num_balls; i++)
 	{
-		temp_point = p_balls[i].center + TVector(p_balls[i].radius, 0.0f, 0.0f);
+		TVector center = sim.GetBallCenter(i);
+		float radius = sim.GetBallRadius(i);
+
+		temp_point = center + TVector(radius, 0.0f, 0.0f);
 		skybox.Add(temp_point);
-		temp_point = p_balls[i].center + TVector(-p_balls[i].radius, 0.0f, 0.0f);
+		temp_point = center + TVector(-radius, 0.0f, 0.0f);
 		skybox.Add(temp_point);
-		temp_point = p_balls[i].center + TVector(0.0f, p_balls[i].radius, 0.0f);
+		temp_point = center + TVector(0.0f, radius, 0.0f);
 		skybox.Add(temp_point);
-		temp_point = p_balls[i].center + TVector(0.0f, -p_balls[i].radius, 0.0f);
+		temp_point = center + TVector(0.0f, -radius, 0.0f);
 		skybox.Add(temp_point);
-		temp_point = p_balls[i].center + TVector(0.0f, 0.0f, p_balls[i].radius);
+		temp_point = center + TVector(0.0f, 0.0f, radius);
 		skybox.Add(temp_point);
-		temp_point = p_balls[i].center + TVector(0.0f, 0.0f, -p_balls[i].radius);
+		temp_point = center + TVector(0.0f, 0.0f, -radius);
 	}
 
 	// Now we'll stretch it out a little more
@@ -823,18 +681,52 @@ void CWorld::RenderSkyBox()
 	glPopAttrib();
 }
 
+/*-----------------------------------------------------------------------------------
+Remember where the balls and boxes are before the game takes a simulation step,
+so they can be drawn part of the way between the last two steps.
+-----------------------------------------------------------------------------------*/
+
+void CWorld::SavePositions()
+{
+	for (int i = 0; i < num_balls; i++)
+		p_prev_centers[i] = sim.GetBallCenter(i);
+
+	for (int i = 0; i < num_boxes; i++)
+		p_prev_mins[i] = sim.GetBoxMin(i);
+}
+
+/*-----------------------------------------------------------------------------------
+The simulation runs in fixed steps which do not line up with the frames drawn, so
+each object is drawn where it was a fraction alpha (0 to 1) of the way from its
+position before the last step to its position after it.  This lags the
+simulation by up to a step but keeps the motion smooth.
+-----------------------------------------------------------------------------------*/
+
+TVector CWorld::GetDrawCenter(int i, float alpha) const
+{
+	return p_prev_centers[i] + (sim.GetBallCenter(i) - p_prev_centers[i]) * alpha;
+}
+
+TVector CWorld::GetDrawMin(int i, float alpha) const
+{
+	return p_prev_mins[i] + (sim.GetBoxMin(i) - p_prev_mins[i]) * alpha;
+}
+
 /*-----------------------------------------------------------------------------------
 Draw all the components of the world.
 -----------------------------------------------------------------------------------*/
 
-void CWorld::DrawWorld(float dt)
+void CWorld::DrawWorld(float dt, float alpha)
 {
+	TRACE_SCOPE("CWorld::DrawWorld");
+
 	// Draw the boxes
 	glPushAttrib(GL_CURRENT_BIT);
 	for (int i = 0; i < num_boxes; i++)
 	{		
 		glPushMatrix();
-			glTranslatef(p_boxes[i].minv.x, p_boxes[i].minv.y, p_boxes[i].minv.z);
+			TVector m = GetDrawMin(i, alpha);
+			glTranslatef(m.x, m.y, m.z);
 			glCallList(l_boxes + i);
 		glPopMatrix();
 	}
@@ -866,10 +758,11 @@ void CWorld::DrawWorld(float dt)
 			}
 		
 			// Rotate the balls proportional to their speed * time
-			p_balls[i].Rotate(dt);
-			glTranslatef(p_balls[i].center.x, p_balls[i].center.y, p_balls[i].center.z);
+			p_balls[i].Rotate(sim.GetBallVel(i), sim.GetBallRadius(i), dt);
+			TVector center = GetDrawCenter(i, alpha);
+			glTranslatef(center.x, center.y, center.z);
 			glMultMatrixf(p_balls[i].rot.m);
-			gluSphere(p_sphere_obj, p_balls[i].radius, 20, 20);
+			gluSphere(p_sphere_obj, sim.GetBallRadius(i), 20, 20);
 
 			if (t >= 0 && t < MAX_TEXTURES) glDisable(GL_TEXTURE_2D);
 			if (c >= 11) {
@@ -890,18 +783,23 @@ void CWorld::DrawWorld(float dt)
 	for (int i = 1; i < num_walls; i++)
 		glCallList(l_walls + i - 1);
 	glPopAttrib();
+
+	glPushAttrib(GL_CURRENT_BIT);
+	// Draw the meshes
+	for (int i = 0; i < num_meshes; i++)
+		glCallList(l_meshes + i);
+	glPopAttrib();
 }
 
 void CWorld::ShutDown()
 {
-	if (p_balls != NULL)
-		delete [] p_balls;
+	if (p_prev_centers != NULL)
+		delete [] p_prev_centers;
 
-	if (p_walls != NULL)
-		delete [] p_walls;
+	if (p_prev_mins != NULL)
+		delete [] p_prev_mins;
 
-	if (p_boxes != NULL)
-		delete [] p_boxes;
+	CScene::ShutDown();
 
 	gluDeleteQuadric(p_sphere_obj);
 }
\ No newline at end of file
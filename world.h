@@ -10,14 +10,8 @@ Description:	Header file defining the world and all its objects
 #include <windows.h>
 #include <gl/GL.h>
 #include <gl/GLU.h>
-#include <cstdio>					// Header for data streaming
-#include <cstring>					// Header for string handling
-#include <new>						// Header for dynamic memory allocation
-using namespace std;
-
-#include "plane.h"					// Plane type class
-#include "sphere.h"					// Sphere type class
-#include "aabb.h"					// Bounding Box type class
+
+#include "scene.h"					// Objects of the world
 #include "textureManager.h"			// Load textures
 
 /*-----------------------------------------------------------------------------------
@@ -27,7 +21,11 @@ Constants
 #define MAX_TEXTURES		11
 #define MAX_COLORS			13
 
-class CWorld
+/*-----------------------------------------------------------------------------------
+The world is the scene along with everything needed to draw it.
+-----------------------------------------------------------------------------------*/
+
+class CWorld : public CScene
 {
 	// ATTRIBUTES
 private:
@@ -39,6 +37,7 @@ private:
 	unsigned int l_reflective_surface;
 	unsigned int l_boxes;
 	unsigned int l_walls;
+	unsigned int l_meshes;
 	unsigned int l_sky;
 	
 	// World textures and colours that can be used
@@ -51,13 +50,8 @@ private:
 
 public:
 
-	int num_walls;					// Number of walls
-	int num_balls;					// Number of balls
-	int num_boxes;					// Number of boxes
-	
-	TWall *p_walls;					// Declare walls
-	TBall *p_balls;					// Declare balls
-	TBox *p_boxes;					// Declare boxes
+	TVector *p_prev_centers;		// Ball centres before the last simulation step
+	TVector *p_prev_mins;			// Box min points before the last simulation step
 
 	// METHODS
 public:
@@ -67,16 +61,20 @@ public:
 	void Draw();					// Draw all the world components
 	void ShutDown();				// Release all alocated memory
 
-	void DrawReflectiveSurface(float *posl, float dt);
-	void DrawWorld(float dt);
+	void SavePositions();			// Keep the positions before a simulation step
 
-private:
-	void ReadString(char *string, FILE *file);	// Read a string, ignore empty lines and comments
-	int Load(char *file_name);					// Load world configuration from file
+	// Positions drawn a fraction alpha of the way through the last step
+	TVector GetDrawCenter(int i, float alpha) const;
+	TVector GetDrawMin(int i, float alpha) const;
 
+	void DrawReflectiveSurface(float *posl, float dt, float alpha);
+	void DrawWorld(float dt, float alpha);
+
+private:
 	void RenderReflectiveSurface();
 	void RenderBoxes();
 	void RenderWalls();
+	void RenderMeshes();
 	void RenderSkyBox();
 };
 